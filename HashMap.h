@@ -7,17 +7,302 @@
 */
 #include "common.h"
 #include "sphash.h"
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdio>
 #include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__) && !defined(__AVX2__)
+#define HASHMAP_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define HASHMAP_TARGET_AVX2
+#endif
+
+#ifdef HASHMAP_ENABLE_COUNTERS
+#include <cstddef>
+#define HCOUNT(counter, n) hashmap::hash_detail::count(offsetof(hashmap::Counters, counter) / sizeof(hashmap::u64), (n))
+#define HCOUNT_RESIZE() hashmap::hash_detail::ResizeTimer resizeTimer
+#else
+#define HCOUNT(counter, n)
+#define HCOUNT_RESIZE()
+#endif
 
 namespace hashmap
 {
+#ifdef HASHMAP_ENABLE_COUNTERS
+	/**
+	@brief Events on hot paths of tables, counted for each thread
+	*/
+	struct Counters
+	{
+		/// Slots visited by lookups, insertions and erasures, or groups for SwissTable
+		u64 probes_;
+		/// Key comparisons
+		u64 compares_;
+		/// Matches of h2 or stored hashes, which turned out to be another key
+		u64 falseMatches_;
+		/// Entries moved to make or fill a hole, by Hopscotch and Robin Hood
+		u64 displacements_;
+		u64 resizes_;
+		u64 resizeNanoseconds_;
+	};
+
+	namespace hash_detail
+	{
+		/**
+		@brief Counters of a thread, which only the thread writes and any thread reads
+		*/
+		struct ThreadCounters
+		{
+			inline static constexpr u32 Size = sizeof(Counters) / sizeof(u64);
+
+			ThreadCounters();
+			~ThreadCounters();
+
+			std::atomic<u64> values_[Size];
+			ThreadCounters* next_;
+		};
+
+		/**
+		@brief List of live threads, and sums of exited threads
+		*/
+		struct CounterRegistry
+		{
+			std::mutex mutex_;
+			ThreadCounters* threads_ = nullptr;
+			u64 exited_[ThreadCounters::Size] = {};
+		};
+
+		inline CounterRegistry& counterRegistry()
+		{
+			static CounterRegistry registry;
+			return registry;
+		}
+
+		inline ThreadCounters::ThreadCounters()
+		{
+			for (u32 i = 0; i < Size; ++i) {
+				values_[i].store(0, std::memory_order_relaxed);
+			}
+			CounterRegistry& registry = counterRegistry();
+			std::lock_guard<std::mutex> lock(registry.mutex_);
+			next_ = registry.threads_;
+			registry.threads_ = this;
+		}
+
+		inline ThreadCounters::~ThreadCounters()
+		{
+			CounterRegistry& registry = counterRegistry();
+			std::lock_guard<std::mutex> lock(registry.mutex_);
+			for (u32 i = 0; i < Size; ++i) {
+				registry.exited_[i] += values_[i].load(std::memory_order_relaxed);
+			}
+			ThreadCounters** link = &registry.threads_;
+			while (this != *link) {
+				link = &(*link)->next_;
+			}
+			*link = next_;
+		}
+
+		inline ThreadCounters& threadCounters()
+		{
+			thread_local ThreadCounters counters;
+			return counters;
+		}
+
+		/**
+		@brief Adds without a read-modify-write, because only the owner thread writes
+		*/
+		inline void count(size_t index, u64 n)
+		{
+			std::atomic<u64>& value = threadCounters().values_[index];
+			value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+		}
+
+		/**
+		@brief Counts a resize and its time until the end of the scope
+		*/
+		class ResizeTimer
+		{
+		public:
+			ResizeTimer()
+				:start_(std::chrono::steady_clock::now())
+			{}
+
+			~ResizeTimer()
+			{
+				std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+				HCOUNT(resizes_, 1);
+				HCOUNT(resizeNanoseconds_, static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start_).count()));
+			}
+		private:
+			std::chrono::steady_clock::time_point start_;
+		};
+	}
+
+	/**
+	@brief Counters of the calling thread
+	*/
+	inline Counters threadCounters()
+	{
+		Counters counters;
+		u64* values = reinterpret_cast<u64*>(&counters);
+		hash_detail::ThreadCounters& thread = hash_detail::threadCounters();
+		for (u32 i = 0; i < hash_detail::ThreadCounters::Size; ++i) {
+			values[i] = thread.values_[i].load(std::memory_order_relaxed);
+		}
+		return counters;
+	}
+
+	/**
+	@brief Sums of counters of all threads, including exited ones
+	*/
+	inline Counters totalCounters()
+	{
+		Counters counters;
+		u64* values = reinterpret_cast<u64*>(&counters);
+		hash_detail::CounterRegistry& registry = hash_detail::counterRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex_);
+		for (u32 i = 0; i < hash_detail::ThreadCounters::Size; ++i) {
+			values[i] = registry.exited_[i];
+		}
+		for (const hash_detail::ThreadCounters* thread = registry.threads_; nullptr != thread; thread = thread->next_) {
+			for (u32 i = 0; i < hash_detail::ThreadCounters::Size; ++i) {
+				values[i] += thread->values_[i].load(std::memory_order_relaxed);
+			}
+		}
+		return counters;
+	}
+
+	/**
+	@brief Zeros counters of all threads, which may lose counts of threads running on tables meanwhile
+	*/
+	inline void resetCounters()
+	{
+		hash_detail::CounterRegistry& registry = hash_detail::counterRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex_);
+		for (u32 i = 0; i < hash_detail::ThreadCounters::Size; ++i) {
+			registry.exited_[i] = 0;
+		}
+		for (hash_detail::ThreadCounters* thread = registry.threads_; nullptr != thread; thread = thread->next_) {
+			for (u32 i = 0; i < hash_detail::ThreadCounters::Size; ++i) {
+				thread->values_[i].store(0, std::memory_order_relaxed);
+			}
+		}
+	}
+#endif
+
 	namespace hash_detail
 	{
+		/**
+		@brief Seed of sphash for every table, which images record to be mapped back only by the same hash
+		*/
+		inline static constexpr u64 HashSeed = 2685821657736338717ULL;
+
 		template<class T>
 		inline u32 calcHash(const T& x)
 		{
-			return sph::sphash32(sizeof(T), reinterpret_cast<const void*>(&x));
+			return sph::sphash32(sizeof(T), reinterpret_cast<const void*>(&x), HashSeed);
+		}
+
+		template<>
+		inline u32 calcHash<std::string>(const std::string& x)
+		{
+			return sph::sphash32(x.size(), reinterpret_cast<const void*>(x.data()), HashSeed);
+		}
+
+		template<>
+		inline u32 calcHash<std::string_view>(const std::string_view& x)
+		{
+			return sph::sphash32(x.size(), reinterpret_cast<const void*>(x.data()), HashSeed);
+		}
+
+		/**
+		@brief 64 bit hash with a seed, for a construction which retries with other seeds
+		*/
+		template<class T>
+		inline u64 calcHash64(const T& x, u64 seed)
+		{
+			return sph::sphash64(sizeof(T), reinterpret_cast<const void*>(&x), seed);
+		}
+
+		template<>
+		inline u64 calcHash64<std::string>(const std::string& x, u64 seed)
+		{
+			return sph::sphash64(x.size(), reinterpret_cast<const void*>(x.data()), seed);
+		}
+
+		template<>
+		inline u64 calcHash64<std::string_view>(const std::string_view& x, u64 seed)
+		{
+			return sph::sphash64(x.size(), reinterpret_cast<const void*>(x.data()), seed);
 		}
+
+		/**
+		@brief Finalizer of MurmurHash3, which spreads every bit of x over the result
+		*/
+		inline u64 mix64(u64 x)
+		{
+			x ^= x >> 33;
+			x *= 0xFF51'AFD7'ED55'8CCDULL;
+			x ^= x >> 33;
+			x *= 0xC4CE'B9FE'1A85'EC53ULL;
+			x ^= x >> 33;
+			return x;
+		}
+
+		/**
+		@brief Whether tables keyed by Key are probed with a K as it is, without converting it to Key
+
+		Specialize together with calcHash for K, which should agree with calcHash for Key.
+		*/
+		template<class Key, class K>
+		struct is_transparent : false_type
+		{
+		};
+
+		template<>
+		struct is_transparent<std::string, std::string_view> : true_type
+		{
+		};
+
+		template<class Key, class K>
+		using transparent_t = typename std::enable_if<is_transparent<Key, K>::value, int>::type;
+
+		/**
+		@brief Whether threads can share an allocator, which is assumed unless it declares ThreadSafe as false
+		*/
+		template<class MemoryAllocator, class = void>
+		struct is_thread_safe : true_type
+		{
+		};
+
+		template<class MemoryAllocator>
+		struct is_thread_safe<MemoryAllocator, std::void_t<decltype(MemoryAllocator::ThreadSafe)>> : std::integral_constant<bool, MemoryAllocator::ThreadSafe>
+		{
+		};
 	}
 
 
@@ -115,1919 +400,6820 @@ namespace hashmap
 			}
 			return p;
 		}
-	}
-
-
-	struct HashMapHash
-	{
-		static const u32 HashMask = 0x7FFFFFFFU;
-		static const u32 OccupyFlag = 0x80000000U;
-
-		typedef u32 size_type;
-
-		void clear() { hash_ = 0; }
-		bool isEmpty() const { return 0 == (hash_ & OccupyFlag); }
-		bool isOccupy() const { return 0 != (hash_ & OccupyFlag); }
-		void setOccupy() { hash_ |= OccupyFlag; }
-		void setOccupy(size_type hash) { hash_ = OccupyFlag | hash; }
-		void setEmpty() { hash_ &= HashMask; }
-
-		size_type hash_;
-	};
 
-	template<class Key, class Value>
-	struct HashMapKeyValuePair
-	{
-		typedef Key key_type;
-		typedef Value value_type;
-
-		Key key_;
-		Value value_;
-	};
-
-	struct HashMapKeyBucket
-	{
-		static const u32 HashMask = 0x7FFFFFFFU;
-		static const u32 OccupyFlag = 0x80000000U;
-
-		void clear() { hash_ = 0; }
-		bool isOccupy() const { return 0 != (hash_ & OccupyFlag); }
-		void setOccupy() { hash_ |= OccupyFlag; }
-		void setEmpty() { hash_ &= HashMask; }
-
-		s32 index_;
-		s32 next_;
-		u32 hash_;
-	};
-
-	//-----------------------------------------------------------------------------
-	//---
-	//--- HashMap
-	//---
-	//-----------------------------------------------------------------------------
-	template<class Key, class Value, class MemoryAllocator = DefaultAllocator>
-	class HashMap
-	{
-	public:
-		static const u32 Align = 4;
-		static const u32 AlignMask = Align - 1;
-
-		typedef Key key_type;
-		typedef Value value_type;
-		typedef HashMapKeyBucket bucket_type;
-		typedef MemoryAllocator memory_allocator;
-
-		typedef HashMap<Key, Value, MemoryAllocator> this_type;
-
-		typedef u32 size_type;
-		typedef size_type iterator;
-
-		typedef hash_detail::type_traits<value_type> value_traits;
-		typedef typename value_traits::pointer value_pointer;
-		typedef typename value_traits::const_pointer const_value_pointer;
-		typedef typename value_traits::reference value_reference;
-		typedef typename value_traits::const_reference const_value_reference;
-		typedef typename value_traits::pointer pointer;
-		typedef typename value_traits::const_pointer const_pointer;
-		typedef typename value_traits::reference reference;
-		typedef typename value_traits::const_reference const_reference;
-		typedef typename value_traits::param_type value_param_type;
-		typedef typename value_traits::const_param_type const_value_param_type;
-
-
-		typedef hash_detail::type_traits<key_type> key_traits;
-		typedef typename key_traits::pointer key_pointer;
-		typedef typename key_traits::const_pointer const_key_pointer;
-		typedef typename key_traits::reference key_reference;
-		typedef typename key_traits::const_reference const_key_reference;
-		typedef typename key_traits::param_type key_param_type;
-		typedef typename key_traits::const_param_type const_key_param_type;
-
-		HashMap();
-		explicit HashMap(size_type capacity);
-		~HashMap();
-
-		void initialize(size_type capacity)
+		/**
+		@brief The smallest power of two not less than n, at least 2
+		*/
+		inline u32 next_pow2(u32 n)
 		{
-			destroy();
-			create(capacity);
+			if (0x8000'0000UL < n) {
+				return 0x8000'0000UL;
+			}
+			return (n <= 2) ? 2 : (0x01UL << log2(n));
 		}
 
-		size_type capacity() const
+		/**
+		@brief Number of keys hashed and prefetched ahead in a batched lookup
+		*/
+		inline static constexpr u32 PrefetchWindow = 16;
+
+		inline void prefetch(const void* address)
 		{
-			return capacity_;
+			_mm_prefetch(reinterpret_cast<const char*>(address), _MM_HINT_T0);
 		}
 
-		size_type size() const
+		/**
+		@brief Number of pairs sorted at a time in a batched insertion
+		*/
+		inline static constexpr u32 InsertChunk = 64 * 1024;
+
+		/**
+		@brief Size of a cache line, to which data shared between threads is padded
+		*/
+		inline static constexpr u32 CacheLineSize = 64;
+
+		/**
+		@brief Sorts entries of (hash << 32 | index) by home positions, with LSD radix sort over 8 bit digits
+		@return entries or work, whichever holds the result
+		@param maxHome ... upper bound of home positions
+		@param home ... maps a hash to its home position
+		*/
+		template<class Home>
+		u64* sortByHome(u32 n, u64* entries, u64* work, u32 maxHome, Home home)
 		{
-			return size_;
+			for (u32 shift = 0; shift < 32 && 0 != (maxHome >> shift); shift += 8) {
+				u32 counts[256] = {};
+				for (u32 i = 0; i < n; ++i) {
+					++counts[(home(static_cast<u32>(entries[i] >> 32)) >> shift) & 0xFFU];
+				}
+				u32 offset = 0;
+				for (u32 i = 0; i < 256; ++i) {
+					u32 count = counts[i];
+					counts[i] = offset;
+					offset += count;
+				}
+				for (u32 i = 0; i < n; ++i) {
+					u32 digit = (home(static_cast<u32>(entries[i] >> 32)) >> shift) & 0xFFU;
+					work[counts[digit]++] = entries[i];
+				}
+				hashmap::swap(entries, work);
+			}
+			return entries;
 		}
 
-		void clear();
+		/**
+		@brief Number of entries below which an expansion does not spawn threads, which costs more than it saves
+		*/
+		inline static constexpr u32 ParallelRehashMinimum = 64 * 1024;
 
-		bool valid(size_type pos) const
+		/**
+		@brief Result of placing an entry within a region of a table, which a thread owns
+		*/
+		enum class Placement
 		{
-			return (pos < capacity_);
-		}
+			Placed,
+			Exists,
+			Deferred,
+		};
 
-		size_type find(const_key_param_type key) const
+		/**
+		@brief Calls func(i) for each i in [0, n), on n threads including the caller
+		*/
+		template<class Func>
+		void parallelFor(u32 n, Func func)
 		{
-			return (0 < capacity_) ? find_(key, calcHash_(key)) : end();
+			std::thread* threads = (1 < n) ? HNEW std::thread[n - 1] : NULL;
+			for (u32 i = 1; i < n; ++i) {
+				threads[i - 1] = std::thread(func, i);
+			}
+			func(0);
+			for (u32 i = 1; i < n; ++i) {
+				threads[i - 1].join();
+			}
+			HDELETE_ARRAY(threads);
 		}
 
-		bool insert(const_key_param_type key, const_value_param_type value);
-
-		void erase(const_key_param_type key);
-		void eraseAt(size_type pos);
-		void swap(this_type& rhs);
-
-		iterator begin() const;
+		/**
+		@brief First home position of a region, in which region r takes homes h such that r == h * regions / homes
+		*/
+		inline u32 regionBegin(u32 region, u32 regions, u32 homes)
+		{
+			return static_cast<u32>((static_cast<u64>(region) * homes + regions - 1) / regions);
+		}
 
-		iterator end() const
+		/**
+		@brief Groups entries of an old table by regions of home positions in a new table, with a thread per region
+		@return size entries of (hash << 32 | old position), allocated with allocator, in which region r takes [offsets[r], offsets[r+1])
+		@param allocator ... allocator of the table
+		@param regions ... number of threads and regions
+		@param capacity ... number of slots in the old table
+		@param occupied ... whether an old slot holds an entry
+		@param hashAt ... hash of an old slot
+		@param homes ... number of home positions in the new table
+		@param home ... maps a hash to its home position in the new table
+		*/
+		template<class MemoryAllocator, class Occupied, class HashAt, class Home>
+		u64* partitionByRegion(const MemoryAllocator& allocator, u32 regions, u32 capacity, u32 size, Occupied occupied, HashAt hashAt, u32 homes, Home home, u32* offsets)
 		{
-			return capacity_;
+			u32* hashes = reinterpret_cast<u32*>(HALLOCATOR_MALLOC(allocator, sizeof(u32) * capacity));
+			u32* starts = reinterpret_cast<u32*>(HALLOCATOR_MALLOC(allocator, sizeof(u32) * regions * regions));
+			u64* entries = reinterpret_cast<u64*>(HALLOCATOR_MALLOC(allocator, sizeof(u64) * size));
+			auto regionOf = [regions, homes, &home](u32 hash) {
+				return static_cast<u32>((static_cast<u64>(home(hash)) * regions) / homes);
+			};
+
+			//Count entries of each old chunk by regions, then place each chunk at its offset in each region
+			parallelFor(regions, [&](u32 t) {
+				u32* counts = starts + t * regions;
+				for (u32 r = 0; r < regions; ++r) {
+					counts[r] = 0;
+				}
+				u32 end = static_cast<u32>((static_cast<u64>(t + 1) * capacity) / regions);
+				for (u32 i = static_cast<u32>((static_cast<u64>(t) * capacity) / regions); i < end; ++i) {
+					if (occupied(i)) {
+						hashes[i] = hashAt(i);
+						++counts[regionOf(hashes[i])];
+					}
+				}
+			});
+			u32 offset = 0;
+			for (u32 r = 0; r < regions; ++r) {
+				offsets[r] = offset;
+				for (u32 t = 0; t < regions; ++t) {
+					u32 count = starts[t * regions + r];
+					starts[t * regions + r] = offset;
+					offset += count;
+				}
+			}
+			offsets[regions] = offset;
+			HASSERT(offset == size);
+			parallelFor(regions, [&](u32 t) {
+				u32* starts_t = starts + t * regions;
+				u32 end = static_cast<u32>((static_cast<u64>(t + 1) * capacity) / regions);
+				for (u32 i = static_cast<u32>((static_cast<u64>(t) * capacity) / regions); i < end; ++i) {
+					if (occupied(i)) {
+						entries[starts_t[regionOf(hashes[i])]++] = (static_cast<u64>(hashes[i]) << 32) | i;
+					}
+				}
+			});
+			HALLOCATOR_FREE(allocator, starts);
+			HALLOCATOR_FREE(allocator, hashes);
+			return entries;
 		}
 
-		iterator next(iterator pos) const;
+		/**
+		@brief Header of a table image, which the memory block of the table follows
+		*/
+		struct alignas(CacheLineSize) ImageHeader
+		{
+			inline static constexpr u32 Magic = 0x474D'4948UL; //HIMG
+			inline static constexpr u32 Version = 3;
+
+			u32 magic_;
+			u32 version_;
+			u32 kind_;
+			/// Id of the index policy, which decides home positions
+			u32 indexPolicy_;
+			/// Id of the growth policy, which decides load limits
+			u32 growthPolicy_;
+			u32 keySize_;
+			u32 valueSize_;
+			u32 capacity_;
+			u32 size_;
+			u32 reserved_;
+			u64 seed_;
+			u64 bytes_;
+			u64 checksum_;
+		};
 
-		reference getValue(size_type pos)
+		/**
+		@brief Identifies the format of a memory block, by a tag of a table and parameters which change the block
+		*/
+		inline constexpr u32 imageKind(u8 table, bool storeHash, bool aos, u32 block)
 		{
-			HASSERT(0 <= pos && pos < capacity_);
-			return values_[pos];
+			return (static_cast<u32>(table) << 24) | ((block & 0xFFFFU) << 8) | (aos ? 0x02U : 0x00U) | (storeHash ? 0x01U : 0x00U);
 		}
 
-		const_reference getValue(size_type pos) const
+		/**
+		@brief Writes a header and a memory block of bytes
+		*/
+		inline bool writeImage(const char* path, u32 kind, u32 indexPolicy, u32 growthPolicy, u32 keySize, u32 valueSize, u32 capacity, u32 size, const void* data, u64 bytes)
 		{
-			HASSERT(0 <= pos && pos < capacity_);
-			return values_[pos];
+			ImageHeader header = {};
+			header.magic_ = ImageHeader::Magic;
+			header.version_ = ImageHeader::Version;
+			header.kind_ = kind;
+			header.indexPolicy_ = indexPolicy;
+			header.growthPolicy_ = growthPolicy;
+			header.keySize_ = keySize;
+			header.valueSize_ = valueSize;
+			header.capacity_ = capacity;
+			header.size_ = size;
+			header.seed_ = HashSeed;
+			header.bytes_ = bytes;
+			header.checksum_ = (0 < bytes) ? sph::sphash64(bytes, data, HashSeed) : 0;
+
+			FILE* file = ::fopen(path, "wb");
+			if (nullptr == file) {
+				return false;
+			}
+			bool result = (1 == ::fwrite(&header, sizeof(ImageHeader), 1, file));
+			result = result && (bytes <= 0 || 1 == ::fwrite(data, bytes, 1, file));
+			return (0 == ::fclose(file)) && result;
 		}
 
-		key_reference getKey(size_type pos)
+		/**
+		@brief Checks an image against the format of a table
+		@return the header, or nullptr if the image does not match
+		@param verify ... whether to compare the checksum, which reads the whole image
+		*/
+		inline const ImageHeader* readImage(const u8* image, u64 size, u32 kind, u32 indexPolicy, u32 growthPolicy, u32 keySize, u32 valueSize, bool verify)
 		{
-			HASSERT(0 <= pos && pos < capacity_);
-			return keys_[pos];
+			if (nullptr == image || size < sizeof(ImageHeader)) {
+				return nullptr;
+			}
+			const ImageHeader* header = reinterpret_cast<const ImageHeader*>(image);
+			if (ImageHeader::Magic != header->magic_
+				|| ImageHeader::Version != header->version_
+				|| kind != header->kind_
+				|| indexPolicy != header->indexPolicy_
+				|| growthPolicy != header->growthPolicy_
+				|| keySize != header->keySize_
+				|| valueSize != header->valueSize_
+				|| HashSeed != header->seed_
+				|| (size - sizeof(ImageHeader)) != header->bytes_) {
+				return nullptr;
+			}
+			if (verify && 0 < header->bytes_ && header->checksum_ != sph::sphash64(header->bytes_, header + 1, HashSeed)) {
+				return nullptr;
+			}
+			return header;
 		}
 
-		const_key_reference getKey(size_type pos) const
+		/**
+		@brief Read only mapping of a whole file
+		*/
+		class MappedFile
 		{
-			HASSERT(0 <= pos && pos < capacity_);
-			return keys_[pos];
-		}
+		public:
+			MappedFile()
+				:data_(nullptr)
+				, size_(0)
+			{}
 
-	private:
-		HashMap(const HashMap&) = delete;
-		HashMap& operator=(const HashMap&) = delete;
+			~MappedFile()
+			{
+				close();
+			}
+
+			bool open(const char* path)
+			{
+				close();
+#if defined(_WIN32)
+				HANDLE file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+				if (INVALID_HANDLE_VALUE == file) {
+					return false;
+				}
+				LARGE_INTEGER size;
+				if (!::GetFileSizeEx(file, &size) || size.QuadPart <= 0) {
+					::CloseHandle(file);
+					return false;
+				}
+				//The view stays valid after the handles are closed
+				HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				::CloseHandle(file);
+				if (nullptr == mapping) {
+					return false;
+				}
+				void* data = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				::CloseHandle(mapping);
+				if (nullptr == data) {
+					return false;
+				}
+				data_ = reinterpret_cast<const u8*>(data);
+				size_ = static_cast<u64>(size.QuadPart);
+#else
+				int file = ::open(path, O_RDONLY);
+				if (file < 0) {
+					return false;
+				}
+				struct stat status;
+				if (0 != ::fstat(file, &status) || status.st_size <= 0) {
+					::close(file);
+					return false;
+				}
+				//The mapping stays valid after the descriptor is closed
+				void* data = ::mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, file, 0);
+				::close(file);
+				if (MAP_FAILED == data) {
+					return false;
+				}
+				data_ = reinterpret_cast<const u8*>(data);
+				size_ = static_cast<u64>(status.st_size);
+#endif
+				return true;
+			}
+
+			void close()
+			{
+				if (nullptr == data_) {
+					return;
+				}
+#if defined(_WIN32)
+				::UnmapViewOfFile(data_);
+#else
+				::munmap(const_cast<u8*>(data_), static_cast<size_t>(size_));
+#endif
+				data_ = nullptr;
+				size_ = 0;
+			}
+
+			const u8* data() const
+			{
+				return data_;
+			}
+
+			u64 size() const
+			{
+				return size_;
+			}
+		private:
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			const u8* data_;
+			u64 size_;
+		};
+	}
+
+
+	/**
+	@brief Growth policy shared by tables
+	@tparam MaxLoadPercent ... maximum ratio of entries to capacity, in percent, which SwissTable caps at 7/8
+	@tparam GrowthPercent ... ratio of a new capacity to an old one on expansion, in percent
+	@tparam MinCapacity ... minimum capacity to allocate
+	*/
+	template<u32 MaxLoadPercent = 87, u32 GrowthPercent = 200, u32 MinCapacity = 16>
+	struct GrowthPolicy
+	{
+		static_assert(0 < MaxLoadPercent && MaxLoadPercent <= 100, "MaxLoadPercent should be in (0, 100]");
+		static_assert(100 < GrowthPercent, "GrowthPercent should be greater than 100");
+
+		inline static constexpr u32 MaxLoad = MaxLoadPercent;
+		inline static constexpr u32 Growth = GrowthPercent;
+		inline static constexpr u32 Minimum = MinCapacity;
+		/// Identifies the parameters in table images
+		inline static constexpr u32 Id = (MaxLoadPercent << 24) | ((GrowthPercent & 0xFFFU) << 12) | (MinCapacity & 0xFFFU);
+
+		/**
+		@brief Maximum number of entries for a capacity
+		*/
+		static u32 maxSize(u32 capacity)
+		{
+			return static_cast<u32>((static_cast<u64>(capacity) * MaxLoadPercent) / 100);
+		}
+
+		/**
+		@brief Smallest capacity to hold size entries
+		*/
+		static u32 capacityFor(u32 size)
+		{
+			u64 capacity = (static_cast<u64>(size) * 100 + MaxLoadPercent - 1) / MaxLoadPercent;
+			capacity = (capacity < MinCapacity) ? MinCapacity : capacity;
+			return (capacity < 0xFFFF'FFFFULL) ? static_cast<u32>(capacity) : 0xFFFF'FFFFUL;
+		}
+
+		/**
+		@brief Capacity to grow into from a current capacity
+		*/
+		static u32 nextCapacity(u32 capacity)
+		{
+			u64 next = (static_cast<u64>(capacity) * GrowthPercent) / 100;
+			next = (next <= capacity) ? static_cast<u64>(capacity) + 1 : next;
+			next = (next < MinCapacity) ? MinCapacity : next;
+			return (next < 0xFFFF'FFFFULL) ? static_cast<u32>(next) : 0xFFFF'FFFFUL;
+		}
+	};
+
+	typedef GrowthPolicy<> DefaultGrowthPolicy;
+
+	/**
+	@brief Maps a hash to a position by modulo over a prime capacity
+
+	Robust against weak hashes, at the cost of an integer division.
+	*/
+	struct PrimeIndexPolicy
+	{
+		/// Identifies the policy in table images
+		inline static constexpr u32 Id = 1;
+		inline static constexpr bool PowerOfTwo = false;
+
+		static u32 roundCapacity(u32 capacity)
+		{
+			return hash_detail::next_prime(capacity);
+		}
+
+		void reset(u32 capacity)
+		{
+			capacity_ = capacity;
+		}
+
+		u32 index(u32 hash) const
+		{
+			return hash % capacity_;
+		}
+
+		u32 capacity_;
+	};
+
+	/**
+	@brief Maps a hash to a position by masking lower bits over a power of two capacity
+	*/
+	struct MaskIndexPolicy
+	{
+		/// Identifies the policy in table images
+		inline static constexpr u32 Id = 2;
+		inline static constexpr bool PowerOfTwo = true;
+
+		static u32 roundCapacity(u32 capacity)
+		{
+			return hash_detail::next_pow2(capacity);
+		}
+
+		void reset(u32 capacity)
+		{
+			mask_ = capacity - 1;
+		}
+
+		u32 index(u32 hash) const
+		{
+			return hash & mask_;
+		}
+
+		u32 mask_;
+	};
+
+	/**
+	@brief Maps a hash to a position by Fibonacci hashing over a power of two capacity
+
+	Takes upper bits of the product with 2^64/phi, so that all bits of a hash affect a position.
+	*/
+	struct FibonacciIndexPolicy
+	{
+		/// Identifies the policy in table images
+		inline static constexpr u32 Id = 3;
+		inline static constexpr bool PowerOfTwo = true;
+
+		static u32 roundCapacity(u32 capacity)
+		{
+			return hash_detail::next_pow2(capacity);
+		}
+
+		void reset(u32 capacity)
+		{
+			shift_ = 64 - hash_detail::log2(capacity);
+		}
+
+		u32 index(u32 hash) const
+		{
+			return static_cast<u32>((hash * 0x9E37'79B9'7F4A'7C15ULL) >> shift_);
+		}
+
+		u32 shift_;
+	};
+
+	/**
+	@brief Keeps keys and values in two separate arrays
+
+	Scans over keys stay dense, a hit touches a key line and a value line.
+	*/
+	struct SoALayout
+	{
+		template<class Key, class Value>
+		class Slots
+		{
+		public:
+			Slots()
+				:keys_(nullptr)
+				, values_(nullptr)
+			{}
+
+			/**
+			@brief Bytes to hold capacity slots
+			*/
+			static u64 bytes(u64 capacity)
+			{
+				return valueOffset(capacity) + sizeof(Value) * capacity;
+			}
+
+			void bind(u8* memory, u64 capacity)
+			{
+				keys_ = reinterpret_cast<Key*>(memory);
+				values_ = reinterpret_cast<Value*>(memory + valueOffset(capacity));
+			}
+
+			void reset()
+			{
+				keys_ = nullptr;
+				values_ = nullptr;
+			}
+
+			void* data() const
+			{
+				return keys_;
+			}
+
+			Key& key(u64 index){ return keys_[index]; }
+			const Key& key(u64 index) const{ return keys_[index]; }
+			Value& value(u64 index){ return values_[index]; }
+			const Value& value(u64 index) const{ return values_[index]; }
+
+			void swap(Slots& rhs)
+			{
+				hashmap::swap(keys_, rhs.keys_);
+				hashmap::swap(values_, rhs.values_);
+			}
+		private:
+			/**
+			@brief Values start at a cache line, or at the alignment of Value if it is larger
+			*/
+			static u64 valueOffset(u64 capacity)
+			{
+				static constexpr u64 Mask = ((alignof(Value) < hash_detail::CacheLineSize) ? hash_detail::CacheLineSize : alignof(Value)) - 1;
+				return (sizeof(Key) * capacity + Mask) & ~Mask;
+			}
+
+			Key* keys_;
+			Value* values_;
+		};
+	};
+
+	/**
+	@brief Keeps a key and its value side by side in one slot
+
+	A hit touches one line when a pair fits in it.
+	*/
+	struct AoSLayout
+	{
+		template<class Key, class Value>
+		class Slots
+		{
+		public:
+			Slots()
+				:slots_(nullptr)
+			{}
+
+			/**
+			@brief Bytes to hold capacity slots
+			*/
+			static u64 bytes(u64 capacity)
+			{
+				return sizeof(Slot) * capacity;
+			}
+
+			void bind(u8* memory, u64)
+			{
+				slots_ = reinterpret_cast<Slot*>(memory);
+			}
+
+			void reset()
+			{
+				slots_ = nullptr;
+			}
+
+			void* data() const
+			{
+				return slots_;
+			}
+
+			Key& key(u64 index){ return *reinterpret_cast<Key*>(slots_[index].key_); }
+			const Key& key(u64 index) const{ return *reinterpret_cast<const Key*>(slots_[index].key_); }
+			Value& value(u64 index){ return *reinterpret_cast<Value*>(slots_[index].value_); }
+			const Value& value(u64 index) const{ return *reinterpret_cast<const Value*>(slots_[index].value_); }
+
+			void swap(Slots& rhs)
+			{
+				hashmap::swap(slots_, rhs.slots_);
+			}
+		private:
+			struct Slot
+			{
+				alignas(Key) u8 key_[sizeof(Key)];
+				alignas(Value) u8 value_[sizeof(Value)];
+			};
+
+			Slot* slots_;
+		};
+	};
+
+	/**
+	@brief Memory and occupancy of a table, which stats() of each table reports
+
+	A probe length is how far an entry sits from where a lookup for it starts,
+	the depth in a chain for HashMap, the hop offset for Hopscotch, the distance for Robin Hood,
+	and the number of groups before the group of the entry for SwissTable.
+	*/
+	struct TableStats
+	{
+		inline static constexpr u32 Histogram = 16;
+
+		TableStats()
+		{
+			clear();
+		}
+
+		void clear()
+		{
+			bytes_ = 0;
+			capacity_ = 0;
+			size_ = 0;
+			tombstones_ = 0;
+			maxProbe_ = 0;
+			totalProbe_ = 0;
+			for (u32 i = 0; i < Histogram; ++i) {
+				probes_[i] = 0;
+			}
+		}
+
+		void addProbe(u64 probe)
+		{
+			++probes_[(probe < Histogram) ? probe : Histogram - 1];
+			maxProbe_ = (maxProbe_ < probe) ? probe : maxProbe_;
+			totalProbe_ += probe;
+		}
+
+		/**
+		@brief Sums stats of parts of a table, such as shards
+		*/
+		void merge(const TableStats& x)
+		{
+			bytes_ += x.bytes_;
+			capacity_ += x.capacity_;
+			size_ += x.size_;
+			tombstones_ += x.tombstones_;
+			maxProbe_ = (maxProbe_ < x.maxProbe_) ? x.maxProbe_ : maxProbe_;
+			totalProbe_ += x.totalProbe_;
+			for (u32 i = 0; i < Histogram; ++i) {
+				probes_[i] += x.probes_[i];
+			}
+		}
+
+		f64 load() const
+		{
+			return (0 < capacity_) ? static_cast<f64>(size_) / capacity_ : 0.0;
+		}
+
+		f64 bytesPerEntry() const
+		{
+			return (0 < size_) ? static_cast<f64>(bytes_) / size_ : 0.0;
+		}
+
+		f64 meanProbe() const
+		{
+			return (0 < size_) ? static_cast<f64>(totalProbe_) / size_ : 0.0;
+		}
+
+		/// Bytes of the blocks a table holds, not including memory owned by keys and values
+		u64 bytes_;
+		u64 capacity_;
+		u64 size_;
+		/// Erased slots which still lengthen probes
+		u64 tombstones_;
+		u64 maxProbe_;
+		u64 totalProbe_;
+		/// Number of entries for each probe length, in which the last one counts longer probes too
+		u64 probes_[Histogram];
+	};
+
+	/**
+	@brief Resize or rehash of a table, which an observer receives before and after it
+	*/
+	struct ResizeEvent
+	{
+		enum class Kind
+		{
+			Grow,
+			/// Rehash into the same capacity, to reclaim tombstones
+			Rehash,
+			Shrink,
+		};
+
+		enum class Phase
+		{
+			Before,
+			After,
+		};
+
+		Kind kind_;
+		Phase phase_;
+		u32 oldCapacity_;
+		u32 newCapacity_;
+		/// Entries rehashed into the new capacity between the two events, 0 for the swap of IncrementalResize
+		u32 moved_;
+		/// Time from the before event to the after event, 0 before
+		u64 nanoseconds_;
+	};
+
+	/**
+	@brief Function called on the thread which causes a resize, while the table is in the middle of an insertion
+	@param user ... pointer given with the observer
+	*/
+	typedef void (*ResizeObserver)(const ResizeEvent& event, void* user);
+
+	namespace hash_detail
+	{
+		/**
+		@brief Calls an observer before a resize, and after it at the end of the scope, doing nothing without an observer
+		*/
+		class ResizeNotifier
+		{
+		public:
+			ResizeNotifier(ResizeObserver observer, void* user, u32 oldCapacity, u32 newCapacity, u32 moved)
+				:observer_(observer)
+				, user_(user)
+			{
+				if (nullptr == observer_) {
+					return;
+				}
+				event_.kind_ = (oldCapacity < newCapacity) ? ResizeEvent::Kind::Grow : ((newCapacity < oldCapacity) ? ResizeEvent::Kind::Shrink : ResizeEvent::Kind::Rehash);
+				event_.phase_ = ResizeEvent::Phase::Before;
+				event_.oldCapacity_ = oldCapacity;
+				event_.newCapacity_ = newCapacity;
+				event_.moved_ = moved;
+				event_.nanoseconds_ = 0;
+				observer_(event_, user_);
+				start_ = std::chrono::steady_clock::now();
+			}
+
+			~ResizeNotifier()
+			{
+				if (nullptr == observer_) {
+					return;
+				}
+				std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+				event_.phase_ = ResizeEvent::Phase::After;
+				event_.nanoseconds_ = static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start_).count());
+				observer_(event_, user_);
+			}
+		private:
+			ResizeNotifier(const ResizeNotifier&) = delete;
+			ResizeNotifier& operator=(const ResizeNotifier&) = delete;
+
+			ResizeObserver observer_;
+			void* user_;
+			ResizeEvent event_;
+			std::chrono::steady_clock::time_point start_;
+		};
+	}
+
+	struct HashMapHash
+	{
+		static const u32 HashMask = 0x7FFFFFFFU;
+		static const u32 OccupyFlag = 0x80000000U;
+
+		typedef u32 size_type;
+
+		void clear() { hash_ = 0; }
+		bool isEmpty() const { return 0 == (hash_ & OccupyFlag); }
+		bool isOccupy() const { return 0 != (hash_ & OccupyFlag); }
+		void setOccupy() { hash_ |= OccupyFlag; }
+		void setOccupy(size_type hash) { hash_ = OccupyFlag | hash; }
+		void setEmpty() { hash_ &= HashMask; }
+
+		size_type hash_;
+	};
+
+	template<class Key, class Value>
+	struct HashMapKeyValuePair
+	{
+		typedef Key key_type;
+		typedef Value value_type;
+
+		Key key_;
+		Value value_;
+	};
+
+	struct HashMapKeyBucket
+	{
+		static const u32 HashMask = 0x7FFFFFFFU;
+		static const u32 OccupyFlag = 0x80000000U;
+
+		void clear() { hash_ = 0; }
+		bool isOccupy() const { return 0 != (hash_ & OccupyFlag); }
+		void setOccupy() { hash_ |= OccupyFlag; }
+		void setEmpty() { hash_ &= HashMask; }
+
+		s32 index_;
+		s32 next_;
+		u32 hash_;
+	};
+
+	//-----------------------------------------------------------------------------
+	//---
+	//--- HashMap
+	//---
+	//-----------------------------------------------------------------------------
+	template<class Key, class Value, class MemoryAllocator = DefaultAllocator, class GrowthPolicy = DefaultGrowthPolicy, class IndexPolicy = PrimeIndexPolicy, class Layout = SoALayout>
+	class HashMap
+	{
+	public:
+		/// Each sub-array of a table starts at a cache line
+		static const u32 Align = hash_detail::CacheLineSize;
+		static const u32 AlignMask = Align - 1;
+
+		typedef Key key_type;
+		typedef Value value_type;
+		typedef HashMapKeyBucket bucket_type;
+		typedef MemoryAllocator memory_allocator;
+		typedef GrowthPolicy growth_policy;
+		typedef IndexPolicy index_policy;
+		typedef Layout layout_policy;
+		typedef typename Layout::template Slots<Key, Value> slots_type;
+
+		typedef HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout> this_type;
+
+		typedef u32 size_type;
+		typedef size_type iterator;
+
+		typedef hash_detail::type_traits<value_type> value_traits;
+		typedef typename value_traits::pointer value_pointer;
+		typedef typename value_traits::const_pointer const_value_pointer;
+		typedef typename value_traits::reference value_reference;
+		typedef typename value_traits::const_reference const_value_reference;
+		typedef typename value_traits::pointer pointer;
+		typedef typename value_traits::const_pointer const_pointer;
+		typedef typename value_traits::reference reference;
+		typedef typename value_traits::const_reference const_reference;
+		typedef typename value_traits::param_type value_param_type;
+		typedef typename value_traits::const_param_type const_value_param_type;
+
+
+		typedef hash_detail::type_traits<key_type> key_traits;
+		typedef typename key_traits::pointer key_pointer;
+		typedef typename key_traits::const_pointer const_key_pointer;
+		typedef typename key_traits::reference key_reference;
+		typedef typename key_traits::const_reference const_key_reference;
+		typedef typename key_traits::param_type key_param_type;
+		typedef typename key_traits::const_param_type const_key_param_type;
+
+		HashMap();
+		explicit HashMap(size_type capacity);
+		/**
+		@param allocator ... copied into the table, every block of the table is drawn from it
+		*/
+		explicit HashMap(const memory_allocator& allocator);
+		HashMap(size_type capacity, const memory_allocator& allocator);
+		~HashMap();
+
+		void initialize(size_type capacity)
+		{
+			destroy();
+			create(capacity);
+		}
+
+		size_type capacity() const
+		{
+			return capacity_;
+		}
+
+		size_type size() const
+		{
+			return size_;
+		}
+		/**
+		@brief Walks every slot, which takes time in proportion to the capacity
+		*/
+		TableStats stats() const;
+
+		void clear();
+
+		bool valid(size_type pos) const
+		{
+			return (pos < capacity_);
+		}
+
+		size_type find(const_key_param_type key) const
+		{
+			return (0 < capacity_) ? find_(key, calcHash_(key)) : end();
+		}
+
+		/**
+		@brief Finds n keys at once, out[i] receives the position of keys[i] or end()
+
+		Hashes and prefetches a window of keys before resolving them, so that cache misses overlap.
+		*/
+		void findBatch(const key_type* keys, size_type n, iterator* out) const;
+
+		bool insert(const_key_param_type key, const_value_param_type value);
+		bool insert(key_type&& key, value_type&& value);
+
+		/**
+		@brief Constructs a key from key and a value from args in place, unless the key exists
+
+		key is converted to key_type first, unless it is a key_type or a transparent key.
+		*/
+		template<class KeyArg, class... Args>
+		bool emplace(KeyArg&& key, Args&&... args);
+
+		/**
+		@brief Constructs a value from args in place, only if the key does not exist
+
+		args are left untouched if the key exists.
+		*/
+		template<class... Args>
+		bool try_emplace(const_key_param_type key, Args&&... args);
+		template<class... Args>
+		bool try_emplace(key_type&& key, Args&&... args);
+
+		/**
+		@brief Inserts n pairs at once, returns the number of inserted pairs
+
+		Reserves capacity once, then places pairs in order of their home positions so that writes stream.
+		*/
+		size_type insertBatch(const key_type* keys, const value_type* values, size_type n);
+
+		void erase(const_key_param_type key);
+
+		/**
+		@brief Transparent versions, which take a key-like K such as std::string_view for std::string keys
+
+		insert converts key to key_type only when it places the new entry.
+		*/
+		template<class K, hash_detail::transparent_t<Key, K> = 0>
+		size_type find(const K& key) const;
+		template<class K, hash_detail::transparent_t<Key, K> = 0>
+		bool insert(const K& key, const_value_param_type value);
+		template<class K, hash_detail::transparent_t<Key, K> = 0>
+		void erase(const K& key);
+		void eraseAt(size_type pos);
+
+		/**
+		@brief Moves the entry at pos into dst, and erases it from this table
+
+		dst should not hold the key, which is placed without a lookup.
+		*/
+		void moveAt(size_type pos, this_type& dst);
+		/**
+		@brief Allocator, which tables created by growth share
+		*/
+		const memory_allocator& getAllocator() const;
+		/**
+		@brief Sets a function called before and after every resize or rehash, which stays with this table on swap
+		@param observer ... nullptr to stop observing
+		@param user ... passed to observer as it is
+		*/
+		void setResizeObserver(ResizeObserver observer, void* user);
+		/**
+		@brief Capacity which a table gets for a requested capacity
+		*/
+		static size_type roundCapacity(size_type capacity);
+		/**
+		@brief Number of insertions left before the table grows by its load
+		*/
+		size_type available() const;
+		/**
+		@brief Smallest capacity which holds size entries without growing by its load
+		*/
+		static size_type capacityFor(size_type size);
+		void swap(this_type& rhs);
+
+		iterator begin() const;
+
+		iterator end() const
+		{
+			return capacity_;
+		}
+
+		iterator next(iterator pos) const;
+
+		reference getValue(size_type pos)
+		{
+			HASSERT(0 <= pos && pos < capacity_);
+			return slots_.value(pos);
+		}
+
+		const_reference getValue(size_type pos) const
+		{
+			HASSERT(0 <= pos && pos < capacity_);
+			return slots_.value(pos);
+		}
+
+		key_reference getKey(size_type pos)
+		{
+			HASSERT(0 <= pos && pos < capacity_);
+			return slots_.key(pos);
+		}
+
+		const_key_reference getKey(size_type pos) const
+		{
+			HASSERT(0 <= pos && pos < capacity_);
+			return slots_.key(pos);
+		}
+
+		/**
+		@brief Number of threads to rehash with on expansion, 1 by default
+		*/
+		void setRehashThreads(u32 threads)
+		{
+			threads_ = (0 < threads) ? threads : 1;
+		}
+
+		u32 getRehashThreads() const
+		{
+			return threads_;
+		}
+	private:
+		HashMap(const HashMap&) = delete;
+		HashMap& operator=(const HashMap&) = delete;
+
+		template<class K>
+		size_type calcHash_(const K& key) const
+		{
+			return hash_detail::calcHash(key) & bucket_type::HashMask;
+		}
+
+		static inline size_type align(size_type x)
+		{
+			return (x + AlignMask) & (~AlignMask);
+		}
+
+		void expand(size_type capacity);
+		void expandParallel_(this_type& dst);
+
+		template<class K>
+		size_type find_(const K& key, size_type hash) const;
+		template<class KeyArg, class... Args>
+		bool tryInsert_(size_type hash, KeyArg&& key, Args&&... args);
+		template<class KeyArg, class... Args>
+		void insert_(size_type hash, KeyArg&& key, Args&&... args);
+		void erase_(size_type pos, u32 rawHash);
+
+		void create(size_type capacity);
+		void destroy();
+
+		size_type capacity_;
+		index_policy index_;
+		size_type size_;
+		s32 empty_;
+		s32 freeList_;
+		bucket_type* buckets_;
+		slots_type slots_;
+		u32 threads_;
+		memory_allocator allocator_;
+		ResizeObserver observer_;
+		void* observerUser_;
+	};
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::HashMap()
+		:capacity_(0)
+		, index_()
+		, size_(0)
+		, empty_(0)
+		, freeList_(-1)
+		, buckets_(NULL)
+		, slots_()
+		, threads_(1)
+		, allocator_()
+		, observer_(nullptr)
+		, observerUser_(nullptr)
+	{}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::HashMap(size_type capacity)
+		:capacity_(0)
+		, index_()
+		, size_(0)
+		, empty_(0)
+		, freeList_(-1)
+		, buckets_(NULL)
+		, slots_()
+		, threads_(1)
+		, allocator_()
+		, observer_(nullptr)
+		, observerUser_(nullptr)
+	{
+		create(capacity);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::HashMap(const memory_allocator& allocator)
+		:capacity_(0)
+		, index_()
+		, size_(0)
+		, empty_(0)
+		, freeList_(-1)
+		, buckets_(NULL)
+		, slots_()
+		, threads_(1)
+		, allocator_(allocator)
+		, observer_(nullptr)
+		, observerUser_(nullptr)
+	{}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::HashMap(size_type capacity, const memory_allocator& allocator)
+		:capacity_(0)
+		, index_()
+		, size_(0)
+		, empty_(0)
+		, freeList_(-1)
+		, buckets_(NULL)
+		, slots_()
+		, threads_(1)
+		, allocator_(allocator)
+		, observer_(nullptr)
+		, observerUser_(nullptr)
+	{
+		create(capacity);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::~HashMap()
+	{
+		destroy();
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	void HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::clear()
+	{
+		for (size_type i = 0; i < capacity_; ++i) {
+			if (buckets_[i].isOccupy()) {
+				slots_.key(i).~key_type();
+				slots_.value(i).~value_type();
+			}
+			buckets_[i].index_ = -1;
+			buckets_[i].next_ = -1;
+			buckets_[i].clear();
+		}
+		size_ = 0;
+		empty_ = 0;
+		freeList_ = -1;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	template<class K>
+	typename HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::size_type
+		HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::find_(const K& key, size_type hash) const
+	{
+		s32 bucketPos = index_.index(hash);
+		hash |= bucket_type::OccupyFlag;
+		for (s32 i = buckets_[bucketPos].index_; 0 <= i; i = buckets_[i].next_) {
+			HCOUNT(probes_, 1);
+#if 1
+			HCOUNT(compares_, (hash == buckets_[i].hash_) ? 1 : 0);
+			if (hash == buckets_[i].hash_ && key == slots_.key(i)) {
+				return i;
+			}
+			HCOUNT(falseMatches_, (hash == buckets_[i].hash_) ? 1 : 0);
+#else
+			if (key == slots_.key(i)) {
+				return i;
+			}
+#endif
+		}
+		return end();
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	void HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::findBatch(const key_type* keys, size_type n, iterator* out) const
+	{
+		if (capacity_ <= 0) {
+			for (size_type i = 0; i < n; ++i) {
+				out[i] = end();
+			}
+			return;
+		}
+		size_type hashes[hash_detail::PrefetchWindow];
+		for (size_type base = 0; base < n; base += hash_detail::PrefetchWindow) {
+			size_type count = (hash_detail::PrefetchWindow < (n - base)) ? hash_detail::PrefetchWindow : (n - base);
+			for (size_type i = 0; i < count; ++i) {
+				hashes[i] = calcHash_(keys[base + i]);
+				hash_detail::prefetch(&buckets_[index_.index(hashes[i])]);
+			}
+			for (size_type i = 0; i < count; ++i) {
+				out[base + i] = find_(keys[base + i], hashes[i]);
+			}
+		}
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	bool HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::insert(const_key_param_type key, const_value_param_type value)
+	{
+		return tryInsert_(calcHash_(key), key, value);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	bool HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::insert(key_type&& key, value_type&& value)
+	{
+		size_type hash = calcHash_(key);
+		return tryInsert_(hash, std::move(key), std::move(value));
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	template<class KeyArg, class... Args>
+	bool HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::emplace(KeyArg&& key, Args&&... args)
+	{
+		typedef typename std::decay<KeyArg>::type arg_type;
+		if constexpr (std::is_same<arg_type, key_type>::value || hash_detail::is_transparent<Key, arg_type>::value) {
+			size_type hash = calcHash_(key);
+			return tryInsert_(hash, std::forward<KeyArg>(key), std::forward<Args>(args)...);
+		} else {
+			key_type tkey(std::forward<KeyArg>(key));
+			size_type hash = calcHash_(tkey);
+			return tryInsert_(hash, std::move(tkey), std::forward<Args>(args)...);
+		}
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	template<class... Args>
+	bool HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::try_emplace(const_key_param_type key, Args&&... args)
+	{
+		return tryInsert_(calcHash_(key), key, std::forward<Args>(args)...);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	template<class... Args>
+	bool HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::try_emplace(key_type&& key, Args&&... args)
+	{
+		size_type hash = calcHash_(key);
+		return tryInsert_(hash, std::move(key), std::forward<Args>(args)...);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	typename HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::size_type HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::insertBatch(const key_type* keys, const value_type* values, size_type n)
+	{
+		if (n <= 0) {
+			return 0;
+		}
+		if (growth_policy::maxSize(capacity_) < size_ + n) {
+			expand(growth_policy::capacityFor(size_ + n));
+		}
+
+		size_type chunk = (hash_detail::InsertChunk < n) ? hash_detail::InsertChunk : n;
+		u64* entries = reinterpret_cast<u64*>(HALLOCATOR_MALLOC(allocator_, sizeof(u64) * chunk * 2));
+		size_type inserted = 0;
+		for (size_type base = 0; base < n; base += chunk) {
+			size_type count = (chunk < (n - base)) ? chunk : (n - base);
+			for (size_type i = 0; i < count; ++i) {
+				entries[i] = (static_cast<u64>(calcHash_(keys[base + i])) << 32) | i;
+			}
+			const u64* sorted = hash_detail::sortByHome(count, entries, entries + chunk, capacity_, [this](u32 hash) { return index_.index(hash); });
+			for (size_type i = 0; i < count; ++i) {
+				size_type index = base + static_cast<u32>(sorted[i]);
+				if (tryInsert_(static_cast<u32>(sorted[i] >> 32), keys[index], values[index])) {
+					++inserted;
+				}
+			}
+		}
+		HALLOCATOR_FREE(allocator_, entries);
+		return inserted;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	template<class KeyArg, class... Args>
+	bool HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::tryInsert_(size_type hash, KeyArg&& key, Args&&... args)
+	{
+		if (0 < capacity_ && find_(key, hash) != end()) {
+			return false;
+		}
+		insert_(hash, std::forward<KeyArg>(key), std::forward<Args>(args)...);
+		return true;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	template<class KeyArg, class... Args>
+	void HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::insert_(size_type hash, KeyArg&& key, Args&&... args)
+	{
+		if (growth_policy::maxSize(capacity_) <= size_) {
+			expand(growth_policy::nextCapacity(capacity_));
+		}
+
+		s32 entryPos;
+		if (freeList_ < 0) {
+			for (;;) {
+				entryPos = (empty_ < static_cast<s32>(capacity_)) ? empty_++ : -1;
+				if (0 <= entryPos) {
+					break;
+				}
+				expand(growth_policy::nextCapacity(capacity_));
+			}
+		}
+		else {
+			entryPos = freeList_;
+			freeList_ = buckets_[freeList_].next_;
+		}
+
+		s32 bucketPos = index_.index(hash);
+		buckets_[entryPos].next_ = (buckets_[bucketPos].index_ < 0) ? -1 : buckets_[bucketPos].index_;
+		buckets_[bucketPos].index_ = entryPos;
+		buckets_[entryPos].hash_ = hash | bucket_type::OccupyFlag;
+		HPLACEMENT_NEW(&slots_.key(entryPos)) key_type(std::forward<KeyArg>(key));
+		HPLACEMENT_NEW(&slots_.value(entryPos)) value_type(std::forward<Args>(args)...);
+		++size_;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	void HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::erase(const_key_param_type key)
+	{
+		if (capacity_ <= 0) {
+			return;
+		}
+		u32 rawHash = calcHash_(key);
+		size_type pos = find_(key, rawHash);
+		if (!valid(pos) || !buckets_[pos].isOccupy()) {
+			return;
+		}
+		erase_(pos, rawHash);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	template<class K, hash_detail::transparent_t<Key, K>>
+	typename HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::size_type HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::find(const K& key) const
+	{
+		return (0 < capacity_) ? find_(key, calcHash_(key)) : end();
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	template<class K, hash_detail::transparent_t<Key, K>>
+	bool HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::insert(const K& key, const_value_param_type value)
+	{
+		return tryInsert_(calcHash_(key), key, value);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	template<class K, hash_detail::transparent_t<Key, K>>
+	void HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::erase(const K& key)
+	{
+		size_type pos = find(key);
+		if (pos != end()) {
+			eraseAt(pos);
+		}
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	void HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::eraseAt(size_type pos)
+	{
+		if (capacity_ <= 0) {
+			return;
+		}
+		if (!valid(pos) || !buckets_[pos].isOccupy()) {
+			return;
+		}
+		u32 rawHash = calcHash_(getKey(pos));
+		erase_(pos, rawHash);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	void HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::erase_(size_type pos, u32 rawHash)
+	{
+		s32 bucketPos = index_.index(rawHash);
+
+		slots_.key(pos).~key_type();
+		slots_.value(pos).~value_type();
+
+		s32 spos = static_cast<s32>(pos);
+		if (spos == buckets_[bucketPos].index_) {
+			buckets_[bucketPos].index_ = buckets_[pos].next_;
+		}
+		else {
+			s32 p;
+			for (p = buckets_[bucketPos].index_; buckets_[p].next_ != spos; p = buckets_[p].next_) {
+				HCOUNT(probes_, 1);
+#if _DEBUG
+				if (buckets_[p].next_ < 0) {
+					HASSERT(false);
+				}
+#endif
+			}
+			buckets_[p].next_ = buckets_[pos].next_;
+		}
+		buckets_[pos].next_ = freeList_;
+		freeList_ = pos;
+		buckets_[pos].clear();
+		--size_;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	void HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::moveAt(size_type pos, this_type& dst)
+	{
+		HASSERT(valid(pos) && buckets_[pos].isOccupy());
+		u32 rawHash = buckets_[pos].hash_ & bucket_type::HashMask;
+		dst.insert_(rawHash, std::move(slots_.key(pos)), std::move(slots_.value(pos)));
+		erase_(pos, rawHash);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	TableStats HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::stats() const
+	{
+		TableStats stats;
+		stats.bytes_ = (0 < capacity_) ? align(sizeof(bucket_type) * capacity_) + slots_type::bytes(capacity_) : 0;
+		stats.capacity_ = capacity_;
+		stats.size_ = size_;
+		for (size_type i = 0; i < capacity_; ++i) {
+			u64 depth = 0;
+			for (s32 j = buckets_[i].index_; 0 <= j; j = buckets_[j].next_) {
+				stats.addProbe(depth++);
+			}
+		}
+		return stats;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	const typename HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::memory_allocator& HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::getAllocator() const
+	{
+		return allocator_;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	void HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::setResizeObserver(ResizeObserver observer, void* user)
+	{
+		observer_ = observer;
+		observerUser_ = user;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	typename HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::size_type HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::roundCapacity(size_type capacity)
+	{
+		return index_policy::roundCapacity(capacity);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	typename HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::size_type HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::available() const
+	{
+		size_type limit = growth_policy::maxSize(capacity_);
+		return (size_ < limit) ? limit - size_ : 0;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	typename HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::size_type HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::capacityFor(size_type size)
+	{
+		return growth_policy::capacityFor(size);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	void HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::swap(this_type& rhs)
+	{
+		hashmap::swap(capacity_, rhs.capacity_);
+		hashmap::swap(index_, rhs.index_);
+		hashmap::swap(size_, rhs.size_);
+		hashmap::swap(empty_, rhs.empty_);
+		hashmap::swap(freeList_, rhs.freeList_);
+		hashmap::swap(buckets_, rhs.buckets_);
+		slots_.swap(rhs.slots_);
+		hashmap::swap(allocator_, rhs.allocator_);
+	}
+
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	typename HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::iterator
+		HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::begin() const
+	{
+		for (size_type i = 0; i < capacity_; ++i) {
+			if (buckets_[i].isOccupy()) {
+				return i;
+			}
+		}
+		return end();
+	}
+
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	typename HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::iterator
+		HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::next(iterator pos) const
+	{
+		for (size_type i = pos + 1; i < capacity_; ++i) {
+			if (buckets_[i].isOccupy()) {
+				return i;
+			}
+		}
+		return end();
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	void HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::expand(size_type capacity)
+	{
+		HCOUNT_RESIZE();
+		hash_detail::ResizeNotifier notifier(observer_, observerUser_, capacity_, roundCapacity(capacity), size_);
+		this_type tmp(allocator_);
+		tmp.create(capacity);
+
+		if (1 < threads_ && hash_detail::ParallelRehashMinimum <= size_) {
+			expandParallel_(tmp);
+			tmp.swap(*this);
+			return;
+		}
+
+		for (size_type i = 0; i < capacity_; ++i) {
+			if (buckets_[i].isOccupy()) {
+#if _DEBUG
+				if (false == tmp.insert(std::move(slots_.key(i)), std::move(slots_.value(i)))) {
+					HASSERT(false);
+				}
+#else
+				tmp.insert(std::move(slots_.key(i)), std::move(slots_.value(i)));
+#endif
+			}
+		}
+		tmp.swap(*this);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	void HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::expandParallel_(this_type& dst)
+	{
+		//Region r of buckets takes entries [offsets[r], offsets[r+1]), so that threads write disjoint buckets and entries
+		u32* offsets = reinterpret_cast<u32*>(HALLOCATOR_MALLOC(allocator_, sizeof(u32) * (threads_ + 1)));
+		u64* entries = hash_detail::partitionByRegion(allocator_, threads_, capacity_, size_,
+			[this](size_type i) { return buckets_[i].isOccupy(); },
+			[this](size_type i) { return buckets_[i].hash_ & bucket_type::HashMask; },
+			dst.capacity_, [&dst](u32 hash) { return dst.index_.index(hash); }, offsets);
+		hash_detail::parallelFor(threads_, [&](u32 r) {
+			for (size_type i = offsets[r]; i < offsets[r + 1]; ++i) {
+				size_type hash = static_cast<size_type>(entries[i] >> 32);
+				size_type src = static_cast<u32>(entries[i]);
+				s32 bucketPos = dst.index_.index(hash);
+				dst.buckets_[i].next_ = dst.buckets_[bucketPos].index_;
+				dst.buckets_[bucketPos].index_ = static_cast<s32>(i);
+				dst.buckets_[i].hash_ = hash | bucket_type::OccupyFlag;
+				HPLACEMENT_NEW(&dst.slots_.key(i)) key_type(std::move(slots_.key(src)));
+				HPLACEMENT_NEW(&dst.slots_.value(i)) value_type(std::move(slots_.value(src)));
+			}
+		});
+		dst.size_ = size_;
+		dst.empty_ = static_cast<s32>(size_);
+		HALLOCATOR_FREE(allocator_, entries);
+		HALLOCATOR_FREE(allocator_, offsets);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	void HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::create(size_type capacity)
+	{
+		HASSERT(NULL == buckets_);
+		HASSERT(NULL == slots_.data());
+
+		capacity_ = index_policy::roundCapacity(capacity);
+		index_.reset(capacity_);
+
+		size_type size_buckets = align(sizeof(bucket_type) * capacity_);
+		size_type size_slots = static_cast<size_type>(slots_type::bytes(capacity_));
+		size_type total_size = size_buckets + size_slots;
+
+		u8* mem = reinterpret_cast<u8*>(HALLOCATOR_MALLOC(allocator_, total_size));
+		buckets_ = reinterpret_cast<bucket_type*>(mem);
+		slots_.bind(mem + size_buckets, capacity_);
+
+		for (size_type i = 0; i < capacity_; ++i) {
+			buckets_[i].index_ = -1;
+			buckets_[i].next_ = -1;
+			buckets_[i].clear();
+		}
+		size_ = 0;
+		empty_ = 0;
+		freeList_ = -1;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Layout>
+	void HashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Layout>::destroy()
+	{
+		clear();
+		capacity_ = 0;
+		HALLOCATOR_FREE(allocator_, buckets_);
+		slots_.reset();
+	}
+
+
+	//-----------------------------------------------------------------------------
+	//---
+	//--- HopscotchHashMap
+	//---
+	//-----------------------------------------------------------------------------
+	template<typename BitmapType>
+	struct HashMapHopInfo
+	{
+		typedef u32 size_type;
+		typedef BitmapType bitmap_type;
+		static const size_type bitmap_size = sizeof(bitmap_type);
+		static const size_type bitmap_count = bitmap_size * 8 - 1;
+
+		bool isEmpty() const
+		{
+			return (0 == (hop_ & 0x01U));
+		}
+
+		void setEmpty()
+		{
+			hop_ &= ~0x01U;
+		}
+
+		bool isOccupy() const
+		{
+			return (0 != (hop_ & 0x01U));
+		}
+
+		void setOccupy()
+		{
+			hop_ |= 0x01U;
+		}
+
+		bitmap_type getHop() const
+		{
+			return (hop_ >> 1);
+		}
+
+		void setHop(bitmap_type hop)
+		{
+			hop_ = (hop << 1) | (hop_ & 0x01U);
+		}
+
+		void setHopFlag(size_type pos)
+		{
+			hop_ |= (0x01U << (pos + 1));
+		}
+
+		void clearHopFlag(size_type pos)
+		{
+			hop_ &= ~(0x01U << (pos + 1));
+		}
+
+		bool checkHopFlag(size_type pos) const
+		{
+			return 0 != (hop_ & (0x01U << (pos + 1)));
+		}
+
+		void clear()
+		{
+			hop_ = 0;
+		}
+
+		bitmap_type hop_;
+	};
+
+	template<class Key, class Value, typename BitmapType = u32, class MemoryAllocator = DefaultAllocator, class GrowthPolicy = DefaultGrowthPolicy, class IndexPolicy = PrimeIndexPolicy, bool StoreHash = false, class Layout = SoALayout>
+	class HopscotchHashMap
+	{
+	public:
+		/// Each sub-array of a table starts at a cache line
+		static const u32 Align = hash_detail::CacheLineSize;
+		static const u32 AlignMask = Align - 1;
+
+		typedef HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout> this_type;
+
+		typedef Key key_type;
+		typedef Value value_type;
+		typedef HashMapHopInfo<BitmapType> hopinfo_type;
+		typedef MemoryAllocator memory_allocator;
+		typedef GrowthPolicy growth_policy;
+		typedef IndexPolicy index_policy;
+		typedef Layout layout_policy;
+		typedef typename Layout::template Slots<Key, Value> slots_type;
+
+		typedef u32 size_type;
+		typedef size_type iterator;
+
+		typedef hash_detail::type_traits<value_type> value_traits;
+		typedef typename value_traits::pointer value_pointer;
+		typedef typename value_traits::const_pointer const_value_pointer;
+		typedef typename value_traits::reference value_reference;
+		typedef typename value_traits::const_reference const_value_reference;
+		typedef typename value_traits::pointer pointer;
+		typedef typename value_traits::const_pointer const_pointer;
+		typedef typename value_traits::reference reference;
+		typedef typename value_traits::const_reference const_reference;
+		typedef typename value_traits::param_type value_param_type;
+		typedef typename value_traits::const_param_type const_value_param_type;
+
+
+		typedef hash_detail::type_traits<key_type> key_traits;
+		typedef typename key_traits::pointer key_pointer;
+		typedef typename key_traits::const_pointer const_key_pointer;
+		typedef typename key_traits::reference key_reference;
+		typedef typename key_traits::const_reference const_key_reference;
+		typedef typename key_traits::param_type key_param_type;
+		typedef typename key_traits::const_param_type const_key_param_type;
+
+		typedef hopinfo_type* hopinfo_pointer;
+		typedef const hopinfo_type* const_hopinfo_pointer;
+		typedef typename hopinfo_type::bitmap_type bitmap_type;
+
+		static const size_type bitmap_size = hopinfo_type::bitmap_size;
+		static const size_type bitmap_count = hopinfo_type::bitmap_count;
+
+		static const size_type InsertRange = 8 * bitmap_count;
+
+		HopscotchHashMap();
+		explicit HopscotchHashMap(size_type capacity);
+		/**
+		@param allocator ... copied into the table, every block of the table is drawn from it
+		*/
+		explicit HopscotchHashMap(const memory_allocator& allocator);
+		HopscotchHashMap(size_type capacity, const memory_allocator& allocator);
+		~HopscotchHashMap();
+
+		void initialize(size_type capacity)
+		{
+			destroy();
+			create(capacity);
+		}
+
+		size_type capacity() const
+		{
+			return capacity_;
+		}
+
+		size_type size() const
+		{
+			return size_;
+		}
+		/**
+		@brief Walks every slot, which takes time in proportion to the capacity
+		*/
+		TableStats stats() const;
+
+		void clear();
+
+		bool valid(size_type pos) const
+		{
+			return (pos < capacity_);
+		}
+
+		size_type find(const_key_param_type key) const
+		{
+			return (0 < capacity_) ? find_(key, calcHash_(key)) : end();
+		}
+
+		/**
+		@brief Prefetches the hop information and the first slot of each home, as HashMap::findBatch
+		*/
+		void findBatch(const key_type* keys, size_type n, iterator* out) const;
+
+		bool insert(const_key_param_type key, const_value_param_type value);
+		bool insert(key_type&& key, value_type&& value);
+
+		template<class KeyArg, class... Args>
+		bool emplace(KeyArg&& key, Args&&... args);
+		template<class... Args>
+		bool try_emplace(const_key_param_type key, Args&&... args);
+		template<class... Args>
+		bool try_emplace(key_type&& key, Args&&... args);
+
+		size_type insertBatch(const key_type* keys, const value_type* values, size_type n);
+
+		void erase(const_key_param_type key);
+
+		template<class K, hash_detail::transparent_t<Key, K> = 0>
+		size_type find(const K& key) const;
+		template<class K, hash_detail::transparent_t<Key, K> = 0>
+		bool insert(const K& key, const_value_param_type value);
+		template<class K, hash_detail::transparent_t<Key, K> = 0>
+		void erase(const K& key);
+		void eraseAt(size_type pos);
+
+		void moveAt(size_type pos, this_type& dst);
+		/**
+		@brief Allocator, which tables created by growth share
+		*/
+		const memory_allocator& getAllocator() const;
+		void setResizeObserver(ResizeObserver observer, void* user);
+		static size_type roundCapacity(size_type capacity);
+		size_type available() const;
+		static size_type capacityFor(size_type size);
+		void swap(this_type& rhs);
+
+		iterator begin() const;
+
+		iterator end() const
+		{
+			return capacity_;
+		}
+
+		iterator next(iterator pos) const;
+
+		reference getValue(size_type pos)
+		{
+			HASSERT(0 <= pos && pos < capacity_);
+			return slots_.value(pos);
+		}
+
+		const_reference getValue(size_type pos) const
+		{
+			HASSERT(0 <= pos && pos < capacity_);
+			return slots_.value(pos);
+		}
+
+		key_reference getKey(size_type pos)
+		{
+			HASSERT(0 <= pos && pos < capacity_);
+			return slots_.key(pos);
+		}
+
+		const_key_reference getKey(size_type pos) const
+		{
+			HASSERT(0 <= pos && pos < capacity_);
+			return slots_.key(pos);
+		}
+	private:
+		HopscotchHashMap(const HopscotchHashMap&) = delete;
+		HopscotchHashMap& operator=(const HopscotchHashMap&) = delete;
+
+		bool isEmpty(size_type pos) const
+		{
+			return hopinfoes_[pos].isEmpty();
+		}
+
+		bool isOccupy(size_type pos) const
+		{
+			return hopinfoes_[pos].isOccupy();
+		}
+
+		template<class K>
+		inline static size_type calcHash_(const K& key)
+		{
+			return hash_detail::calcHash(key);
+		}
+
+		inline size_type hashToPos_(size_type hash) const
+		{
+			return index_.index(hash);
+		}
+
+		inline size_type hashAt_(size_type pos) const
+		{
+			if constexpr (StoreHash) {
+				return hashes_[pos];
+			} else {
+				return calcHash_(slots_.key(pos));
+			}
+		}
+
+		inline void setHash_(size_type pos, size_type hash)
+		{
+			if constexpr (StoreHash) {
+				hashes_[pos] = hash;
+			}
+		}
+
+		template<class K>
+		inline bool equal_(size_type pos, size_type hash, const K& key) const
+		{
+			if constexpr (StoreHash) {
+				if (hashes_[pos] != hash) {
+					return false;
+				}
+			}
+			HCOUNT(compares_, 1);
+			bool same = slots_.key(pos) == key;
+			HCOUNT(falseMatches_, (StoreHash && !same) ? 1 : 0);
+			return same;
+		}
+
+		static inline size_type align_(size_type x)
+		{
+			return (x + AlignMask) & (~AlignMask);
+		}
+
+		inline size_type clamp_(size_type x) const
+		{
+			return (x < capacity_) ? x : x - capacity_;
+		}
+
+		void moveEmpty(size_type& pos, size_type& distance);
+		void expand(size_type capacity);
+
+		template<class K>
+		size_type find_(const K& key, size_type hash) const;
+		template<class KeyArg, class... Args>
+		bool tryInsert_(size_type hash, KeyArg&& key, Args&&... args);
+		template<class KeyArg, class... Args>
+		bool insert_(size_type hash, KeyArg&& key, Args&&... args);
+		void eraseAt_(size_type pos, size_type hash);
+
+		void create(size_type capacity);
+		void destroy();
+
+		size_type capacity_;
+		size_type size_;
+		index_policy index_;
+
+		hopinfo_pointer hopinfoes_;
+		size_type* hashes_;
+		slots_type slots_;
+		memory_allocator allocator_;
+		ResizeObserver observer_;
+		void* observerUser_;
+	};
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::HopscotchHashMap()
+		:capacity_(0)
+		, size_(0)
+		, index_()
+		, hopinfoes_(NULL)
+		, hashes_(NULL)
+		, slots_()
+		, allocator_()
+		, observer_(nullptr)
+		, observerUser_(nullptr)
+	{}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::HopscotchHashMap(size_type capacity)
+		:capacity_(0)
+		, size_(0)
+		, index_()
+		, hopinfoes_(NULL)
+		, hashes_(NULL)
+		, slots_()
+		, allocator_()
+		, observer_(nullptr)
+		, observerUser_(nullptr)
+	{
+		create(capacity);
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::HopscotchHashMap(const memory_allocator& allocator)
+		:capacity_(0)
+		, size_(0)
+		, index_()
+		, hopinfoes_(NULL)
+		, hashes_(NULL)
+		, slots_()
+		, allocator_(allocator)
+		, observer_(nullptr)
+		, observerUser_(nullptr)
+	{}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::HopscotchHashMap(size_type capacity, const memory_allocator& allocator)
+		:capacity_(0)
+		, size_(0)
+		, index_()
+		, hopinfoes_(NULL)
+		, hashes_(NULL)
+		, slots_()
+		, allocator_(allocator)
+		, observer_(nullptr)
+		, observerUser_(nullptr)
+	{
+		create(capacity);
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::~HopscotchHashMap()
+	{
+		destroy();
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::clear()
+	{
+		for (size_type i = 0; i < capacity_; ++i) {
+			if (isOccupy(i)) {
+				slots_.key(i).~key_type();
+				slots_.value(i).~value_type();
+			}
+			hopinfoes_[i].clear();
+		}
+		size_ = 0;
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	bool HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::insert(const_key_param_type key, const_value_param_type value)
+	{
+		return tryInsert_(calcHash_(key), key, value);
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	bool HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::insert(key_type&& key, value_type&& value)
+	{
+		size_type hash = calcHash_(key);
+		return tryInsert_(hash, std::move(key), std::move(value));
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<class KeyArg, class... Args>
+	bool HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::emplace(KeyArg&& key, Args&&... args)
+	{
+		typedef typename std::decay<KeyArg>::type arg_type;
+		if constexpr (std::is_same<arg_type, key_type>::value || hash_detail::is_transparent<Key, arg_type>::value) {
+			size_type hash = calcHash_(key);
+			return tryInsert_(hash, std::forward<KeyArg>(key), std::forward<Args>(args)...);
+		} else {
+			key_type tkey(std::forward<KeyArg>(key));
+			size_type hash = calcHash_(tkey);
+			return tryInsert_(hash, std::move(tkey), std::forward<Args>(args)...);
+		}
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<class... Args>
+	bool HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::try_emplace(const_key_param_type key, Args&&... args)
+	{
+		return tryInsert_(calcHash_(key), key, std::forward<Args>(args)...);
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<class... Args>
+	bool HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::try_emplace(key_type&& key, Args&&... args)
+	{
+		size_type hash = calcHash_(key);
+		return tryInsert_(hash, std::move(key), std::forward<Args>(args)...);
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	typename HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size_type HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::insertBatch(const key_type* keys, const value_type* values, size_type n)
+	{
+		if (n <= 0) {
+			return 0;
+		}
+		if (growth_policy::maxSize(capacity_) < size_ + n) {
+			expand(growth_policy::capacityFor(size_ + n));
+		}
+
+		size_type chunk = (hash_detail::InsertChunk < n) ? hash_detail::InsertChunk : n;
+		u64* entries = reinterpret_cast<u64*>(HALLOCATOR_MALLOC(allocator_, sizeof(u64) * chunk * 2));
+		size_type inserted = 0;
+		for (size_type base = 0; base < n; base += chunk) {
+			size_type count = (chunk < (n - base)) ? chunk : (n - base);
+			for (size_type i = 0; i < count; ++i) {
+				entries[i] = (static_cast<u64>(calcHash_(keys[base + i])) << 32) | i;
+			}
+			const u64* sorted = hash_detail::sortByHome(count, entries, entries + chunk, capacity_, [this](u32 hash) { return hashToPos_(hash); });
+			for (size_type i = 0; i < count; ++i) {
+				size_type index = base + static_cast<u32>(sorted[i]);
+				if (tryInsert_(static_cast<u32>(sorted[i] >> 32), keys[index], values[index])) {
+					++inserted;
+				}
+			}
+		}
+		HALLOCATOR_FREE(allocator_, entries);
+		return inserted;
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<class KeyArg, class... Args>
+	bool HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::tryInsert_(size_type hash, KeyArg&& key, Args&&... args)
+	{
+		if (capacity_ <= 0) {
+			expand(growth_policy::nextCapacity(capacity_));
+			return insert_(hash, std::forward<KeyArg>(key), std::forward<Args>(args)...);
+		}
+		size_type pos = find_(key, hash);
+		if (pos != end()) {
+			return false;
+		}
+		if (growth_policy::maxSize(capacity_) <= size_) {
+			expand(growth_policy::nextCapacity(capacity_));
+		}
+		return insert_(hash, std::forward<KeyArg>(key), std::forward<Args>(args)...);
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<class K>
+	typename HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size_type
+		HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::find_(const K& key, size_type hash) const
+	{
+		HASSERT(0 < capacity_);
+		size_type pos = hashToPos_(hash);
+		HASSERT(pos < capacity_);
+		bitmap_type info = hopinfoes_[pos].getHop();
+
+		size_type d = 0;
+		while (0 != info) {
+			if (info & 0x01U) {
+				HCOUNT(probes_, 1);
+				size_type p = clamp_(pos + d);
+				HASSERT(isOccupy(p));
+				if (equal_(p, hash, key)) {
+					return p;
+				}
+			}
+			info >>= 1;
+			++d;
+		}
+
+		return end();
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::findBatch(const key_type* keys, size_type n, iterator* out) const
+	{
+		if (capacity_ <= 0) {
+			for (size_type i = 0; i < n; ++i) {
+				out[i] = end();
+			}
+			return;
+		}
+		size_type hashes[hash_detail::PrefetchWindow];
+		for (size_type base = 0; base < n; base += hash_detail::PrefetchWindow) {
+			size_type count = (hash_detail::PrefetchWindow < (n - base)) ? hash_detail::PrefetchWindow : (n - base);
+			for (size_type i = 0; i < count; ++i) {
+				hashes[i] = calcHash_(keys[base + i]);
+				size_type pos = hashToPos_(hashes[i]);
+				hash_detail::prefetch(&hopinfoes_[pos]);
+				hash_detail::prefetch(&slots_.key(pos));
+			}
+			for (size_type i = 0; i < count; ++i) {
+				out[base + i] = find_(keys[base + i], hashes[i]);
+			}
+		}
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<class KeyArg, class... Args>
+	bool HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::insert_(size_type hash, KeyArg&& key, Args&&... args)
+	{
+		size_type startPos = hashToPos_(hash);
+		size_type pos;
+		size_type d;
+		for (;;) {
+			size_type range = (capacity_ < InsertRange) ? capacity_ : InsertRange;
+			d = 0;
+			pos = startPos;
+			do {
+				HCOUNT(probes_, 1);
+				if (hopinfoes_[pos].isEmpty()) {
+					break;
+				}
+				pos = clamp_(pos + 1);
+				++d;
+			} while (d < range);
+
+			if (range <= d) {
+				expand(growth_policy::nextCapacity(capacity_));
+				startPos = hashToPos_(hash);
+				continue;
+			}
+
+			size_type size = (bitmap_count < capacity_) ? bitmap_count : capacity_;
+			while (size <= d) {
+				moveEmpty(pos, d);
+			}
+			if (end() == pos) {
+				expand(growth_policy::nextCapacity(capacity_));
+				startPos = hashToPos_(hash);
+				continue;
+			}
+			HASSERT(hopinfoes_[pos].isEmpty());
+			HASSERT(!hopinfoes_[startPos].checkHopFlag(d));
+			break;
+		}
+
+		hopinfoes_[pos].setOccupy();
+		setHash_(pos, hash);
+		HPLACEMENT_NEW(&slots_.key(pos)) key_type(std::forward<KeyArg>(key));
+		HPLACEMENT_NEW(&slots_.value(pos)) value_type(std::forward<Args>(args)...);
+		hopinfoes_[startPos].setHopFlag(d);
+		++size_;
+		return true;
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::moveEmpty(size_type& pos, size_type& distance)
+	{
+		size_type size = (bitmap_count < capacity_) ? bitmap_count : capacity_;
+		size_type offset = size - 1;
+		size_type n = (offset <= pos) ? pos - offset : capacity_ - offset + pos;
+
+		for (s32 i = offset; 0 <= i; --i) {
+			bitmap_type hop = hopinfoes_[n].getHop();
+			for (s32 j = 0; j <= i; ++j) {
+				if (hop & (0x01U << j)) {
+					size_type next_pos = clamp_(n + j);
+					setHash_(pos, hashAt_(next_pos));
+					construct(&slots_.key(pos), hashmap::move(slots_.key(next_pos)));
+					construct(&slots_.value(pos), hashmap::move(slots_.value(next_pos)));
+					slots_.key(next_pos).~key_type();
+					slots_.value(next_pos).~value_type();
+					hopinfoes_[pos].setOccupy();
+					hopinfoes_[next_pos].setEmpty();
+
+					hop &= ~(0x01U << j);
+					hop |= (0x01U << i);
+					hopinfoes_[n].setHop(hop);
+					pos = next_pos;
+					distance -= (i - j);
+					HCOUNT(displacements_, 1);
+					return;
+				}
+			}
+			n = clamp_(n + 1);
+		}
+		pos = end();
+		distance = 0;
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::erase(const_key_param_type key)
+	{
+		if (capacity_ <= 0) {
+			return;
+		}
+
+		size_type hash = calcHash_(key);
+		size_type pos = find_(key, hash);
+
+		if (pos == end()) {
+			return;
+		}
+
+		hopinfoes_[pos].setEmpty();
+		slots_.key(pos).~key_type();
+		slots_.value(pos).~value_type();
+
+		hash = hashToPos_(hash);
+		size_type d = (hash <= pos) ? pos - hash : (capacity_ - hash + pos);
+		hopinfoes_[hash].clearHopFlag(d);
+		--size_;
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<class K, hash_detail::transparent_t<Key, K>>
+	typename HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size_type HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::find(const K& key) const
+	{
+		return (0 < capacity_) ? find_(key, calcHash_(key)) : end();
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<class K, hash_detail::transparent_t<Key, K>>
+	bool HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::insert(const K& key, const_value_param_type value)
+	{
+		return tryInsert_(calcHash_(key), key, value);
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<class K, hash_detail::transparent_t<Key, K>>
+	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::erase(const K& key)
+	{
+		size_type pos = find(key);
+		if (pos != end()) {
+			eraseAt(pos);
+		}
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::eraseAt(size_type pos)
+	{
+		HASSERT(valid(pos));
+		eraseAt_(pos, hashAt_(pos));
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::eraseAt_(size_type pos, size_type hash)
+	{
+		hopinfoes_[pos].setEmpty();
+		slots_.key(pos).~key_type();
+		slots_.value(pos).~value_type();
+
+		hash = hashToPos_(hash);
+		size_type d = (hash <= pos) ? pos - hash : (capacity_ - hash + pos);
+		hopinfoes_[hash].clearHopFlag(d);
+		--size_;
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::moveAt(size_type pos, this_type& dst)
+	{
+		HASSERT(valid(pos));
+		size_type hash = hashAt_(pos);
+		if (growth_policy::maxSize(dst.capacity_) <= dst.size_) {
+			dst.expand(growth_policy::nextCapacity(dst.capacity_));
+		}
+		dst.insert_(hash, std::move(slots_.key(pos)), std::move(slots_.value(pos)));
+		eraseAt_(pos, hash);
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	TableStats HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::stats() const
+	{
+		TableStats stats;
+		if (capacity_ <= 0) {
+			return stats;
+		}
+		stats.bytes_ = align_(sizeof(hopinfo_type) * capacity_) + (StoreHash ? align_(sizeof(size_type) * capacity_) : 0) + slots_type::bytes(capacity_);
+		stats.capacity_ = capacity_;
+		stats.size_ = size_;
+		for (size_type i = 0; i < capacity_; ++i) {
+			bitmap_type info = hopinfoes_[i].getHop();
+			for (u64 d = 0; 0 != info; ++d, info >>= 1) {
+				if (info & 0x01U) {
+					stats.addProbe(d);
+				}
+			}
+		}
+		return stats;
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	const typename HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::memory_allocator& HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::getAllocator() const
+	{
+		return allocator_;
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::setResizeObserver(ResizeObserver observer, void* user)
+	{
+		observer_ = observer;
+		observerUser_ = user;
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	typename HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size_type HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::roundCapacity(size_type capacity)
+	{
+		return index_policy::roundCapacity(capacity);
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	typename HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size_type HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::available() const
+	{
+		size_type limit = growth_policy::maxSize(capacity_);
+		return (size_ < limit) ? limit - size_ : 0;
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	typename HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size_type HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::capacityFor(size_type size)
+	{
+		return growth_policy::capacityFor(size);
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::swap(this_type& rhs)
+	{
+		hashmap::swap(capacity_, rhs.capacity_);
+		hashmap::swap(size_, rhs.size_);
+		hashmap::swap(index_, rhs.index_);
+		hashmap::swap(hopinfoes_, rhs.hopinfoes_);
+		hashmap::swap(hashes_, rhs.hashes_);
+		slots_.swap(rhs.slots_);
+		hashmap::swap(allocator_, rhs.allocator_);
+	}
+
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	typename HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::iterator
+		HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::begin() const
+	{
+		for (size_type i = 0; i < end(); ++i) {
+			if (isOccupy(i)) {
+				return i;
+			}
+		}
+		return end();
+	}
+
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	typename HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::iterator
+		HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::next(iterator pos) const
+	{
+		for (size_type i = pos + 1; i < end(); ++i) {
+			if (isOccupy(i)) {
+				return i;
+			}
+		}
+		return end();
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::expand(size_type capacity)
+	{
+		HCOUNT_RESIZE();
+		hash_detail::ResizeNotifier notifier(observer_, observerUser_, capacity_, roundCapacity(capacity), size_);
+		this_type tmp(allocator_);
+		tmp.create(capacity);
+
+		for (size_type i = 0; i < capacity_; ++i) {
+			if (isOccupy(i)) {
+				tmp.insert_(hashAt_(i), std::move(slots_.key(i)), std::move(slots_.value(i)));
+			}
+		}
+		tmp.swap(*this);
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::create(size_type capacity)
+	{
+		HASSERT(NULL == hopinfoes_);
+		HASSERT(NULL == slots_.data());
+
+		capacity_ = index_policy::roundCapacity(capacity);
+		index_.reset(capacity_);
+
+		size_type size_infoes = align_(sizeof(hopinfo_type) * capacity_);
+		size_type size_hashes = StoreHash ? align_(sizeof(size_type) * capacity_) : 0;
+		size_type size_slots = static_cast<size_type>(slots_type::bytes(capacity_));
+		size_type total_size = size_infoes + size_hashes + size_slots;
+
+		u8* mem = reinterpret_cast<u8*>(HALLOCATOR_MALLOC(allocator_, total_size));
+		hopinfoes_ = reinterpret_cast<hopinfo_pointer>(mem);
+		hashes_ = StoreHash ? reinterpret_cast<size_type*>(mem + size_infoes) : NULL;
+		slots_.bind(mem + size_infoes + size_hashes, capacity_);
+
+		::memset(hopinfoes_, 0, size_infoes);
+	}
+
+	template<class Key, class Value, typename BitmapType, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::destroy()
+	{
+		clear();
+		HALLOCATOR_FREE(allocator_, hopinfoes_);
+		capacity_ = size_ = 0;
+		hopinfoes_ = NULL;
+		hashes_ = NULL;
+		slots_.reset();
+	}
+
+	//----------------------------------------------------------------
+	//---
+	//--- Robin Hood Hashing
+	//---
+	//----------------------------------------------------------------
+	struct RHDistance
+	{
+		typedef s8 distance_type;
+
+		distance_type distance_;
+
+		inline distance_type distance() const
+		{
+			return distance_;
+		}
+
+		inline void set(distance_type d)
+		{
+			distance_ = d;
+		}
+
+		inline bool isEmpty() const
+		{
+			return distance_ < 0;
+		}
+
+		inline bool isOccupy() const
+		{
+			return 0 <= distance_;
+		}
+
+		inline void setEmpty()
+		{
+			distance_ = -1;
+		}
+	};
+
+	/**
+	@brief Robin Hood Hashing
+	*/
+	template<class Key, class Value, class MemoryAllocator = DefaultAllocator, class GrowthPolicy = DefaultGrowthPolicy, class IndexPolicy = PrimeIndexPolicy, bool StoreHash = false, class Layout = SoALayout>
+	class RHHashMap
+	{
+	public:
+		/// Each sub-array of a table starts at a cache line
+		static const u32 Align = hash_detail::CacheLineSize;
+		static const u32 AlignMask = Align - 1;
+
+		typedef RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout> this_type;
+		typedef Key key_type;
+		typedef Value value_type;
+		typedef MemoryAllocator memory_allocator;
+		typedef GrowthPolicy growth_policy;
+		typedef IndexPolicy index_policy;
+		typedef Layout layout_policy;
+		typedef typename Layout::template Slots<Key, Value> slots_type;
+
+		typedef typename RHDistance::distance_type distance_type;
+		typedef u32 hash_type;
+		typedef u32 size_type;
+		typedef size_type iterator;
+
+		typedef hash_detail::type_traits<value_type> value_traits;
+		typedef typename value_traits::pointer value_pointer;
+		typedef typename value_traits::const_pointer const_value_pointer;
+		typedef typename value_traits::reference value_reference;
+		typedef typename value_traits::const_reference const_value_reference;
+		typedef typename value_traits::pointer pointer;
+		typedef typename value_traits::const_pointer const_pointer;
+		typedef typename value_traits::reference reference;
+		typedef typename value_traits::const_reference const_reference;
+		typedef typename value_traits::param_type value_param_type;
+		typedef typename value_traits::const_param_type const_value_param_type;
+
+
+		typedef hash_detail::type_traits<key_type> key_traits;
+		typedef typename key_traits::pointer key_pointer;
+		typedef typename key_traits::const_pointer const_key_pointer;
+		typedef typename key_traits::reference key_reference;
+		typedef typename key_traits::const_reference const_key_reference;
+		typedef typename key_traits::param_type key_param_type;
+		typedef typename key_traits::const_param_type const_key_param_type;
+
+
+		RHHashMap();
+		explicit RHHashMap(size_type capacity);
+		/**
+		@param allocator ... copied into the table, every block of the table is drawn from it
+		*/
+		explicit RHHashMap(const memory_allocator& allocator);
+		RHHashMap(size_type capacity, const memory_allocator& allocator);
+		~RHHashMap();
+
+		inline size_type capacity() const;
+		inline size_type size() const;
+		/**
+		@brief Walks every slot, which takes time in proportion to the capacity
+		*/
+		TableStats stats() const;
+
+		void clear();
+		void reserve(size_type capacity);
+		bool insert(const_key_param_type key, const_value_param_type value);
+		bool insert(key_type&& key, value_type&& value);
+
+		/**
+		@brief As HashMap::emplace, the key and the value are built in their slot, after the entries they displace are shifted forward
+		*/
+		template<class KeyArg, class... Args>
+		bool emplace(KeyArg&& key, Args&&... args);
+		template<class... Args>
+		bool try_emplace(const_key_param_type key, Args&&... args);
+		template<class... Args>
+		bool try_emplace(key_type&& key, Args&&... args);
+
+		size_type insertBatch(const key_type* keys, const value_type* values, size_type n);
+
+		/**
+		@brief Replaces contents with n pairs, returns the number of distinct keys
+
+		Sizes the table once, then hashes keys and fills regions of home positions on threads. The first of equal keys wins.
+		*/
+		size_type build(const key_type* keys, const value_type* values, size_type n, u32 threads);
+		void erase(const_key_param_type key);
+
+		template<class K, hash_detail::transparent_t<Key, K> = 0>
+		size_type find(const K& key) const;
+		template<class K, hash_detail::transparent_t<Key, K> = 0>
+		bool insert(const K& key, const_value_param_type value);
+		template<class K, hash_detail::transparent_t<Key, K> = 0>
+		void erase(const K& key);
+		void eraseAt(size_type pos);
+
+		void moveAt(size_type pos, this_type& dst);
+		size_type find(const_key_param_type key) const;
+
+		/**
+		@brief Prefetches the distance and the first slot of each home, as HashMap::findBatch
+		*/
+		void findBatch(const key_type* keys, size_type n, iterator* out) const;
+
+		inline bool valid(size_type pos) const;
+		inline const_reference getValue(size_type pos) const;
+		inline reference getValue(size_type pos);
+		inline const_key_reference getKey(size_type pos) const;
+
+		/**
+		@brief Allocator, which tables created by growth share
+		*/
+		const memory_allocator& getAllocator() const;
+		void setResizeObserver(ResizeObserver observer, void* user);
+		static size_type roundCapacity(size_type capacity);
+		size_type available() const;
+		static size_type capacityFor(size_type size);
+		void swap(this_type& rhs);
+
+		iterator begin() const;
+
+		iterator end() const
+		{
+			return padded_capacity_;
+		}
+
+		iterator next(iterator pos) const;
+
+		/**
+		@brief Number of threads to rehash with on expansion, 1 by default
+		*/
+		void setRehashThreads(u32 threads);
+		u32 getRehashThreads() const;
+
+		/**
+		@brief Writes the memory block of the table as it is, which MappedTable maps back without rehash
+		@return false if the file cannot be written
+		*/
+		bool saveImage(const char* path) const;
+	private:
+		template<class>
+		friend class MappedTable;
+
+		inline static constexpr u32 ImageKind = hash_detail::imageKind('R', StoreHash, std::is_same<Layout, AoSLayout>::value, 0);
+
+		RHHashMap(const this_type&) = delete;
+		this_type& operator=(const this_type&) = delete;
+
+		template<class K>
+		inline static hash_type calcHash_(const K& key)
+		{
+			return hash_detail::calcHash(key);
+		}
+
+		inline size_type hashToPos(hash_type hash) const
+		{
+			return index_.index(hash);
+		}
+
+		inline hash_type hashAt(size_type pos) const
+		{
+			if constexpr (StoreHash) {
+				return hashes_[pos];
+			} else {
+				return calcHash_(slots_.key(pos));
+			}
+		}
+
+		inline void setHash(size_type pos, hash_type hash)
+		{
+			if constexpr (StoreHash) {
+				hashes_[pos] = hash;
+			}
+		}
+
+		inline void swapHash(size_type pos, hash_type& hash)
+		{
+			if constexpr (StoreHash) {
+				hashmap::swap(hashes_[pos], hash);
+			}
+		}
+
+		template<class K>
+		inline bool equal(size_type pos, hash_type hash, const K& key) const
+		{
+			if constexpr (StoreHash) {
+				if (hashes_[pos] != hash) {
+					return false;
+				}
+			}
+			HCOUNT(compares_, 1);
+			bool same = key == slots_.key(pos);
+			HCOUNT(falseMatches_, (StoreHash && !same) ? 1 : 0);
+			return same;
+		}
+		static inline size_type align(size_type x)
+		{
+			return (x + AlignMask) & (~AlignMask);
+		}
+
+		inline void destroy(size_type pos);
+		inline void occupy(distance_type distance, size_type pos, const_key_param_type key, const_value_param_type value);
+		inline void occupy(distance_type distance, size_type pos, key_type&& key, value_type&& value);
+		inline void replace(distance_type distance, size_type dst, size_type src);
+
+		template<class K>
+		size_type find_(hash_type hash, const K& key) const;
+		void reserve_(size_type capacity);
+		/**
+		@brief Bytes of the memory block for a capacity, which is already rounded
+		*/
+		static u64 bytes_(size_type capacity);
+		/**
+		@brief Points the table at a memory block for a capacity, which is already rounded
+		*/
+		void bind_(u8* memory, size_type capacity);
+		/**
+		@brief Points the table at a memory block of an image, which the table does not own
+		@return false if the block does not fit the capacity
+		*/
+		bool bindImage_(const u8* memory, u64 bytes, size_type capacity, size_type size);
+		void unbindImage_();
+		template<class KeyArg, class... Args>
+		bool tryInsert_(hash_type hash, KeyArg&& key, Args&&... args);
+		void place_(hash_type hash, key_type& key, value_type& value);
+		void erase_(size_type pos);
+		void expand(size_type capacity);
+		void expandParallel_(this_type& dst);
+		/**
+		@brief Places entries sorted by homes into slots from begin to end, for a thread owning them
+		@return number of placed entries, and deferred entries are moved to the front of entries
+		*/
+		template<bool Unique, class KeyAt, class ValueAt>
+		size_type placeSorted_(u64* entries, size_type count, size_type begin, size_type end, KeyAt keyAt, ValueAt valueAt, size_type& deferred);
+
+		size_type size_;
+		size_type capacity_;
+		index_policy index_;
+		size_type max_distance_;
+		size_type padded_capacity_;
+		RHDistance* distances_;
+		hash_type* hashes_;
+		slots_type slots_;
+		u32 threads_;
+		memory_allocator allocator_;
+		ResizeObserver observer_;
+		void* observerUser_;
+	};
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::RHHashMap()
+		:size_(0)
+		, capacity_(0)
+		, index_()
+		, max_distance_(0)
+		, padded_capacity_(0)
+		, distances_(NULL)
+		, hashes_(NULL)
+		, slots_()
+		, threads_(1)
+		, allocator_()
+		, observer_(nullptr)
+		, observerUser_(nullptr)
+	{
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::RHHashMap(size_type capacity)
+		:size_(0)
+		, distances_(NULL)
+		, hashes_(NULL)
+		, slots_()
+		, threads_(1)
+		, allocator_()
+		, observer_(nullptr)
+		, observerUser_(nullptr)
+	{
+		reserve_(capacity);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::RHHashMap(const memory_allocator& allocator)
+		:size_(0)
+		, capacity_(0)
+		, index_()
+		, max_distance_(0)
+		, padded_capacity_(0)
+		, distances_(NULL)
+		, hashes_(NULL)
+		, slots_()
+		, threads_(1)
+		, allocator_(allocator)
+		, observer_(nullptr)
+		, observerUser_(nullptr)
+	{
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::RHHashMap(size_type capacity, const memory_allocator& allocator)
+		:size_(0)
+		, distances_(NULL)
+		, hashes_(NULL)
+		, slots_()
+		, threads_(1)
+		, allocator_(allocator)
+		, observer_(nullptr)
+		, observerUser_(nullptr)
+	{
+		reserve_(capacity);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::~RHHashMap()
+	{
+		clear();
+		HALLOCATOR_FREE(allocator_, distances_);
+		slots_.reset();
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	inline typename RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size_type RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::capacity() const
+	{
+		return capacity_;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	inline typename RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size_type RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size() const
+	{
+		return size_;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	TableStats RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::stats() const
+	{
+		TableStats stats;
+		stats.bytes_ = (0 < capacity_) ? bytes_(capacity_) : 0;
+		stats.capacity_ = capacity_;
+		stats.size_ = size_;
+		for (size_type i = 0; i < padded_capacity_; ++i) {
+			if (distances_[i].isOccupy()) {
+				stats.addProbe(distances_[i].distance());
+			}
+		}
+		return stats;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::clear()
+	{
+		for (size_type i = 0; i < padded_capacity_; ++i) {
+			if (distances_[i].isOccupy()) {
+				destroy(i);
+			}
+		}
+		size_ = 0;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::reserve(size_type capacity)
+	{
+		if (capacity <= capacity_) {
+			return;
+		}
+		if (size_ <= 0) {
+			reserve_(capacity);
+		}
+		else {
+			expand(capacity);
+		}
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	bool RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::insert(const_key_param_type key, const_value_param_type value)
+	{
+		return tryInsert_(calcHash_(key), key, value);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	bool RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::insert(key_type&& key, value_type&& value)
+	{
+		size_type hash = calcHash_(key);
+		return tryInsert_(hash, std::move(key), std::move(value));
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<class KeyArg, class... Args>
+	bool RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::emplace(KeyArg&& key, Args&&... args)
+	{
+		typedef typename std::decay<KeyArg>::type arg_type;
+		if constexpr (std::is_same<arg_type, key_type>::value || hash_detail::is_transparent<Key, arg_type>::value) {
+			size_type hash = calcHash_(key);
+			return tryInsert_(hash, std::forward<KeyArg>(key), std::forward<Args>(args)...);
+		} else {
+			key_type tkey(std::forward<KeyArg>(key));
+			size_type hash = calcHash_(tkey);
+			return tryInsert_(hash, std::move(tkey), std::forward<Args>(args)...);
+		}
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<class... Args>
+	bool RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::try_emplace(const_key_param_type key, Args&&... args)
+	{
+		return tryInsert_(calcHash_(key), key, std::forward<Args>(args)...);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<class... Args>
+	bool RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::try_emplace(key_type&& key, Args&&... args)
+	{
+		size_type hash = calcHash_(key);
+		return tryInsert_(hash, std::move(key), std::forward<Args>(args)...);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	typename RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size_type RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::insertBatch(const key_type* keys, const value_type* values, size_type n)
+	{
+		if (n <= 0) {
+			return 0;
+		}
+		if (growth_policy::maxSize(capacity_) < size_ + n) {
+			reserve(growth_policy::capacityFor(size_ + n));
+		}
+
+		size_type chunk = (hash_detail::InsertChunk < n) ? hash_detail::InsertChunk : n;
+		u64* entries = reinterpret_cast<u64*>(HALLOCATOR_MALLOC(allocator_, sizeof(u64) * chunk * 2));
+		size_type inserted = 0;
+		for (size_type base = 0; base < n; base += chunk) {
+			size_type count = (chunk < (n - base)) ? chunk : (n - base);
+			for (size_type i = 0; i < count; ++i) {
+				entries[i] = (static_cast<u64>(calcHash_(keys[base + i])) << 32) | i;
+			}
+			const u64* sorted = hash_detail::sortByHome(count, entries, entries + chunk, capacity_, [this](u32 hash) { return hashToPos(hash); });
+			for (size_type i = 0; i < count; ++i) {
+				size_type index = base + static_cast<u32>(sorted[i]);
+				if (tryInsert_(static_cast<u32>(sorted[i] >> 32), keys[index], values[index])) {
+					++inserted;
+				}
+			}
+		}
+		HALLOCATOR_FREE(allocator_, entries);
+		return inserted;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	typename RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size_type RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::build(const key_type* keys, const value_type* values, size_type n, u32 threads)
+	{
+		clear();
+		if (growth_policy::maxSize(capacity_) < n) {
+			reserve_(growth_policy::capacityFor(n));
+		}
+		if (threads <= 1 || n < hash_detail::ParallelRehashMinimum) {
+			return insertBatch(keys, values, n);
+		}
+
+		u32* offsets = reinterpret_cast<u32*>(HALLOCATOR_MALLOC(allocator_, sizeof(u32) * (threads * 3 + 1)));
+		u32* placed = offsets + threads + 1;
+		u32* deferred = placed + threads;
+		u64* entries = hash_detail::partitionByRegion(allocator_, threads, n, n,
+			[](size_type) { return true; },
+			[this, keys](size_type i) { return calcHash_(keys[i]); },
+			capacity_, [this](hash_type hash) { return hashToPos(hash); }, offsets);
+		u64* work = reinterpret_cast<u64*>(HALLOCATOR_MALLOC(allocator_, sizeof(u64) * n));
+		u64** sorted = reinterpret_cast<u64**>(HALLOCATOR_MALLOC(allocator_, sizeof(u64*) * threads));
+		hash_detail::parallelFor(threads, [&](u32 r) {
+			size_type begin = hash_detail::regionBegin(r, threads, capacity_);
+			size_type end = (r + 1 < threads) ? hash_detail::regionBegin(r + 1, threads, capacity_) : padded_capacity_;
+			size_type count = offsets[r + 1] - offsets[r];
+			sorted[r] = hash_detail::sortByHome(count, entries + offsets[r], work + offsets[r], end - begin, [this, begin](hash_type hash) { return hashToPos(hash) - begin; });
+			placed[r] = placeSorted_<false>(sorted[r], count, begin, end,
+				[keys](size_type i) -> const key_type& { return keys[i]; },
+				[values](size_type i) -> const value_type& { return values[i]; }, deferred[r]);
+		});
+		for (u32 r = 0; r < threads; ++r) {
+			size_ += placed[r];
+		}
+		//Deferred entries are checked against the whole table, since an equal key may have been placed before
+		for (u32 r = 0; r < threads; ++r) {
+			for (size_type i = 0; i < deferred[r]; ++i) {
+				size_type src = static_cast<u32>(sorted[r][i]);
+				tryInsert_(static_cast<hash_type>(sorted[r][i] >> 32), keys[src], values[src]);
+			}
+		}
+		HALLOCATOR_FREE(allocator_, sorted);
+		HALLOCATOR_FREE(allocator_, work);
+		HALLOCATOR_FREE(allocator_, entries);
+		HALLOCATOR_FREE(allocator_, offsets);
+		return size_;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::erase(const_key_param_type key)
+	{
+		size_type pos = find(key);
+		if (valid(pos)) {
+			erase_(pos);
+		}
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<class K, hash_detail::transparent_t<Key, K>>
+	typename RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size_type RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::find(const K& key) const
+	{
+		return (0 < capacity_) ? find_(calcHash_(key), key) : end();
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<class K, hash_detail::transparent_t<Key, K>>
+	bool RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::insert(const K& key, const_value_param_type value)
+	{
+		return tryInsert_(calcHash_(key), key, value);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<class K, hash_detail::transparent_t<Key, K>>
+	void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::erase(const K& key)
+	{
+		size_type pos = find(key);
+		if (pos != end()) {
+			eraseAt(pos);
+		}
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::eraseAt(size_type pos)
+	{
+		if (valid(pos)) {
+			erase_(pos);
+		}
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	typename RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size_type RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::find(const_key_param_type key) const
+	{
+		if (capacity_ <= 0) {
+			return end();
+		}
+		hash_type hash = calcHash_(key);
+		return find_(hash, key);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::findBatch(const key_type* keys, size_type n, iterator* out) const
+	{
+		if (capacity_ <= 0) {
+			for (size_type i = 0; i < n; ++i) {
+				out[i] = end();
+			}
+			return;
+		}
+		hash_type hashes[hash_detail::PrefetchWindow];
+		for (size_type base = 0; base < n; base += hash_detail::PrefetchWindow) {
+			size_type count = (hash_detail::PrefetchWindow < (n - base)) ? hash_detail::PrefetchWindow : (n - base);
+			for (size_type i = 0; i < count; ++i) {
+				hashes[i] = calcHash_(keys[base + i]);
+				size_type pos = hashToPos(hashes[i]);
+				hash_detail::prefetch(&distances_[pos]);
+				hash_detail::prefetch(&slots_.key(pos));
+			}
+			for (size_type i = 0; i < count; ++i) {
+				out[base + i] = find_(hashes[i], keys[base + i]);
+			}
+		}
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	inline bool RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::valid(size_type pos) const
+	{
+		return pos < end();
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	inline typename RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::const_reference RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::getValue(size_type pos) const
+	{
+		HASSERT(valid(pos));
+		return slots_.value(pos);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	inline typename RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::reference RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::getValue(size_type pos)
+	{
+		HASSERT(valid(pos));
+		return slots_.value(pos);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	inline typename RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::const_key_reference RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::getKey(size_type pos) const
+	{
+		HASSERT(valid(pos));
+		return slots_.key(pos);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::moveAt(size_type pos, this_type& dst)
+	{
+		HASSERT(valid(pos));
+		hash_type hash = hashAt(pos);
+		if (growth_policy::maxSize(dst.capacity_) <= dst.size_) {
+			dst.expand(growth_policy::nextCapacity(dst.capacity_));
+		}
+		//Placement leaves the moved-from entry in the slot, which erase_ destroys
+		dst.place_(hash, slots_.key(pos), slots_.value(pos));
+		erase_(pos);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	const typename RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::memory_allocator& RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::getAllocator() const
+	{
+		return allocator_;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::setResizeObserver(ResizeObserver observer, void* user)
+	{
+		observer_ = observer;
+		observerUser_ = user;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	typename RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size_type RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::roundCapacity(size_type capacity)
+	{
+		return index_policy::roundCapacity(capacity);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	typename RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size_type RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::available() const
+	{
+		size_type limit = growth_policy::maxSize(capacity_);
+		return (size_ < limit) ? limit - size_ : 0;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	typename RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size_type RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::capacityFor(size_type size)
+	{
+		return growth_policy::capacityFor(size);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::swap(this_type& rhs)
+	{
+		hashmap::swap(size_, rhs.size_);
+		hashmap::swap(capacity_, rhs.capacity_);
+		hashmap::swap(index_, rhs.index_);
+		hashmap::swap(max_distance_, rhs.max_distance_);
+		hashmap::swap(padded_capacity_, rhs.padded_capacity_);
+		hashmap::swap(distances_, rhs.distances_);
+		hashmap::swap(hashes_, rhs.hashes_);
+		slots_.swap(rhs.slots_);
+		hashmap::swap(allocator_, rhs.allocator_);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	inline void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::destroy(size_type pos)
+	{
+		HASSERT(valid(pos));
+
+		distances_[pos].setEmpty();
+		slots_.key(pos).~key_type();
+		slots_.value(pos).~value_type();
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	inline void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::occupy(distance_type distance, size_type pos, const_key_param_type key, const_value_param_type value)
+	{
+		HASSERT(valid(pos));
+		HASSERT(distances_[pos].isEmpty());
+
+		distances_[pos].set(distance);
+		construct(&slots_.key(pos), key);
+		construct(&slots_.value(pos), value);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	inline void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::occupy(distance_type distance, size_type pos, key_type&& key, value_type&& value)
+	{
+		HASSERT(valid(pos));
+		HASSERT(distances_[pos].isEmpty());
+
+		distances_[pos].set(distance);
+		construct(&slots_.key(pos), std::move(key));
+		construct(&slots_.value(pos), std::move(value));
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	inline void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::replace(distance_type distance, size_type dst, size_type src)
+	{
+		HASSERT(valid(dst));
+		HASSERT(valid(src));
+		HASSERT(distances_[dst].isEmpty());
+
+		distances_[dst].set(distance);
+		if constexpr (StoreHash) {
+			hashes_[dst] = hashes_[src];
+		}
+		construct(&slots_.key(dst), move(slots_.key(src)));
+		construct(&slots_.value(dst), move(slots_.value(src)));
+		destroy(src);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<class K>
+	typename RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size_type RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::find_(hash_type hash, const K& key) const
+	{
+		size_type pos = hashToPos(hash);
+		size_type pend = pos + max_distance_;
+		HASSERT(pend <= padded_capacity_);
+		for (size_type i = pos; i != pend; ++i) {
+			HCOUNT(probes_, 1);
+			if (distances_[i].isOccupy() && equal(i, hash, key)) {
+				return i;
+			}
+		}
+		return end();
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::reserve_(size_type capacity)
+	{
+		HASSERT(size_ <= 0);
+
+		HALLOCATOR_FREE(allocator_, distances_);
+
+		capacity = index_policy::roundCapacity(capacity);
+		u8* mem = reinterpret_cast<u8*>(HALLOCATOR_MALLOC(allocator_, bytes_(capacity)));
+		bind_(mem, capacity);
+
+		::memset(distances_, -1, align(sizeof(RHDistance) * padded_capacity_));
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	u64 RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::bytes_(size_type capacity)
+	{
+		size_type padded_capacity = capacity + hash_detail::log2(capacity);
+		size_type size_distances = align(sizeof(RHDistance) * padded_capacity);
+		size_type size_hashes = StoreHash ? align(sizeof(hash_type) * padded_capacity) : 0;
+		return size_distances + size_hashes + slots_type::bytes(padded_capacity);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::bind_(u8* memory, size_type capacity)
+	{
+		capacity_ = capacity;
+		index_.reset(capacity_);
+		max_distance_ = hash_detail::log2(capacity_);
+		padded_capacity_ = capacity_ + max_distance_;
+
+		size_type size_distances = align(sizeof(RHDistance) * padded_capacity_);
+		size_type size_hashes = StoreHash ? align(sizeof(hash_type) * padded_capacity_) : 0;
+		distances_ = reinterpret_cast<RHDistance*>(memory);
+		hashes_ = StoreHash ? reinterpret_cast<hash_type*>(memory + size_distances) : NULL;
+		slots_.bind(memory + size_distances + size_hashes, padded_capacity_);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	bool RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::bindImage_(const u8* memory, u64 bytes, size_type capacity, size_type size)
+	{
+		HASSERT(nullptr == distances_);
+		if (capacity <= 0) {
+			return bytes <= 0 && size <= 0;
+		}
+		if (index_policy::roundCapacity(capacity) != capacity || bytes_(capacity) != bytes || capacity < size) {
+			return false;
+		}
+		bind_(const_cast<u8*>(memory), capacity);
+		size_ = size;
+		return true;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::unbindImage_()
+	{
+		size_ = 0;
+		capacity_ = 0;
+		max_distance_ = 0;
+		padded_capacity_ = 0;
+		distances_ = NULL;
+		hashes_ = NULL;
+		slots_.reset();
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<class KeyArg, class... Args>
+	bool RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::tryInsert_(hash_type hash, KeyArg&& key, Args&&... args)
+	{
+		if (capacity_ <= 0) {
+			expand(growth_policy::nextCapacity(capacity_));
+		}
+		else if (valid(find_(hash, key))) {
+			return false;
+		}
+		else if (growth_policy::maxSize(capacity_) <= size_) {
+			expand(growth_policy::nextCapacity(capacity_));
+		}
+
+		for (;;) {
+			//Follows the probe of place_ without moving: each entry closer to its home than the carried one is carried on, until an empty slot.
+			//The probe stays in a window of max_distance_ slots, at most 32, which bounds the entries to shift
+			size_type chain[32];
+			size_type length = 0;
+			size_type pos = hashToPos(hash);
+			size_type end = pos + max_distance_;
+			HASSERT(max_distance_ <= 32);
+			distance_type landing = 0;
+			distance_type d = 0;
+			for (; pos != end; ++pos, ++d) {
+				HCOUNT(probes_, 1);
+				if (distances_[pos].isEmpty()) {
+					break;
+				}
+				if (distances_[pos].distance_ < d) {
+					landing = (length <= 0) ? d : landing;
+					chain[length++] = pos;
+					d = distances_[pos].distance_;
+				}
+			}
+			if (pos == end) {
+				expand(growth_policy::nextCapacity(capacity_));
+				continue;
+			}
+			landing = (length <= 0) ? d : landing;
+			for (size_type i = length; 0 < i; --i) {
+				HCOUNT(displacements_, 1);
+				size_type src = chain[i - 1];
+				replace(static_cast<distance_type>(distances_[src].distance_ + (pos - src)), pos, src);
+				pos = src;
+			}
+			HPLACEMENT_NEW(&slots_.key(pos)) key_type(std::forward<KeyArg>(key));
+			HPLACEMENT_NEW(&slots_.value(pos)) value_type(std::forward<Args>(args)...);
+			distances_[pos].set(landing);
+			setHash(pos, hash);
+			++size_;
+			return true;
+		}
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::place_(hash_type hash, key_type& key, value_type& value)
+	{
+		size_type pos = hashToPos(hash);
+		size_type end = pos + max_distance_;
+		for (;;) {
+			distance_type d = 0;
+			for (size_type i = pos; i != end; ++i, ++d) {
+				HCOUNT(probes_, 1);
+				if (distances_[i].isEmpty()) {
+					occupy(d, i, std::move(key), std::move(value));
+					setHash(i, hash);
+					++size_;
+					return;
+				}
+				if (distances_[i].distance_ < d) {
+					HCOUNT(displacements_, 1);
+					hashmap::swap(slots_.key(i), key);
+					hashmap::swap(slots_.value(i), value);
+					hashmap::swap(distances_[i].distance_, d);
+					swapHash(i, hash);
+				}
+			}
+			expand(growth_policy::nextCapacity(capacity_));
+			//Without stored hashes, the hash of a displaced entry is not known until here
+			hash = StoreHash ? hash : calcHash_(key);
+			pos = hashToPos(hash);
+			end = pos + max_distance_;
+		}
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::erase_(size_type pos)
+	{
+		destroy(pos);
+		--size_;
+#if 1
+		size_type end = pos + max_distance_;
+		distance_type d = 1;
+		for (size_type i = pos + 1; i != end; ++i, ++d) {
+			HCOUNT(probes_, 1);
+			if (d <= distances_[i].distance_) {
+				HCOUNT(displacements_, 1);
+				replace(distances_[i].distance_ - d, pos, i);
+#if 1
+				return;
+#else
+				pos = i;
+				d = 0;
+#endif
+			}
+		}
+#endif
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	typename RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::iterator
+		RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::begin() const
+	{
+		for (size_type i = 0; i < end(); ++i) {
+			if (distances_[i].isOccupy()) {
+				return i;
+			}
+		}
+		return end();
+	}
+
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	typename RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::iterator
+		RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::next(iterator pos) const
+	{
+		for (size_type i = pos + 1; i < end(); ++i) {
+			if (distances_[i].isOccupy()) {
+				return i;
+			}
+		}
+		return end();
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::expand(size_type capacity)
+	{
+		HCOUNT_RESIZE();
+		hash_detail::ResizeNotifier notifier(observer_, observerUser_, capacity_, roundCapacity(capacity), size_);
+		this_type tmp(capacity, allocator_);
+		tmp.threads_ = threads_;
+		if (1 < threads_ && hash_detail::ParallelRehashMinimum <= size_) {
+			expandParallel_(tmp);
+			tmp.swap(*this);
+			return;
+		}
+		size_type end = padded_capacity_;
+		for (size_type i = 0; i != end; ++i) {
+			if (distances_[i].isOccupy()) {
+				tmp.place_(hashAt(i), slots_.key(i), slots_.value(i));
+			}
+		}
+		tmp.swap(*this);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::expandParallel_(this_type& dst)
+	{
+		u32* offsets = reinterpret_cast<u32*>(HALLOCATOR_MALLOC(allocator_, sizeof(u32) * (threads_ * 3 + 1)));
+		u32* placed = offsets + threads_ + 1;
+		u32* deferred = placed + threads_;
+		u64* entries = hash_detail::partitionByRegion(allocator_, threads_, padded_capacity_, size_,
+			[this](size_type i) { return distances_[i].isOccupy(); },
+			[this](size_type i) { return hashAt(i); },
+			dst.capacity_, [&dst](hash_type hash) { return dst.hashToPos(hash); }, offsets);
+		u64* work = reinterpret_cast<u64*>(HALLOCATOR_MALLOC(allocator_, sizeof(u64) * size_));
+		u64** sorted = reinterpret_cast<u64**>(HALLOCATOR_MALLOC(allocator_, sizeof(u64*) * threads_));
+		hash_detail::parallelFor(threads_, [&](u32 r) {
+			//Placed in order of homes, an entry never displaces a previous one, and takes the first empty slot after its home
+			size_type begin = hash_detail::regionBegin(r, threads_, dst.capacity_);
+			size_type end = (r + 1 < threads_) ? hash_detail::regionBegin(r + 1, threads_, dst.capacity_) : dst.padded_capacity_;
+			size_type count = offsets[r + 1] - offsets[r];
+			sorted[r] = hash_detail::sortByHome(count, entries + offsets[r], work + offsets[r], end - begin, [&dst, begin](hash_type hash) { return dst.hashToPos(hash) - begin; });
+			placed[r] = dst.template placeSorted_<true>(sorted[r], count, begin, end,
+				[this](size_type i) -> key_type&& { return std::move(slots_.key(i)); },
+				[this](size_type i) -> value_type&& { return std::move(slots_.value(i)); }, deferred[r]);
+		});
+		for (u32 r = 0; r < threads_; ++r) {
+			dst.size_ += placed[r];
+		}
+		for (u32 r = 0; r < threads_; ++r) {
+			for (size_type i = 0; i < deferred[r]; ++i) {
+				size_type src = static_cast<u32>(sorted[r][i]);
+				dst.place_(static_cast<hash_type>(sorted[r][i] >> 32), slots_.key(src), slots_.value(src));
+			}
+		}
+		HALLOCATOR_FREE(allocator_, sorted);
+		HALLOCATOR_FREE(allocator_, work);
+		HALLOCATOR_FREE(allocator_, entries);
+		HALLOCATOR_FREE(allocator_, offsets);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	template<bool Unique, class KeyAt, class ValueAt>
+	typename RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::size_type RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::placeSorted_(u64* entries, size_type count, size_type begin, size_type end, KeyAt keyAt, ValueAt valueAt, size_type& deferred)
+	{
+		//Placed in order of homes, an entry never displaces a previous one, and takes the first empty slot after its home
+		size_type pos = begin;
+		size_type last = end;
+		size_type run = begin;
+		size_type placed = 0;
+		deferred = 0;
+		for (size_type i = 0; i < count; ++i) {
+			hash_type hash = static_cast<hash_type>(entries[i] >> 32);
+			size_type src = static_cast<u32>(entries[i]);
+			size_type home = hashToPos(hash);
+			pos = (pos < home) ? home : pos;
+			if (last != home) {
+				last = home;
+				run = pos;
+			}
+			if (end <= pos || max_distance_ <= (pos - home)) {
+				//Leave it to a serial placement, which can displace entries of the next region
+				entries[deferred++] = entries[i];
+				continue;
+			}
+			if constexpr (!Unique) {
+				//Equal keys share a home, so that a previous one is in the run of the home
+				size_type j = run;
+				while (j < pos && !equal(j, hash, keyAt(src))) {
+					++j;
+				}
+				if (j < pos) {
+					continue;
+				}
+			}
+			occupy(static_cast<distance_type>(pos - home), pos, keyAt(src), valueAt(src));
+			setHash(pos, hash);
+			++pos;
+			++placed;
+		}
+		return placed;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	void RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::setRehashThreads(u32 threads)
+	{
+		threads_ = (0 < threads) ? threads : 1;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	u32 RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::getRehashThreads() const
+	{
+		return threads_;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, bool StoreHash, class Layout>
+	bool RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>::saveImage(const char* path) const
+	{
+		static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value, "An image needs trivially copyable keys and values");
+		u64 bytes = (0 < capacity_) ? bytes_(capacity_) : 0;
+		return hash_detail::writeImage(path, ImageKind, index_policy::Id, growth_policy::Id, sizeof(Key), sizeof(Value), capacity_, size_, distances_, bytes);
+	}
+
+	//--- SwissTable
+	//-------------------------------------------------------
+	namespace hash_detail
+	{
+		inline bool detectAvx2()
+		{
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 1);
+			//OSXSAVE and AVX
+			if ((info[2] & (0x01 << 27)) == 0 || (info[2] & (0x01 << 28)) == 0) {
+				return false;
+			}
+			//OS saves XMM and YMM registers
+			if ((_xgetbv(0) & 0x06ULL) != 0x06ULL) {
+				return false;
+			}
+			__cpuidex(info, 7, 0);
+			return 0 != (info[1] & (0x01 << 5));
+#elif defined(__GNUC__)
+			return __builtin_cpu_supports("avx2");
+#else
+			return false;
+#endif
+		}
+	}
+
+	/**
+	@brief Group of 16 control bytes, matched with SSE2
+	*/
+	class GroupSse2
+	{
+	public:
+		inline static constexpr u32 Width = 16;
+
+		explicit GroupSse2(const u8* controls)
+			:controls_(_mm_loadu_si128(reinterpret_cast<const __m128i*>(controls)))
+		{}
+
+		/**
+		@brief Bit mask of bytes equal to x
+		*/
+		u32 match(u8 x) const
+		{
+			return static_cast<u32>(_mm_movemask_epi8(_mm_cmpeq_epi8(controls_, _mm_set1_epi8(static_cast<char>(x)))));
+		}
+
+		/**
+		@brief Bit mask of bytes whose most significant bit is set, empty or deleted
+		*/
+		u32 matchEmptyOrDeleted() const
+		{
+			return static_cast<u32>(_mm_movemask_epi8(controls_));
+		}
+	private:
+		__m128i controls_;
+	};
+
+	/**
+	@brief Group of 32 control bytes, matched with AVX2
+
+	Falls back to two SSE2 matches on CPUs without AVX2, when the compiler does not target AVX2.
+	The CPU is checked once, on the first match, which selects the functions every later match calls.
+	*/
+	class GroupAvx2
+	{
+	public:
+		inline static constexpr u32 Width = 32;
+
+		explicit GroupAvx2(const u8* controls)
+			:controls_(controls)
+		{}
+
+		/**
+		@brief Bit mask of bytes equal to x
+		*/
+		u32 match(u8 x) const
+		{
+#if defined(__AVX2__)
+			return match256(controls_, x);
+#else
+			return matchers_().match_(controls_, x);
+#endif
+		}
+
+		/**
+		@brief Bit mask of bytes whose most significant bit is set, empty or deleted
+		*/
+		u32 matchEmptyOrDeleted() const
+		{
+#if defined(__AVX2__)
+			return matchEmptyOrDeleted256(controls_);
+#else
+			return matchers_().matchEmptyOrDeleted_(controls_);
+#endif
+		}
+	private:
+		struct Matchers
+		{
+			u32 (*match_)(const u8* controls, u8 x);
+			u32 (*matchEmptyOrDeleted_)(const u8* controls);
+		};
+
+		/**
+		@brief Selects AVX2 matchers if the CPU has them
+		*/
+		static Matchers dispatch_()
+		{
+			if (hash_detail::detectAvx2()) {
+				return {match256, matchEmptyOrDeleted256};
+			}
+			return {match128, matchEmptyOrDeleted128};
+		}
+
+		static const Matchers& matchers_()
+		{
+			static const Matchers matchers = dispatch_();
+			return matchers;
+		}
+
+		HASHMAP_TARGET_AVX2 static u32 match256(const u8* controls, u8 x)
+		{
+			__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(controls));
+			return static_cast<u32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(static_cast<char>(x)))));
+		}
+
+		static u32 match128(const u8* controls, u8 x)
+		{
+			return GroupSse2(controls).match(x) | (GroupSse2(controls + GroupSse2::Width).match(x) << 16);
+		}
+
+		HASHMAP_TARGET_AVX2 static u32 matchEmptyOrDeleted256(const u8* controls)
+		{
+			return static_cast<u32>(_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(controls))));
+		}
+
+		static u32 matchEmptyOrDeleted128(const u8* controls)
+		{
+			return GroupSse2(controls).matchEmptyOrDeleted() | (GroupSse2(controls + GroupSse2::Width).matchEmptyOrDeleted() << 16);
+		}
+
+		const u8* controls_;
+	};
+
+	template<class Key, class Value, class MemoryAllocator = DefaultAllocator, class GrowthPolicy = DefaultGrowthPolicy, class IndexPolicy = PrimeIndexPolicy, class Group = GroupSse2, bool StoreHash = false, class Layout = SoALayout>
+	class SwissTable
+	{
+	public:
+		inline static constexpr u32 Invalid = 0xFFFF'FFFFUL;
+		/// Each sub-array of a table starts at a cache line
+		inline static constexpr u32 Align = hash_detail::CacheLineSize;
+		inline static constexpr u32 AlignMask = Align - 1;
+		inline static constexpr u32 Block = Group::Width;
+		inline static constexpr u32 BlockMask = Block - 1;
+		inline static constexpr u32 Expand = 128;
+
+		typedef Key key_type;
+		typedef Value value_type;
+		typedef MemoryAllocator memory_allocator;
+		typedef GrowthPolicy growth_policy;
+		typedef IndexPolicy index_policy;
+		typedef Layout layout_policy;
+		typedef typename Layout::template Slots<Key, Value> slots_type;
+		typedef Group group_type;
+
+		typedef SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout> this_type;
+
+		typedef u32 size_type;
+		typedef size_type iterator;
+
+		typedef hash_detail::type_traits<value_type> value_traits;
+		typedef typename value_traits::pointer value_pointer;
+		typedef typename value_traits::const_pointer const_value_pointer;
+		typedef typename value_traits::reference value_reference;
+		typedef typename value_traits::const_reference const_value_reference;
+		typedef typename value_traits::pointer pointer;
+		typedef typename value_traits::const_pointer const_pointer;
+		typedef typename value_traits::reference reference;
+		typedef typename value_traits::const_reference const_reference;
+		typedef typename value_traits::param_type value_param_type;
+		typedef typename value_traits::const_param_type const_value_param_type;
+		typedef typename value_traits::lvalue value_lvalue_type;
+
+
+		typedef hash_detail::type_traits<key_type> key_traits;
+		typedef typename key_traits::pointer key_pointer;
+		typedef typename key_traits::const_pointer const_key_pointer;
+		typedef typename key_traits::reference key_reference;
+		typedef typename key_traits::const_reference const_key_reference;
+		typedef typename key_traits::param_type key_param_type;
+		typedef typename key_traits::const_param_type const_key_param_type;
+		typedef typename key_traits::lvalue key_lvalue_type;
+
+		/**
+		@brief Control byte of a slot
+
+		- Empty:   0b1000'0000
+		- Deleted: 0b1111'1110
+		- Full:    0b0xxx'xxxx (lower 7 bits of the hash)
+		*/
+		struct Control
+		{
+			inline static constexpr u8 Empty = 0x80U;
+			inline static constexpr u8 Deleted = 0xFEU;
+
+			inline bool isOccupied() const
+			{
+				return 0 == (0x80U & control_);
+			}
+
+			inline bool isEmpty() const
+			{
+				return Empty == control_;
+			}
 
-		size_type calcHash_(const_key_param_type key) const
-		{
-			return hash_detail::calcHash(key) & bucket_type::HashMask;
-		}
+			inline bool isDeleted() const
+			{
+				return Deleted == control_;
+			}
 
-		static inline size_type align(size_type x)
-		{
-			return (x + AlignMask) & (~AlignMask);
-		}
+			inline bool isEmptyOrDeleted() const
+			{
+				return 0 != (0x80U & control_);
+			}
+			uint8_t control_;
+		};
+
+		SwissTable();
+		explicit SwissTable(size_type capacity);
+		/**
+		@param allocator ... copied into the table, every block of the table is drawn from it
+		*/
+		explicit SwissTable(const memory_allocator& allocator);
+		SwissTable(size_type capacity, const memory_allocator& allocator);
+		~SwissTable();
 
-		void expand();
+		void initialize(size_type capacity);
 
-		size_type find_(const_key_param_type key, size_type hash) const;
-		void erase_(size_type pos, u32 rawHash);
+		size_type capacity() const;
+
+		size_type size() const;
+		/**
+		@brief Walks every slot, which takes time in proportion to the capacity
+		*/
+		TableStats stats() const;
+
+		void clear();
+
+		bool valid(size_type pos) const;
+
+		size_type find(const_key_param_type key) const;
+
+		/**
+		@brief Prefetches the first group of controls and slots of each probe, as HashMap::findBatch
+		*/
+		void findBatch(const key_type* keys, size_type n, iterator* out) const;
+
+		bool insert(const_key_param_type key, const_value_param_type value);
+		bool insert(key_type&& key, value_type&& value);
+
+		template<class KeyArg, class... Args>
+		bool emplace(KeyArg&& key, Args&&... args);
+		template<class... Args>
+		bool try_emplace(const_key_param_type key, Args&&... args);
+		template<class... Args>
+		bool try_emplace(key_type&& key, Args&&... args);
+
+		size_type insertBatch(const key_type* keys, const value_type* values, size_type n);
+
+		/**
+		@brief Replaces contents with n pairs, returns the number of distinct keys
+
+		Sizes the table once, then hashes keys and fills regions of home positions on threads. The first of equal keys wins.
+		*/
+		size_type build(const key_type* keys, const value_type* values, size_type n, u32 threads);
+
+		void erase(const_key_param_type key);
+
+		template<class K, hash_detail::transparent_t<Key, K> = 0>
+		size_type find(const K& key) const;
+		template<class K, hash_detail::transparent_t<Key, K> = 0>
+		bool insert(const K& key, const_value_param_type value);
+		template<class K, hash_detail::transparent_t<Key, K> = 0>
+		void erase(const K& key);
+		void eraseAt(size_type pos);
+
+		void moveAt(size_type pos, this_type& dst);
+		/**
+		@brief Allocator, which tables created by growth share
+		*/
+		const memory_allocator& getAllocator() const;
+		/**
+		@brief As HashMap::setResizeObserver, which also reports in-place rehashes that reclaim tombstones
+		*/
+		void setResizeObserver(ResizeObserver observer, void* user);
+		static size_type roundCapacity(size_type capacity);
+		/**
+		@brief As HashMap::available, in which tombstones count as entries
+		*/
+		size_type available() const;
+		static size_type capacityFor(size_type size);
+		void swap(this_type& rhs);
+
+		iterator begin() const;
+
+		iterator end() const;
+
+		iterator next(iterator pos) const;
+
+		reference getValue(size_type pos);
+
+		const_reference getValue(size_type pos) const;
+
+		key_reference getKey(size_type pos);
+
+		const_key_reference getKey(size_type pos) const;
+
+		/**
+		@brief Number of threads to rehash with on expansion, 1 by default
+		*/
+		void setRehashThreads(u32 threads);
+		u32 getRehashThreads() const;
+
+		/**
+		@brief Writes the memory block of the table as it is, which MappedTable maps back without rehash
+		@return false if the file cannot be written
+		*/
+		bool saveImage(const char* path) const;
+	private:
+		template<class, class, u32, class, class, class, class, bool, class>
+		friend class ConcurrentSwissTable;
+		template<class, class, u32, class, class, class, class, bool, class>
+		friend class OptimisticSwissTable;
+		template<class>
+		friend class MappedTable;
+
+		inline static constexpr u32 ImageKind = hash_detail::imageKind('S', StoreHash, std::is_same<Layout, AoSLayout>::value, Block);
+
+		SwissTable(const SwissTable&) = delete;
+		SwissTable& operator=(const SwissTable&) = delete;
+
+		template<class K>
+		size_type calcHash_(const K& key) const;
+		static inline size_type align(size_type x, size_type mask);
+		static inline u32 h1(u32 hash);
+		static inline u8 h2(u32 hash);
+		inline size_type probeStart(u32 hash) const;
+		inline size_type probeIndex(size_type start, size_type pos) const;
+		inline size_type probeCount() const;
+		inline size_type wrap(size_type pos) const;
+		inline size_type growthLimit() const;
+		inline bool wasNeverFull(size_type pos) const;
+		inline void setControl(size_type pos, u8 control);
+		inline u32 hashAt(size_type pos) const;
+		inline void setHash(size_type pos, u32 hash);
+		template<class K>
+		inline bool equal(size_type pos, u32 hash, const K& key) const;
+
+		void prepareInsert_();
+		void reserve_(size_type n);
+		void rehashInPlace_();
+		void expand(size_type capacity);
+		void expandParallel_(this_type& dst);
+		/**
+		@brief Places an entry with a probe which does not reach end, for a thread owning slots before end
+
+		Unless Unique, an equal key on the probe is left as it is.
+		*/
+		template<bool Unique, class KeyArg, class ValueArg>
+		hash_detail::Placement placeBefore_(u32 hash, size_type end, KeyArg&& key, ValueArg&& value);
+
+		template<class K>
+		size_type find_(const K& key, size_type hash) const;
+		size_type findInsertPos_(size_type hash) const;
+		/**
+		@brief Probes once for key, and for the first empty or deleted slot on the way
+		@return the position of key, or end() with insertPos set
+		*/
+		template<class K>
+		size_type findOrInsertPos_(const K& key, size_type hash, size_type& insertPos) const;
+		template<class KeyArg, class... Args>
+		bool tryInsert_(size_type hash, KeyArg&& key, Args&&... args);
+		void insert_(u32 hash, key_lvalue_type key, value_lvalue_type value);
 
 		void create(size_type capacity);
 		void destroy();
+		/**
+		@brief Bytes of the memory block for a capacity, which is already rounded
+		*/
+		static u64 bytes_(size_type capacity);
+		/**
+		@brief Points the table at a memory block for a capacity, which is already rounded
+		*/
+		void bind_(u8* memory, size_type capacity);
+		/**
+		@brief Points the table at a memory block of an image, which the table does not own
+		@return false if the block does not fit the capacity
+		*/
+		bool bindImage_(const u8* memory, u64 bytes, size_type capacity, size_type size);
+		void unbindImage_();
+		static u32 leastSignificantBit(u32 x);
+		static u32 mostSignificantBit(u32 x);
+		static u32 next_pos(u32 x);
 
 		size_type capacity_;
+		index_policy index_;
 		size_type size_;
-		s32 empty_;
-		s32 freeList_;
-		bucket_type* buckets_;
-		key_pointer keys_;
-		value_pointer values_;
+		size_type deleted_;
+		Control* controls_;
+		u32* hashes_;
+		slots_type slots_;
+		u32 threads_;
+		memory_allocator allocator_;
+		ResizeObserver observer_;
+		void* observerUser_;
 	};
 
-	template<class Key, class Value, class MemoryAllocator>
-	HashMap<Key, Value, MemoryAllocator>::HashMap()
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::SwissTable()
 		:capacity_(0)
+		, index_()
 		, size_(0)
-		, empty_(0)
-		, freeList_(-1)
-		, buckets_(NULL)
-		, keys_(NULL)
-		, values_(NULL)
+		, deleted_(0)
+		, controls_(nullptr)
+		, hashes_(nullptr)
+		, slots_()
+		, threads_(1)
+		, allocator_()
+		, observer_(nullptr)
+		, observerUser_(nullptr)
 	{}
 
-	template<class Key, class Value, class MemoryAllocator>
-	HashMap<Key, Value, MemoryAllocator>::HashMap(size_type capacity)
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::SwissTable(size_type capacity)
 		:capacity_(0)
+		, index_()
 		, size_(0)
-		, empty_(0)
-		, freeList_(-1)
-		, buckets_(NULL)
-		, keys_(NULL)
-		, values_(NULL)
+		, deleted_(0)
+		, controls_(nullptr)
+		, hashes_(nullptr)
+		, slots_()
+		, threads_(1)
+		, allocator_()
+		, observer_(nullptr)
+		, observerUser_(nullptr)
+	{
+		create(capacity);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::SwissTable(const memory_allocator& allocator)
+		:capacity_(0)
+		, index_()
+		, size_(0)
+		, deleted_(0)
+		, controls_(nullptr)
+		, hashes_(nullptr)
+		, slots_()
+		, threads_(1)
+		, allocator_(allocator)
+		, observer_(nullptr)
+		, observerUser_(nullptr)
+	{}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::SwissTable(size_type capacity, const memory_allocator& allocator)
+		:capacity_(0)
+		, index_()
+		, size_(0)
+		, deleted_(0)
+		, controls_(nullptr)
+		, hashes_(nullptr)
+		, slots_()
+		, threads_(1)
+		, allocator_(allocator)
+		, observer_(nullptr)
+		, observerUser_(nullptr)
 	{
 		create(capacity);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	HashMap<Key, Value, MemoryAllocator>::~HashMap()
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::~SwissTable()
+	{
+		destroy();
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::initialize(size_type capacity)
 	{
 		destroy();
+		create(capacity);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void HashMap<Key, Value, MemoryAllocator>::clear()
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::capacity() const
 	{
+		return capacity_;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size() const
+	{
+		return size_;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	TableStats SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::stats() const
+	{
+		TableStats stats;
+		stats.bytes_ = (0 < capacity_) ? bytes_(capacity_) : 0;
+		stats.capacity_ = capacity_;
+		stats.size_ = size_;
+		stats.tombstones_ = deleted_;
 		for (size_type i = 0; i < capacity_; ++i) {
-			if (buckets_[i].isOccupy()) {
-				keys_[i].~key_type();
-				values_[i].~value_type();
+			if (controls_[i].isOccupied()) {
+				stats.addProbe(probeIndex(probeStart(hashAt(i)), i));
+			}
+		}
+		return stats;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::clear()
+	{
+		for (size_type i = 0; i < capacity_; ++i) {
+			if (controls_[i].isOccupied()) {
+				slots_.key(i).~key_type();
+				slots_.value(i).~value_type();
 			}
-			buckets_[i].index_ = -1;
-			buckets_[i].next_ = -1;
-			buckets_[i].clear();
 		}
 		size_ = 0;
-		empty_ = 0;
-		freeList_ = -1;
+		deleted_ = 0;
+		::memset(controls_, Control::Empty, sizeof(Control) * (capacity_ + Block));
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	typename HashMap<Key, Value, MemoryAllocator>::size_type
-		HashMap<Key, Value, MemoryAllocator>::find_(const_key_param_type key, size_type hash) const
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	bool SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::valid(size_type pos) const
 	{
-		s32 bucketPos = hash % capacity_;
-		hash |= bucket_type::OccupyFlag;
-		for (s32 i = buckets_[bucketPos].index_; 0 <= i; i = buckets_[i].next_) {
-#if 1
-			if (hash == buckets_[i].hash_ && key == keys_[i]) {
+		return (pos < capacity_);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::find(const_key_param_type key) const
+	{
+		return (0 < capacity_) ? find_(key, calcHash_(key)) : end();
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::findBatch(const key_type* keys, size_type n, iterator* out) const
+	{
+		if (capacity_ <= 0) {
+			for (size_type i = 0; i < n; ++i) {
+				out[i] = end();
+			}
+			return;
+		}
+		size_type hashes[hash_detail::PrefetchWindow];
+		for (size_type base = 0; base < n; base += hash_detail::PrefetchWindow) {
+			size_type count = (hash_detail::PrefetchWindow < (n - base)) ? hash_detail::PrefetchWindow : (n - base);
+			for (size_type i = 0; i < count; ++i) {
+				hashes[i] = calcHash_(keys[base + i]);
+				size_type pos = probeStart(hashes[i]);
+				hash_detail::prefetch(controls_ + pos);
+				hash_detail::prefetch(&slots_.key(pos));
+			}
+			for (size_type i = 0; i < count; ++i) {
+				out[base + i] = find_(keys[base + i], hashes[i]);
+			}
+		}
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	bool SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::insert(const_key_param_type key, const_value_param_type value)
+	{
+		return tryInsert_(calcHash_(key), key, value);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	bool SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::insert(key_type&& key, value_type&& value)
+	{
+		size_type hash = calcHash_(key);
+		return tryInsert_(hash, std::move(key), std::move(value));
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	template<class KeyArg, class... Args>
+	bool SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::emplace(KeyArg&& key, Args&&... args)
+	{
+		typedef typename std::decay<KeyArg>::type arg_type;
+		if constexpr (std::is_same<arg_type, key_type>::value || hash_detail::is_transparent<Key, arg_type>::value) {
+			size_type hash = calcHash_(key);
+			return tryInsert_(hash, std::forward<KeyArg>(key), std::forward<Args>(args)...);
+		} else {
+			key_type tkey(std::forward<KeyArg>(key));
+			size_type hash = calcHash_(tkey);
+			return tryInsert_(hash, std::move(tkey), std::forward<Args>(args)...);
+		}
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	template<class... Args>
+	bool SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::try_emplace(const_key_param_type key, Args&&... args)
+	{
+		return tryInsert_(calcHash_(key), key, std::forward<Args>(args)...);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	template<class... Args>
+	bool SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::try_emplace(key_type&& key, Args&&... args)
+	{
+		size_type hash = calcHash_(key);
+		return tryInsert_(hash, std::move(key), std::forward<Args>(args)...);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::insertBatch(const key_type* keys, const value_type* values, size_type n)
+	{
+		if (n <= 0) {
+			return 0;
+		}
+		reserve_(n);
+
+		size_type chunk = (hash_detail::InsertChunk < n) ? hash_detail::InsertChunk : n;
+		u64* entries = reinterpret_cast<u64*>(HALLOCATOR_MALLOC(allocator_, sizeof(u64) * chunk * 2));
+		size_type inserted = 0;
+		for (size_type base = 0; base < n; base += chunk) {
+			size_type count = (chunk < (n - base)) ? chunk : (n - base);
+			for (size_type i = 0; i < count; ++i) {
+				entries[i] = (static_cast<u64>(calcHash_(keys[base + i])) << 32) | i;
+			}
+			const u64* sorted = hash_detail::sortByHome(count, entries, entries + chunk, capacity_, [this](u32 hash) { return probeStart(hash); });
+			for (size_type i = 0; i < count; ++i) {
+				size_type index = base + static_cast<u32>(sorted[i]);
+				if (tryInsert_(static_cast<u32>(sorted[i] >> 32), keys[index], values[index])) {
+					++inserted;
+				}
+			}
+		}
+		HALLOCATOR_FREE(allocator_, entries);
+		return inserted;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::build(const key_type* keys, const value_type* values, size_type n, u32 threads)
+	{
+		if (growthLimit() < n) {
+			destroy();
+			create(capacityFor(n));
+		} else if (0 < capacity_) {
+			clear();
+		}
+		if (threads <= 1 || n < hash_detail::ParallelRehashMinimum) {
+			return insertBatch(keys, values, n);
+		}
+
+		u32* offsets = reinterpret_cast<u32*>(HALLOCATOR_MALLOC(allocator_, sizeof(u32) * (threads * 3 + 1)));
+		u32* placed = offsets + threads + 1;
+		u32* deferred = placed + threads;
+		u64* entries = hash_detail::partitionByRegion(allocator_, threads, n, n,
+			[](size_type) { return true; },
+			[this, keys](size_type i) { return static_cast<u32>(calcHash_(keys[i])); },
+			capacity_, [this](u32 hash) { return probeStart(hash); }, offsets);
+		hash_detail::parallelFor(threads, [&](u32 r) {
+			size_type end = hash_detail::regionBegin(r + 1, threads, capacity_);
+			size_type rest = offsets[r];
+			placed[r] = 0;
+			for (size_type i = offsets[r]; i < offsets[r + 1]; ++i) {
+				size_type src = static_cast<u32>(entries[i]);
+				switch (placeBefore_<false>(static_cast<u32>(entries[i] >> 32), end, keys[src], values[src])) {
+				case hash_detail::Placement::Placed:
+					++placed[r];
+					break;
+				case hash_detail::Placement::Deferred:
+					entries[rest++] = entries[i];
+					break;
+				default:
+					break;
+				}
+			}
+			deferred[r] = rest;
+		});
+		for (u32 r = 0; r < threads; ++r) {
+			size_ += placed[r];
+		}
+		//Deferred entries are checked against the whole table, since an equal key may have been placed before
+		for (u32 r = 0; r < threads; ++r) {
+			for (size_type i = offsets[r]; i < deferred[r]; ++i) {
+				size_type src = static_cast<u32>(entries[i]);
+				tryInsert_(static_cast<u32>(entries[i] >> 32), keys[src], values[src]);
+			}
+		}
+		HALLOCATOR_FREE(allocator_, entries);
+		HALLOCATOR_FREE(allocator_, offsets);
+		return size_;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	template<class KeyArg, class... Args>
+	bool SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::tryInsert_(size_type hash, KeyArg&& key, Args&&... args)
+	{
+		size_type pos = end();
+		if (0 < capacity_ && findOrInsertPos_(key, hash, pos) != end()) {
+			return false;
+		}
+		//A tombstone is reused without spending the growth budget. Growth or rehash moves slots, so only then is the position searched again
+		if (end() == pos || (controls_[pos].isEmpty() && growthLimit() <= (size_ + deleted_))) {
+			prepareInsert_();
+			pos = findInsertPos_(hash);
+		}
+		HASSERT(size_<capacity_);
+		HASSERT(pos < capacity_);
+		deleted_ -= controls_[pos].isDeleted() ? 1 : 0;
+		setControl(pos, h2(hash));
+		setHash(pos, hash);
+		HPLACEMENT_NEW(&slots_.key(pos)) key_type(std::forward<KeyArg>(key));
+		HPLACEMENT_NEW(&slots_.value(pos)) value_type(std::forward<Args>(args)...);
+		++size_;
+		return true;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::erase(const_key_param_type key)
+	{
+		u32 pos = find(key);
+		if(pos == end()){
+			return;
+		}
+		eraseAt(pos);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	template<class K, hash_detail::transparent_t<Key, K>>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::find(const K& key) const
+	{
+		return (0 < capacity_) ? find_(key, calcHash_(key)) : end();
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	template<class K, hash_detail::transparent_t<Key, K>>
+	bool SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::insert(const K& key, const_value_param_type value)
+	{
+		return tryInsert_(calcHash_(key), key, value);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	template<class K, hash_detail::transparent_t<Key, K>>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::erase(const K& key)
+	{
+		size_type pos = find(key);
+		if (pos != end()) {
+			eraseAt(pos);
+		}
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::eraseAt(size_type pos)
+	{
+		HASSERT(0<size_);
+		HASSERT(pos<capacity_);
+		HASSERT(controls_[pos].isOccupied());
+		slots_.key(pos).~key_type();
+		slots_.value(pos).~value_type();
+		if (wasNeverFull(pos)) {
+			setControl(pos, Control::Empty);
+		} else {
+			setControl(pos, Control::Deleted);
+			++deleted_;
+		}
+		--size_;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::moveAt(size_type pos, this_type& dst)
+	{
+		HASSERT(pos<capacity_);
+		u32 hash = hashAt(pos);
+		dst.prepareInsert_();
+		dst.insert_(hash, std::move(slots_.key(pos)), std::move(slots_.value(pos)));
+		eraseAt(pos);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	const typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::memory_allocator& SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::getAllocator() const
+	{
+		return allocator_;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::setResizeObserver(ResizeObserver observer, void* user)
+	{
+		observer_ = observer;
+		observerUser_ = user;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::roundCapacity(size_type capacity)
+	{
+		return index_policy::roundCapacity((capacity < Block) ? Block : capacity);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::available() const
+	{
+		size_type limit = growthLimit();
+		return ((size_ + deleted_) < limit) ? limit - size_ - deleted_ : 0;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::swap(this_type& rhs)
+	{
+		(std::swap)(capacity_, rhs.capacity_);
+		(std::swap)(index_, rhs.index_);
+		(std::swap)(size_, rhs.size_);
+		(std::swap)(deleted_, rhs.deleted_);
+		(std::swap)(controls_, rhs.controls_);
+		(std::swap)(hashes_, rhs.hashes_);
+		slots_.swap(rhs.slots_);
+		(std::swap)(allocator_, rhs.allocator_);
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::iterator SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::begin() const
+	{
+		for(u32 i=0; i<capacity_; ++i){
+			if(controls_[i].isOccupied()){
 				return i;
 			}
-#else
-			if (key == keys_[i]) {
+		}
+		return end();
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::iterator SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::end() const
+	{
+		return Invalid;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::iterator SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::next(iterator pos) const
+	{
+		for(u32 i=pos+1; i<capacity_; ++i){
+			if(controls_[i].isOccupied()){
 				return i;
 			}
-#endif
 		}
 		return end();
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	bool HashMap<Key, Value, MemoryAllocator>::insert(const_key_param_type key, const_value_param_type value)
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::reference SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::getValue(size_type pos)
 	{
-		size_type hash = calcHash_(key);
-		if (0 < capacity_ && find_(key, hash) != end()) {
-			return false;
-		}
-
-		s32 entryPos;
-		if (freeList_ < 0) {
-			for (;;) {
-				entryPos = (empty_ < static_cast<s32>(capacity_)) ? empty_++ : -1;
-				if (0 <= entryPos) {
-					break;
-				}
-				expand();
-			}
-		}
-		else {
-			entryPos = freeList_;
-			freeList_ = buckets_[freeList_].next_;
-		}
-
-		s32 bucketPos = hash % capacity_;
-		buckets_[entryPos].next_ = (buckets_[bucketPos].index_ < 0) ? -1 : buckets_[bucketPos].index_;
-		buckets_[bucketPos].index_ = entryPos;
-		buckets_[entryPos].hash_ = hash | bucket_type::OccupyFlag;
-		construct(&keys_[entryPos], key);
-		construct(&values_[entryPos], value);
-		++size_;
-		return true;
+		HASSERT(0 <= pos && pos < capacity_);
+		return slots_.value(pos);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void HashMap<Key, Value, MemoryAllocator>::erase(const_key_param_type key)
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::const_reference SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::getValue(size_type pos) const
 	{
-		if (capacity_ <= 0) {
-			return;
-		}
-		u32 rawHash = calcHash_(key);
-		size_type pos = find_(key, rawHash);
-		if (!valid(pos) || !buckets_[pos].isOccupy()) {
-			return;
-		}
-		erase_(pos, rawHash);
+		HASSERT(0 <= pos && pos < capacity_);
+		return slots_.value(pos);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void HashMap<Key, Value, MemoryAllocator>::eraseAt(size_type pos)
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::key_reference SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::getKey(size_type pos)
 	{
-		if (capacity_ <= 0) {
-			return;
-		}
-		if (!valid(pos) || !buckets_[pos].isOccupy()) {
-			return;
-		}
-		u32 rawHash = calcHash_(getKey(pos));
-		erase_(pos, rawHash);
+		HASSERT(0 <= pos && pos < capacity_);
+		return slots_.key(pos);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void HashMap<Key, Value, MemoryAllocator>::erase_(size_type pos, u32 rawHash)
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::const_key_reference SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::getKey(size_type pos) const
 	{
-		s32 bucketPos = rawHash % capacity_;
-
-		keys_[pos].~key_type();
-		values_[pos].~value_type();
-
-		s32 spos = static_cast<s32>(pos);
-		if (spos == buckets_[bucketPos].index_) {
-			buckets_[bucketPos].index_ = buckets_[pos].next_;
-		}
-		else {
-			s32 p;
-			for (p = buckets_[bucketPos].index_; buckets_[p].next_ != spos; p = buckets_[p].next_) {
-#if _DEBUG
-				if (buckets_[p].next_ < 0) {
-					HASSERT(false);
-				}
-#endif
-			}
-			buckets_[p].next_ = buckets_[pos].next_;
-		}
-		buckets_[pos].next_ = freeList_;
-		freeList_ = pos;
-		buckets_[pos].clear();
-		--size_;
+		HASSERT(0 <= pos && pos < capacity_);
+		return slots_.key(pos);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void HashMap<Key, Value, MemoryAllocator>::swap(this_type& rhs)
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	template<class K>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::calcHash_(const K& key) const
 	{
-		hashmap::swap(capacity_, rhs.capacity_);
-		hashmap::swap(size_, rhs.size_);
-		hashmap::swap(empty_, rhs.empty_);
-		hashmap::swap(freeList_, rhs.freeList_);
-		hashmap::swap(buckets_, rhs.buckets_);
-		hashmap::swap(keys_, rhs.keys_);
-		hashmap::swap(values_, rhs.values_);
+		return hash_detail::calcHash(key);
 	}
 
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	inline typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::align(size_type x, size_type mask)
+	{
+		return (x + mask) & (~mask);
+	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	typename HashMap<Key, Value, MemoryAllocator>::iterator
-		HashMap<Key, Value, MemoryAllocator>::begin() const
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::expand(size_type capacity)
 	{
+		HCOUNT_RESIZE();
+		hash_detail::ResizeNotifier notifier(observer_, observerUser_, capacity_, roundCapacity(capacity), size_);
+		this_type tmp(allocator_);
+		tmp.create(capacity);
+
+		if (1 < threads_ && hash_detail::ParallelRehashMinimum <= size_) {
+			expandParallel_(tmp);
+			tmp.swap(*this);
+			return;
+		}
 		for (size_type i = 0; i < capacity_; ++i) {
-			if (buckets_[i].isOccupy()) {
-				return i;
+			if (controls_[i].isOccupied()) {
+				tmp.insert_(hashAt(i), std::move(slots_.key(i)), std::move(slots_.value(i)));
 			}
 		}
-		return end();
+		tmp.swap(*this);
 	}
 
-
-	template<class Key, class Value, class MemoryAllocator>
-	typename HashMap<Key, Value, MemoryAllocator>::iterator
-		HashMap<Key, Value, MemoryAllocator>::next(iterator pos) const
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::expandParallel_(this_type& dst)
 	{
-		for (size_type i = pos + 1; i < capacity_; ++i) {
-			if (buckets_[i].isOccupy()) {
-				return i;
+		u32* offsets = reinterpret_cast<u32*>(HALLOCATOR_MALLOC(allocator_, sizeof(u32) * (threads_ * 3 + 1)));
+		u32* placed = offsets + threads_ + 1;
+		u32* deferred = placed + threads_;
+		u64* entries = hash_detail::partitionByRegion(allocator_, threads_, capacity_, size_,
+			[this](size_type i) { return controls_[i].isOccupied(); },
+			[this](size_type i) { return hashAt(i); },
+			dst.capacity_, [&dst](u32 hash) { return dst.probeStart(hash); }, offsets);
+		hash_detail::parallelFor(threads_, [&](u32 r) {
+			size_type end = hash_detail::regionBegin(r + 1, threads_, dst.capacity_);
+			size_type rest = offsets[r];
+			placed[r] = 0;
+			for (size_type i = offsets[r]; i < offsets[r + 1]; ++i) {
+				size_type src = static_cast<u32>(entries[i]);
+				if (hash_detail::Placement::Placed == dst.template placeBefore_<true>(static_cast<u32>(entries[i] >> 32), end, std::move(slots_.key(src)), std::move(slots_.value(src)))) {
+					++placed[r];
+				} else {
+					entries[rest++] = entries[i];
+				}
 			}
+			deferred[r] = rest;
+		});
+		for (u32 r = 0; r < threads_; ++r) {
+			dst.size_ += placed[r];
 		}
-		return end();
+		//Probes which would cross the end of a region are placed serially
+		for (u32 r = 0; r < threads_; ++r) {
+			for (size_type i = offsets[r]; i < deferred[r]; ++i) {
+				size_type src = static_cast<u32>(entries[i]);
+				dst.insert_(static_cast<u32>(entries[i] >> 32), std::move(slots_.key(src)), std::move(slots_.value(src)));
+			}
+		}
+		HALLOCATOR_FREE(allocator_, entries);
+		HALLOCATOR_FREE(allocator_, offsets);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void HashMap<Key, Value, MemoryAllocator>::expand()
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	template<bool Unique, class KeyArg, class ValueArg>
+	hash_detail::Placement SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::placeBefore_(u32 hash, size_type end, KeyArg&& key, ValueArg&& value)
 	{
-		this_type tmp;
-		tmp.create(capacity_ + 1);
-
-
-		for (size_type i = 0; i < capacity_; ++i) {
-			if (buckets_[i].isOccupy()) {
-#if _DEBUG
-				if (false == tmp.insert(keys_[i], values_[i])) {
-					HASSERT(false);
+		for (size_type pos = probeStart(hash); pos + Block <= end; pos += Block) {
+			group_type group(reinterpret_cast<const u8*>(controls_ + pos));
+			if constexpr (!Unique) {
+				for (u32 i = group.match(h2(hash)); i; i = next_pos(i)) {
+					if (equal(pos + leastSignificantBit(i), hash, key)) {
+						return hash_detail::Placement::Exists;
+					}
 				}
-#else
-				tmp.insert(keys_[i], values_[i]);
-#endif
+			}
+			u32 mask = group.matchEmptyOrDeleted();
+			if (0 != mask) {
+				size_type p = pos + leastSignificantBit(mask);
+				setControl(p, h2(hash));
+				setHash(p, hash);
+				construct(&slots_.key(p), std::forward<KeyArg>(key));
+				construct(&slots_.value(p), std::forward<ValueArg>(value));
+				return hash_detail::Placement::Placed;
 			}
 		}
-		tmp.swap(*this);
+		return hash_detail::Placement::Deferred;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void HashMap<Key, Value, MemoryAllocator>::create(size_type capacity)
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::setRehashThreads(u32 threads)
 	{
-		HASSERT(NULL == buckets_);
-		HASSERT(NULL == keys_);
-		HASSERT(NULL == values_);
+		threads_ = (0 < threads) ? threads : 1;
+	}
 
-		capacity_ = hash_detail::next_prime(capacity);
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	u32 SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::getRehashThreads() const
+	{
+		return threads_;
+	}
 
-		size_type size_buckets = align(sizeof(bucket_type) * capacity_);
-		size_type size_keys = align(sizeof(key_type) * capacity_);
-		size_type size_values = sizeof(value_type) * capacity_;
-		size_type total_size = size_buckets + size_keys + size_values;
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	bool SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::saveImage(const char* path) const
+	{
+		static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value, "An image needs trivially copyable keys and values");
+		u64 bytes = (0 < capacity_) ? bytes_(capacity_) : 0;
+		return hash_detail::writeImage(path, ImageKind, index_policy::Id, growth_policy::Id, sizeof(Key), sizeof(Value), capacity_, size_, controls_, bytes);
+	}
 
-		u8* mem = reinterpret_cast<u8*>(HALLOCATOR_MALLOC(memory_allocator, total_size));
-		buckets_ = reinterpret_cast<bucket_type*>(mem);
-		keys_ = reinterpret_cast<key_pointer>(mem + size_buckets);
-		values_ = reinterpret_cast<value_pointer>(mem + size_buckets + size_keys);
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	inline u32 SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::h1(u32 hash)
+	{
+		return hash >> 7;
+	}
 
-		for (size_type i = 0; i < capacity_; ++i) {
-			buckets_[i].index_ = -1;
-			buckets_[i].next_ = -1;
-			buckets_[i].clear();
-		}
-		size_ = 0;
-		empty_ = 0;
-		freeList_ = -1;
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	inline u8 SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::h2(u32 hash)
+	{
+		return static_cast<u8>(hash & 0x7FUL);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void HashMap<Key, Value, MemoryAllocator>::destroy()
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	inline typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::probeStart(u32 hash) const
 	{
-		clear();
-		capacity_ = 0;
-		HALLOCATOR_FREE(memory_allocator, buckets_);
-		keys_ = NULL;
-		values_ = NULL;
+		return index_.index(h1(hash));
 	}
 
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	inline typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::probeIndex(size_type start, size_type pos) const
+	{
+		return ((start <= pos) ? pos - start : capacity_ - start + pos) / Block;
+	}
 
-	//-----------------------------------------------------------------------------
-	//---
-	//--- HopscotchHashMap
-	//---
-	//-----------------------------------------------------------------------------
-	template<typename BitmapType>
-	struct HashMapHopInfo
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	inline typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::probeCount() const
 	{
-		typedef u32 size_type;
-		typedef BitmapType bitmap_type;
-		static const size_type bitmap_size = sizeof(bitmap_type);
-		static const size_type bitmap_count = bitmap_size * 8 - 1;
+		return (capacity_ + BlockMask) / Block;
+	}
 
-		bool isEmpty() const
-		{
-			return (0 == (hop_ & 0x01U));
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	inline typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::wrap(size_type pos) const
+	{
+		HASSERT(pos < (capacity_ << 1));
+		if constexpr (index_policy::PowerOfTwo) {
+			return pos & (capacity_ - 1);
+		} else {
+			return (pos < capacity_) ? pos : pos - capacity_;
 		}
+	}
 
-		void setEmpty()
-		{
-			hop_ &= ~0x01U;
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	inline u32 SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::hashAt(size_type pos) const
+	{
+		if constexpr (StoreHash) {
+			return hashes_[pos];
+		} else {
+			return calcHash_(slots_.key(pos));
 		}
+	}
 
-		bool isOccupy() const
-		{
-			return (0 != (hop_ & 0x01U));
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	inline void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::setHash(size_type pos, u32 hash)
+	{
+		if constexpr (StoreHash) {
+			hashes_[pos] = hash;
 		}
+	}
 
-		void setOccupy()
-		{
-			hop_ |= 0x01U;
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	template<class K>
+	inline bool SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::equal(size_type pos, u32 hash, const K& key) const
+	{
+		if constexpr (StoreHash) {
+			if (hashes_[pos] != hash) {
+				return false;
+			}
 		}
+		HCOUNT(compares_, 1);
+		return key == slots_.key(pos);
+	}
 
-		bitmap_type getHop() const
-		{
-			return (hop_ >> 1);
-		}
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	inline typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::growthLimit() const
+	{
+		//Keep an eighth of slots empty under any policy, or a miss would scan every group
+		size_type limit = growth_policy::maxSize(capacity_);
+		size_type cap = capacity_ - (capacity_ >> 3);
+		return (limit < cap) ? limit : cap;
+	}
 
-		void setHop(bitmap_type hop)
-		{
-			hop_ = (hop << 1) | (hop_ & 0x01U);
-		}
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::capacityFor(size_type size)
+	{
+		//capacity - capacity/8 is at least size for size + size/7 + 1
+		size_type capacity = growth_policy::capacityFor(size);
+		size_type least = size + size / 7 + 1;
+		return (capacity < least) ? least : capacity;
+	}
 
-		void setHopFlag(size_type pos)
-		{
-			hop_ |= (0x01U << (pos + 1));
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	inline bool SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::wasNeverFull(size_type pos) const
+	{
+		//A probe passes the slot, only if a run of non-empty slots around it covers a group
+		size_type before = (Block <= pos) ? pos - Block : capacity_ + pos - Block;
+		u32 emptyAfter = group_type(reinterpret_cast<const u8*>(controls_ + pos)).match(Control::Empty);
+		u32 emptyBefore = group_type(reinterpret_cast<const u8*>(controls_ + before)).match(Control::Empty);
+		if (0 == emptyAfter || 0 == emptyBefore) {
+			return false;
 		}
+		return (leastSignificantBit(emptyAfter) + (BlockMask - mostSignificantBit(emptyBefore))) < Block;
+	}
 
-		void clearHopFlag(size_type pos)
-		{
-			hop_ &= ~(0x01U << (pos + 1));
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	inline void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::setControl(size_type pos, u8 control)
+	{
+		HASSERT(pos < capacity_);
+		controls_[pos].control_ = control;
+		//Mirror the first group after the end, so that a group can be loaded at any position
+		if (pos < Block) {
+			controls_[capacity_ + pos].control_ = control;
 		}
+	}
 
-		bool checkHopFlag(size_type pos) const
-		{
-			return 0 != (hop_ & (0x01U << (pos + 1)));
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::prepareInsert_()
+	{
+		if ((size_ + deleted_) < growthLimit()) {
+			return;
 		}
-
-		void clear()
-		{
-			hop_ = 0;
+		//Reclaim tombstones without reallocation, if they occupy a quarter of the load
+		if (0 < deleted_ && (growthLimit() >> 2) <= deleted_) {
+			rehashInPlace_();
+		} else {
+			expand(growth_policy::nextCapacity(capacity_));
 		}
+	}
 
-		bitmap_type hop_;
-	};
-
-	template<class Key, class Value, typename BitmapType = u32, class MemoryAllocator = DefaultAllocator>
-	class HopscotchHashMap
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::reserve_(size_type n)
 	{
-	public:
-		static const u32 Align = 4;
-		static const u32 AlignMask = Align - 1;
-
-		typedef HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator> this_type;
-
-		typedef Key key_type;
-		typedef Value value_type;
-		typedef HashMapHopInfo<BitmapType> hopinfo_type;
-		typedef MemoryAllocator memory_allocator;
-
-		typedef u32 size_type;
-		typedef size_type iterator;
-
-		typedef hash_detail::type_traits<value_type> value_traits;
-		typedef typename value_traits::pointer value_pointer;
-		typedef typename value_traits::const_pointer const_value_pointer;
-		typedef typename value_traits::reference value_reference;
-		typedef typename value_traits::const_reference const_value_reference;
-		typedef typename value_traits::pointer pointer;
-		typedef typename value_traits::const_pointer const_pointer;
-		typedef typename value_traits::reference reference;
-		typedef typename value_traits::const_reference const_reference;
-		typedef typename value_traits::param_type value_param_type;
-		typedef typename value_traits::const_param_type const_value_param_type;
-
-
-		typedef hash_detail::type_traits<key_type> key_traits;
-		typedef typename key_traits::pointer key_pointer;
-		typedef typename key_traits::const_pointer const_key_pointer;
-		typedef typename key_traits::reference key_reference;
-		typedef typename key_traits::const_reference const_key_reference;
-		typedef typename key_traits::param_type key_param_type;
-		typedef typename key_traits::const_param_type const_key_param_type;
-
-		typedef hopinfo_type* hopinfo_pointer;
-		typedef const hopinfo_type* const_hopinfo_pointer;
-		typedef typename hopinfo_type::bitmap_type bitmap_type;
-
-		static const size_type bitmap_size = hopinfo_type::bitmap_size;
-		static const size_type bitmap_count = hopinfo_type::bitmap_count;
-
-		static const size_type InsertRange = 8 * bitmap_count;
-
-		HopscotchHashMap();
-		explicit HopscotchHashMap(size_type capacity);
-		~HopscotchHashMap();
+		if (growthLimit() < size_ + deleted_ + n) {
+			size_type capacity = capacityFor(size_ + n);
+			expand((capacity_ < capacity) ? capacity : capacity_);
+		}
+	}
 
-		void initialize(size_type capacity)
-		{
-			destroy();
-			create(capacity);
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::rehashInPlace_()
+	{
+		hash_detail::ResizeNotifier notifier(observer_, observerUser_, capacity_, capacity_, size_);
+		//Mark deleted slots as empty, and full slots as deleted which means "not placed yet"
+		for (size_type i = 0; i < capacity_; ++i) {
+			controls_[i].control_ = controls_[i].isOccupied() ? Control::Deleted : Control::Empty;
 		}
+		::memcpy(controls_ + capacity_, controls_, sizeof(Control) * Block);
 
-		size_type capacity() const
-		{
-			return capacity_;
+		for (size_type i = 0; i < capacity_;) {
+			if (!controls_[i].isDeleted()) {
+				++i;
+				continue;
+			}
+			u32 hash = hashAt(i);
+			size_type start = probeStart(hash);
+			size_type pos = findInsertPos_(hash);
+			HASSERT(pos < capacity_);
+			if (probeIndex(start, pos) == probeIndex(start, i)) {
+				//Already in the best group
+				setControl(i, h2(hash));
+				++i;
+				continue;
+			}
+			if (controls_[pos].isEmpty()) {
+				setControl(pos, h2(hash));
+				setHash(pos, hash);
+				construct(&slots_.key(pos), std::move(slots_.key(i)));
+				construct(&slots_.value(pos), std::move(slots_.value(i)));
+				slots_.key(i).~key_type();
+				slots_.value(i).~value_type();
+				setControl(i, Control::Empty);
+				++i;
+			} else {
+				//Swap with the element not placed yet, then process the slot again
+				setControl(pos, h2(hash));
+				if constexpr (StoreHash) {
+					hashmap::swap(hashes_[i], hashes_[pos]);
+				}
+				hashmap::swap(slots_.key(i), slots_.key(pos));
+				hashmap::swap(slots_.value(i), slots_.value(pos));
+			}
 		}
+		deleted_ = 0;
+	}
 
-		size_type size() const
-		{
-			return size_;
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	template<class K>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::find_(const K& key, size_type hash) const
+	{
+		u8 h = h2(hash);
+		u32 pos = probeStart(hash);
+		for (u32 n = probeCount(); 0 < n; --n) {
+			HCOUNT(probes_, 1);
+			group_type group(reinterpret_cast<const u8*>(controls_ + pos));
+			for (u32 i = group.match(h); i; i = next_pos(i)) {
+				u32 p = wrap(pos + leastSignificantBit(i));
+				if (equal(p, hash, key)) {
+					return p;
+				}
+				HCOUNT(falseMatches_, 1);
+			}
+			//The key would have been placed in this group, if the group has an empty slot
+			if (0 != group.match(Control::Empty)) {
+				break;
+			}
+			pos = wrap(pos + Block);
 		}
+		return end();
+	}
 
-		void clear();
-
-		bool valid(size_type pos) const
-		{
-			return (pos < capacity_);
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	template<class K>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::findOrInsertPos_(const K& key, size_type hash, size_type& insertPos) const
+	{
+		u8 h = h2(hash);
+		u32 pos = probeStart(hash);
+		insertPos = end();
+		for (u32 n = probeCount(); 0 < n; --n) {
+			HCOUNT(probes_, 1);
+			group_type group(reinterpret_cast<const u8*>(controls_ + pos));
+			for (u32 i = group.match(h); i; i = next_pos(i)) {
+				u32 p = wrap(pos + leastSignificantBit(i));
+				if (equal(p, hash, key)) {
+					return p;
+				}
+				HCOUNT(falseMatches_, 1);
+			}
+			//The same slot as findInsertPos_, which stops at the first group with an empty or deleted slot
+			u32 free = group.matchEmptyOrDeleted();
+			if (end() == insertPos && 0 != free) {
+				insertPos = wrap(pos + leastSignificantBit(free));
+			}
+			if (0 != group.match(Control::Empty)) {
+				break;
+			}
+			pos = wrap(pos + Block);
 		}
+		return end();
+	}
 
-		size_type find(const_key_param_type key) const
-		{
-			return (0 < capacity_) ? find_(key, calcHash_(key)) : end();
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::findInsertPos_(size_type hash) const
+	{
+		u32 pos = probeStart(hash);
+		for (u32 n = probeCount(); 0 < n; --n) {
+			HCOUNT(probes_, 1);
+			group_type group(reinterpret_cast<const u8*>(controls_ + pos));
+			u32 mask = group.matchEmptyOrDeleted();
+			if (0 != mask) {
+				return wrap(pos + leastSignificantBit(mask));
+			}
+			pos = wrap(pos + Block);
 		}
+		return end();
+	}
 
-		bool insert(const_key_param_type key, const_value_param_type value);
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::insert_(u32 hash, key_lvalue_type key, value_lvalue_type value)
+	{
+		HASSERT(find_(key, hash) == end());
+		HASSERT(size_ < capacity_);
+		u32 pos = findInsertPos_(hash);
+		HASSERT(pos < capacity_);
+		deleted_ -= controls_[pos].isDeleted() ? 1 : 0;
+		setControl(pos, h2(hash));
+		setHash(pos, hash);
+		construct(&slots_.key(pos), std::move(key));
+		construct(&slots_.value(pos), std::move(value));
+		++size_;
+	}
 
-		void erase(const_key_param_type key);
-		void eraseAt(size_type pos);
-		void swap(this_type& rhs);
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::create(size_type capacity)
+	{
+		HASSERT(capacity_ <= 0);
+		HASSERT(size_ <= 0);
+		HASSERT(nullptr == controls_);
+		HASSERT(nullptr == slots_.data());
+		//Controls have a copy of the first group at the end
+		capacity = roundCapacity(capacity);
+		u64 total_size = bytes_(capacity);
+		u8* memory = reinterpret_cast<u8*>(HALLOCATOR_MALLOC(allocator_, total_size));
+		::memset(memory, 0, total_size);
+		bind_(memory, capacity);
+		::memset(controls_, Control::Empty, align((capacity + Block) * sizeof(Control), AlignMask));
+	}
 
-		iterator begin() const;
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	u64 SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::bytes_(size_type capacity)
+	{
+		u64 size_controls = align((capacity + Block) * sizeof(Control), AlignMask);
+		u64 size_hashes = StoreHash ? align(capacity * sizeof(u32), AlignMask) : 0;
+		return size_controls + size_hashes + slots_type::bytes(capacity);
+	}
 
-		iterator end() const
-		{
-			return capacity_;
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::bind_(u8* memory, size_type capacity)
+	{
+		u64 size_controls = align((capacity + Block) * sizeof(Control), AlignMask);
+		u64 size_hashes = StoreHash ? align(capacity * sizeof(u32), AlignMask) : 0;
+		index_.reset(capacity);
+		controls_ = reinterpret_cast<Control*>(memory);
+		hashes_ = StoreHash ? reinterpret_cast<u32*>(memory + size_controls) : nullptr;
+		slots_.bind(memory + size_controls + size_hashes, capacity);
+		capacity_ = capacity;
+	}
+
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	bool SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::bindImage_(const u8* memory, u64 bytes, size_type capacity, size_type size)
+	{
+		HASSERT(nullptr == controls_);
+		if (capacity <= 0) {
+			return bytes <= 0 && size <= 0;
+		}
+		if (capacity < Block || index_policy::roundCapacity(capacity) != capacity || bytes_(capacity) != bytes || capacity < size) {
+			return false;
 		}
+		bind_(const_cast<u8*>(memory), capacity);
+		size_ = size;
+		return true;
+	}
 
-		iterator next(iterator pos) const;
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::unbindImage_()
+	{
+		capacity_ = 0;
+		size_ = 0;
+		deleted_ = 0;
+		controls_ = nullptr;
+		hashes_ = nullptr;
+		slots_.reset();
+	}
 
-		reference getValue(size_type pos)
-		{
-			HASSERT(0 <= pos && pos < capacity_);
-			return values_[pos];
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::destroy()
+	{
+		for (u32 i = 0; i < capacity_; ++i) {
+			if (controls_[i].isOccupied()) {
+				slots_.value(i).~value_type();
+				slots_.key(i).~key_type();
+			}
 		}
+		HALLOCATOR_FREE(allocator_, controls_);
+		capacity_ = 0;
+		size_ = 0;
+		deleted_ = 0;
+		controls_ = nullptr;
+		hashes_ = nullptr;
+		slots_.reset();
+	}
 
-		const_reference getValue(size_type pos) const
-		{
-			HASSERT(0 <= pos && pos < capacity_);
-			return values_[pos];
-		}
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	u32 SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::leastSignificantBit(u32 x)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		return _BitScanForward(&index, x) ? (u32)index : 0;
 
-		key_reference getKey(size_type pos)
-		{
-			HASSERT(0 <= pos && pos < capacity_);
-			return keys_[pos];
+#elif defined(__GNUC__)
+		return (0 != x) ? (__builtin_ctzl(x)) : 0;
+#else
+		if (0 == v) {
+			return 0U;
 		}
+		u32 count = (x & 0xAAAAAAAAUL) ? 0x01UL : 0;
 
-		const_key_reference getKey(size_type pos) const
-		{
-			HASSERT(0 <= pos && pos < capacity_);
-			return keys_[pos];
+		if (x & 0xCCCCCCCCU) {
+			count |= 0x02UL;
 		}
-	private:
-		HopscotchHashMap(const HopscotchHashMap&) = delete;
-		HopscotchHashMap& operator=(const HopscotchHashMap&) = delete;
 
-		bool isEmpty(size_type pos) const
-		{
-			return hopinfoes_[pos].isEmpty();
+		if (x & 0xF0F0F0F0U) {
+			count |= 0x04UL;
 		}
 
-		bool isOccupy(size_type pos) const
-		{
-			return hopinfoes_[pos].isOccupy();
+		if (x & 0xFF00FF00U) {
+			count |= 0x08UL;
 		}
 
-		inline static size_type calcHash_(const_key_param_type key)
-		{
-			return hash_detail::calcHash(key);
-		}
+		return 31UL - ((x & 0xFFFF0000UL) ? count | 0x10UL : count);
+#endif
+	}
 
-		inline size_type hashToPos_(size_type hash) const
-		{
-			return hash % capacity_;
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	u32 SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::mostSignificantBit(u32 x)
+	{
+		HASSERT(0 != x);
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanReverse(&index, x);
+		return static_cast<u32>(index);
+#elif defined(__GNUC__)
+		return 31 - __builtin_clz(x);
+#else
+		u32 index = 0;
+		while (x >>= 1) {
+			++index;
 		}
+		return index;
+#endif
+	}
 
-		static inline size_type align_(size_type x)
-		{
-			return (x + AlignMask) & (~AlignMask);
-		}
+	template<class Key, class Value, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	u32 SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::next_pos(u32 x)
+	{
+		return x & (x - 1);
+	}
 
-		inline size_type clamp_(size_type x) const
+	//-----------------------------------------------------------------------------
+	//---
+	//--- IncrementalResize
+	//---
+	//-----------------------------------------------------------------------------
+	/**
+	@brief Spreads the growth of a table over subsequent operations
+
+	When Table reaches its maximum load, a new table of the next capacity is created and the old one is kept.
+	The new table is made large enough that the old one drains before it reaches its own maximum load.
+	Each insertion or erasure then moves up to StepSize entries from the old table to the new one,
+	and lookups consult both tables until the old one is drained.
+	Tables can still grow by themselves, such as on an overflowed neighborhood of Hopscotch,
+	or on a probe beyond the maximum distance of Robin Hood, which usually comes before the maximum load.
+	@tparam Table ... one of the tables in this file
+	@tparam StepSize ... maximum number of entries moved per operation
+	*/
+	template<class Table, u32 StepSize = 8>
+	class IncrementalResize
+	{
+	public:
+		static_assert(0 < StepSize, "StepSize should be greater than 0");
+
+		typedef Table table_type;
+		typedef typename Table::key_type key_type;
+		typedef typename Table::value_type value_type;
+		typedef typename Table::memory_allocator memory_allocator;
+		typedef typename Table::growth_policy growth_policy;
+		typedef typename Table::size_type size_type;
+		typedef typename Table::const_key_param_type const_key_param_type;
+		typedef typename Table::const_value_param_type const_value_param_type;
+		typedef typename Table::const_key_reference const_key_reference;
+		typedef typename Table::reference reference;
+		typedef typename Table::const_reference const_reference;
+		typedef IncrementalResize<Table, StepSize> this_type;
+
+		/**
+		@brief Position of an entry in either table
+		*/
+		struct iterator
 		{
-			return (x < capacity_) ? x : x - capacity_;
-		}
+			bool operator==(const iterator& x) const
+			{
+				return old_ == x.old_ && pos_ == x.pos_;
+			}
 
-		void moveEmpty(size_type& pos, size_type& distance);
-		void expand();
+			bool operator!=(const iterator& x) const
+			{
+				return old_ != x.old_ || pos_ != x.pos_;
+			}
 
-		size_type find_(const_key_param_type key, size_type hash) const;
-		bool insert_(const_key_param_type key, const_value_param_type value, size_type hash);
+			bool old_;
+			typename Table::iterator pos_;
+		};
 
-		void create(size_type capacity);
-		void destroy();
+		IncrementalResize();
+		/**
+		@param allocator ... shared by the current and the old tables
+		*/
+		explicit IncrementalResize(const memory_allocator& allocator);
+		~IncrementalResize();
 
-		size_type capacity_;
-		size_type size_;
+		size_type capacity() const;
+		size_type size() const;
+		/**
+		@brief Sum of the current and the old tables
+		*/
+		TableStats stats() const;
+		void clear();
 
-		hopinfo_pointer hopinfoes_;
-		key_pointer keys_;
-		value_pointer values_;
-	};
+		/**
+		@brief Whether entries are still being moved from an old table
+		*/
+		bool migrating() const;
+		/**
+		@brief Sets a function called when a full table is swapped for a new one, and on resizes of either table
 
-	template<class Key, class Value, typename BitmapType, class MemoryAllocator>
-	HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::HopscotchHashMap()
-		:capacity_(0)
-		, size_(0)
-		, hopinfoes_(NULL)
-		, keys_(NULL)
-		, values_(NULL)
-	{}
+		Events do not nest, the swap is reported alone and entries move in later operations, so that its moved_ is 0.
+		*/
+		void setResizeObserver(ResizeObserver observer, void* user);
 
-	template<class Key, class Value, typename BitmapType, class MemoryAllocator>
-	HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::HopscotchHashMap(size_type capacity)
-		:size_(0)
-		, hopinfoes_(NULL)
-		, keys_(NULL)
-		, values_(NULL)
+		iterator find(const_key_param_type key) const;
+		bool insert(const_key_param_type key, const_value_param_type value);
+		bool insert(key_type&& key, value_type&& value);
+		void erase(const_key_param_type key);
+
+		iterator begin() const;
+		iterator next(iterator pos) const;
+		iterator end() const;
+
+		const_key_reference getKey(iterator pos) const;
+		const_reference getValue(iterator pos) const;
+		reference getValue(iterator pos);
+	private:
+		IncrementalResize(const this_type&) = delete;
+		this_type& operator=(const this_type&) = delete;
+
+		void prepareInsert_();
+		void migrate_(u32 count);
+
+		Table current_;
+		Table old_;
+		/// Entries before cursor_ in old_ have been moved
+		typename Table::iterator cursor_;
+		ResizeObserver observer_;
+		void* observerUser_;
+	};
+
+	template<class Table, u32 StepSize>
+	IncrementalResize<Table, StepSize>::IncrementalResize()
+		:cursor_(0)
+		, observer_(nullptr)
+		, observerUser_(nullptr)
 	{
-		create(capacity);
 	}
 
-	template<class Key, class Value, typename BitmapType, class MemoryAllocator>
-	HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::~HopscotchHashMap()
+	template<class Table, u32 StepSize>
+	IncrementalResize<Table, StepSize>::IncrementalResize(const memory_allocator& allocator)
+		:current_(allocator)
+		, old_(allocator)
+		, cursor_(0)
+		, observer_(nullptr)
+		, observerUser_(nullptr)
 	{
-		destroy();
 	}
 
-	template<class Key, class Value, typename BitmapType, class MemoryAllocator>
-	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::clear()
+	template<class Table, u32 StepSize>
+	IncrementalResize<Table, StepSize>::~IncrementalResize()
 	{
-		for (size_type i = 0; i < capacity_; ++i) {
-			if (isOccupy(i)) {
-				keys_[i].~key_type();
-				values_[i].~value_type();
-			}
-			hopinfoes_[i].clear();
-		}
-		size_ = 0;
 	}
 
-	template<class Key, class Value, typename BitmapType, class MemoryAllocator>
-	bool HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::insert(const_key_param_type key, const_value_param_type value)
+	template<class Table, u32 StepSize>
+	typename IncrementalResize<Table, StepSize>::size_type IncrementalResize<Table, StepSize>::capacity() const
 	{
-		if (capacity_ <= 0) {
-			expand();
-			return insert_(key, value, calcHash_(key));
-		}
-		size_type hash = calcHash_(key);
-		size_type pos = find_(key, hash);
-		if (pos != end()) {
-			return false;
-		}
-		return insert_(key, value, hash);
+		return current_.capacity();
 	}
 
-	template<class Key, class Value, typename BitmapType, class MemoryAllocator>
-	typename HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::size_type
-		HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::find_(const_key_param_type key, size_type hash) const
+	template<class Table, u32 StepSize>
+	typename IncrementalResize<Table, StepSize>::size_type IncrementalResize<Table, StepSize>::size() const
 	{
-		HASSERT(0 < capacity_);
-		size_type pos = hashToPos_(hash);
-		HASSERT(pos < capacity_);
-		bitmap_type info = hopinfoes_[pos].getHop();
+		return current_.size() + old_.size();
+	}
 
-		size_type d = 0;
-		while (0 != info) {
-			if (info & 0x01U) {
-				size_type p = clamp_(pos + d);
-				HASSERT(isOccupy(p));
-				if (keys_[p] == key) {
-					return p;
-				}
-			}
-			info >>= 1;
-			++d;
-		}
+	template<class Table, u32 StepSize>
+	TableStats IncrementalResize<Table, StepSize>::stats() const
+	{
+		TableStats stats = current_.stats();
+		stats.merge(old_.stats());
+		return stats;
+	}
 
-		return end();
+	template<class Table, u32 StepSize>
+	void IncrementalResize<Table, StepSize>::clear()
+	{
+		current_.clear();
+		Table empty;
+		old_.swap(empty);
+		cursor_ = 0;
 	}
 
-	template<class Key, class Value, typename BitmapType, class MemoryAllocator>
-	bool HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::insert_(const_key_param_type key, const_value_param_type value, size_type hash)
+	template<class Table, u32 StepSize>
+	bool IncrementalResize<Table, StepSize>::migrating() const
 	{
-		size_type startPos = hashToPos_(hash);
-		size_type pos;
-		size_type d;
-		for (;;) {
-			size_type range = (capacity_ < InsertRange) ? capacity_ : InsertRange;
-			d = 0;
-			pos = startPos;
-			do {
-				if (hopinfoes_[pos].isEmpty()) {
-					break;
-				}
-				pos = clamp_(pos + 1);
-				++d;
-			} while (d < range);
+		return 0 < old_.size();
+	}
 
-			if (range <= d) {
-				expand();
-				startPos = hashToPos_(hash);
-				continue;
-			}
+	template<class Table, u32 StepSize>
+	void IncrementalResize<Table, StepSize>::setResizeObserver(ResizeObserver observer, void* user)
+	{
+		observer_ = observer;
+		observerUser_ = user;
+		current_.setResizeObserver(observer, user);
+		old_.setResizeObserver(observer, user);
+	}
 
-			size_type size = (bitmap_count < capacity_) ? bitmap_count : capacity_;
-			while (size <= d) {
-				moveEmpty(pos, d);
-			}
-			if (end() == pos) {
-				expand();
-				startPos = hashToPos_(hash);
-				continue;
+	template<class Table, u32 StepSize>
+	typename IncrementalResize<Table, StepSize>::iterator IncrementalResize<Table, StepSize>::find(const_key_param_type key) const
+	{
+		typename Table::iterator pos = current_.find(key);
+		if (pos != current_.end()) {
+			return {false, pos};
+		}
+		if (migrating()) {
+			pos = old_.find(key);
+			if (pos != old_.end()) {
+				return {true, pos};
 			}
-			HASSERT(hopinfoes_[pos].isEmpty());
-			HASSERT(!hopinfoes_[startPos].checkHopFlag(d));
-			break;
 		}
+		return end();
+	}
+
+	template<class Table, u32 StepSize>
+	bool IncrementalResize<Table, StepSize>::insert(const_key_param_type key, const_value_param_type value)
+	{
+		//Migration can move the key from one table to the other, so look for it after that
+		prepareInsert_();
+		if (migrating() && old_.find(key) != old_.end()) {
+			return false;
+		}
+		return current_.insert(key, value);
+	}
 
-		hopinfoes_[pos].setOccupy();
-		construct(&keys_[pos], key);
-		construct(&values_[pos], value);
-		hopinfoes_[startPos].setHopFlag(d);
-		++size_;
-		return true;
+	template<class Table, u32 StepSize>
+	bool IncrementalResize<Table, StepSize>::insert(key_type&& key, value_type&& value)
+	{
+		//Migration can move the key from one table to the other, so look for it after that
+		prepareInsert_();
+		if (migrating() && old_.find(key) != old_.end()) {
+			return false;
+		}
+		return current_.insert(std::move(key), std::move(value));
 	}
 
-	template<class Key, class Value, typename BitmapType, class MemoryAllocator>
-	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::moveEmpty(size_type& pos, size_type& distance)
+	template<class Table, u32 StepSize>
+	void IncrementalResize<Table, StepSize>::erase(const_key_param_type key)
 	{
-		size_type size = (bitmap_count < capacity_) ? bitmap_count : capacity_;
-		size_type offset = size - 1;
-		size_type n = (offset <= pos) ? pos - offset : capacity_ - offset + pos;
+		current_.erase(key);
+		if (migrating()) {
+			old_.erase(key);
+			migrate_(StepSize);
+		}
+	}
 
-		for (s32 i = offset; 0 <= i; --i) {
-			bitmap_type hop = hopinfoes_[n].getHop();
-			for (s32 j = 0; j <= i; ++j) {
-				if (hop & (0x01U << j)) {
-					size_type next_pos = clamp_(n + j);
-					construct(&keys_[pos], hashmap::move(keys_[next_pos]));
-					construct(&values_[pos], hashmap::move(values_[next_pos]));
-					keys_[next_pos].~key_type();
-					values_[next_pos].~value_type();
-					hopinfoes_[pos].setOccupy();
-					hopinfoes_[next_pos].setEmpty();
+	template<class Table, u32 StepSize>
+	typename IncrementalResize<Table, StepSize>::iterator IncrementalResize<Table, StepSize>::begin() const
+	{
+		typename Table::iterator pos = current_.begin();
+		if (pos != current_.end()) {
+			return {false, pos};
+		}
+		pos = old_.begin();
+		return (pos != old_.end()) ? iterator{true, pos} : end();
+	}
 
-					hop &= ~(0x01U << j);
-					hop |= (0x01U << i);
-					hopinfoes_[n].setHop(hop);
-					pos = next_pos;
-					distance -= (i - j);
-					return;
-				}
+	template<class Table, u32 StepSize>
+	typename IncrementalResize<Table, StepSize>::iterator IncrementalResize<Table, StepSize>::next(iterator pos) const
+	{
+		if (!pos.old_) {
+			pos.pos_ = current_.next(pos.pos_);
+			if (pos.pos_ != current_.end()) {
+				return pos;
 			}
-			n = clamp_(n + 1);
+			pos.pos_ = old_.begin();
+		} else {
+			pos.pos_ = old_.next(pos.pos_);
 		}
-		pos = end();
-		distance = 0;
+		return (pos.pos_ != old_.end()) ? iterator{true, pos.pos_} : end();
 	}
 
-	template<class Key, class Value, typename BitmapType, class MemoryAllocator>
-	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::erase(const_key_param_type key)
+	template<class Table, u32 StepSize>
+	typename IncrementalResize<Table, StepSize>::iterator IncrementalResize<Table, StepSize>::end() const
 	{
-		if (capacity_ <= 0) {
-			return;
-		}
+		return {false, current_.end()};
+	}
 
-		size_type hash = calcHash_(key);
-		size_type pos = find_(key, hash);
+	template<class Table, u32 StepSize>
+	typename IncrementalResize<Table, StepSize>::const_key_reference IncrementalResize<Table, StepSize>::getKey(iterator pos) const
+	{
+		return pos.old_ ? old_.getKey(pos.pos_) : current_.getKey(pos.pos_);
+	}
 
-		if (pos == end()) {
+	template<class Table, u32 StepSize>
+	typename IncrementalResize<Table, StepSize>::const_reference IncrementalResize<Table, StepSize>::getValue(iterator pos) const
+	{
+		return pos.old_ ? old_.getValue(pos.pos_) : current_.getValue(pos.pos_);
+	}
+
+	template<class Table, u32 StepSize>
+	typename IncrementalResize<Table, StepSize>::reference IncrementalResize<Table, StepSize>::getValue(iterator pos)
+	{
+		return pos.old_ ? old_.getValue(pos.pos_) : current_.getValue(pos.pos_);
+	}
+
+	template<class Table, u32 StepSize>
+	void IncrementalResize<Table, StepSize>::prepareInsert_()
+	{
+		migrate_(StepSize);
+		if (0 < current_.available()) {
 			return;
 		}
+		HASSERT(!migrating());
+		//Room for every old entry and one insertion per step, so that the old table drains before the new one fills
+		size_type size = current_.size();
+		size_type capacity = growth_policy::nextCapacity(current_.capacity());
+		size_type least = Table::capacityFor(size + (size + StepSize - 1) / StepSize + 1);
+		capacity = (capacity < least) ? least : capacity;
+		{
+			//Closed before migration, which can resize a table and report on its own
+			hash_detail::ResizeNotifier notifier(observer_, observerUser_, current_.capacity(), Table::roundCapacity(capacity), 0);
+			Table next(capacity, current_.getAllocator());
+			old_.swap(current_);
+			current_.swap(next);
+			cursor_ = 0;
+		}
+		migrate_(StepSize);
+	}
 
-		hopinfoes_[pos].setEmpty();
-		keys_[pos].~key_type();
-		values_[pos].~value_type();
-
-		hash = hashToPos_(hash);
-		size_type d = (hash <= pos) ? pos - hash : (capacity_ - hash + pos);
-		hopinfoes_[hash].clearHopFlag(d);
-		--size_;
+	template<class Table, u32 StepSize>
+	void IncrementalResize<Table, StepSize>::migrate_(u32 count)
+	{
+		for (; 0 < count && migrating(); --count) {
+			//The new table is sized not to grow by its load before the old one drains
+			HASSERT(0 < current_.available());
+			//Erasing can move a following entry into the erased position, so that the search restarts from there
+			typename Table::iterator pos = (0 == cursor_) ? old_.begin() : old_.next(cursor_ - 1);
+			HASSERT(pos != old_.end());
+			old_.moveAt(pos, current_);
+			cursor_ = pos;
+		}
+		if (!migrating() && 0 < old_.capacity()) {
+			Table empty;
+			old_.swap(empty);
+			cursor_ = 0;
+		}
 	}
 
-	template<class Key, class Value, typename BitmapType, class MemoryAllocator>
-	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::eraseAt(size_type pos)
+	//-----------------------------------------------------------------------------
+	//---
+	//--- ConcurrentSwissTable
+	//---
+	//-----------------------------------------------------------------------------
+	/**
+	@brief SwissTable split into shards, each of which is guarded by its own lock
+
+	A key goes to the shard selected by ShardBits bits of its remixed hash, so that threads working on different shards do not contend.
+	Each shard is padded to a cache line to avoid false sharing between neighboring locks.
+	Positions are not exposed because other threads can move entries, values are copied out instead.
+	@tparam ShardBits ... log2 of the number of shards
+	*/
+	template<class Key, class Value, u32 ShardBits = 6, class MemoryAllocator = DefaultAllocator, class GrowthPolicy = DefaultGrowthPolicy, class IndexPolicy = PrimeIndexPolicy, class Group = GroupSse2, bool StoreHash = false, class Layout = SoALayout>
+	class ConcurrentSwissTable
 	{
-		HASSERT(valid(pos));
+	public:
+		static_assert(ShardBits <= 8, "ShardBits should be less than or equal to 8");
+		static_assert(hash_detail::is_thread_safe<MemoryAllocator>::value, "MemoryAllocator should be thread safe, shards allocate on many threads");
+
+		inline static constexpr u32 Shards = 0x01U << ShardBits;
+
+		typedef SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout> table_type;
+		typedef typename table_type::key_type key_type;
+		typedef typename table_type::value_type value_type;
+		typedef typename table_type::memory_allocator memory_allocator;
+		typedef typename table_type::size_type size_type;
+		typedef typename table_type::const_key_param_type const_key_param_type;
+		typedef typename table_type::const_value_param_type const_value_param_type;
+		typedef ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout> this_type;
+
+		ConcurrentSwissTable();
+		/**
+		@param capacity ... initial capacity in total, divided among shards
+		*/
+		explicit ConcurrentSwissTable(size_type capacity);
+		/**
+		@param allocator ... shared by every shard, which should be thread safe
+		*/
+		ConcurrentSwissTable(size_type capacity, const memory_allocator& allocator);
+		~ConcurrentSwissTable();
+
+		/**
+		@brief Sum of shards, which is not a snapshot while other threads modify the table
+		*/
+		size_type capacity() const;
+		size_type size() const;
+		TableStats stats() const;
+		void clear();
+		/**
+		@brief Shard that holds a hash
+		*/
+		static inline u32 shardOf(u32 hash);
+		/**
+		@brief Sets the observer of every shard, which is called holding the lock of the resizing shard
+		*/
+		void setResizeObserver(ResizeObserver observer, void* user);
+
+		bool contains(const_key_param_type key) const;
+
+		/**
+		@brief Copies the value of key into value
+		@return false if the key does not exist
+		*/
+		bool find(const_key_param_type key, value_type& value) const;
+
+		/**
+		@brief Finds n keys at once, locking each shard once
+		@return number of found keys
+		@param values ... values[i] receives the value of keys[i] if found[i] is true
+		*/
+		size_type findBatch(const key_type* keys, size_type n, value_type* values, bool* found) const;
+
+		bool insert(const_key_param_type key, const_value_param_type value);
+		bool insert(key_type&& key, value_type&& value);
+
+		/**
+		@brief Inserts n pairs at once, locking and reserving each shard once
+		@return number of inserted pairs
+		*/
+		size_type insertBatch(const key_type* keys, const value_type* values, size_type n);
+
+		/**
+		@return false if the key does not exist
+		*/
+		bool erase(const_key_param_type key);
+	private:
+		ConcurrentSwissTable(const this_type&) = delete;
+		this_type& operator=(const this_type&) = delete;
 
-		size_type hash = calcHash_(getKey(pos));
+		struct alignas(hash_detail::CacheLineSize) Shard
+		{
+			mutable std::mutex mutex_;
+			table_type table_;
+		};
 
-		hopinfoes_[pos].setEmpty();
-		keys_[pos].~key_type();
-		values_[pos].~value_type();
+		/**
+		@brief Sorts entries of (hash << 32 | index) by shards
+		@return entries or work, whichever holds the result
+		*/
+		static const u64* sortByShard_(const key_type* keys, size_type n, u64* entries, u64* work);
 
-		hash = hashToPos_(hash);
-		size_type d = (hash <= pos) ? pos - hash : (capacity_ - hash + pos);
-		hopinfoes_[hash].clearHopFlag(d);
-		--size_;
-	}
+		Shard shards_[Shards];
+		memory_allocator allocator_;
+	};
 
-	template<class Key, class Value, typename BitmapType, class MemoryAllocator>
-	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::swap(this_type& rhs)
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::ConcurrentSwissTable()
 	{
-		hashmap::swap(capacity_, rhs.capacity_);
-		hashmap::swap(size_, rhs.size_);
-		hashmap::swap(hopinfoes_, rhs.hopinfoes_);
-		hashmap::swap(keys_, rhs.keys_);
-		hashmap::swap(values_, rhs.values_);
 	}
 
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::ConcurrentSwissTable(size_type capacity)
+	{
+		for (u32 i = 0; i < Shards; ++i) {
+			shards_[i].table_.initialize((capacity + Shards - 1) >> ShardBits);
+		}
+	}
 
-	template<class Key, class Value, typename BitmapType, class MemoryAllocator>
-	typename HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::iterator
-		HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::begin() const
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::ConcurrentSwissTable(size_type capacity, const memory_allocator& allocator)
+		:allocator_(allocator)
 	{
-		for (size_type i = 0; i < end(); ++i) {
-			if (isOccupy(i)) {
-				return i;
-			}
+		for (u32 i = 0; i < Shards; ++i) {
+			table_type table((capacity + Shards - 1) >> ShardBits, allocator);
+			shards_[i].table_.swap(table);
 		}
-		return end();
 	}
 
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::~ConcurrentSwissTable()
+	{
+	}
 
-	template<class Key, class Value, typename BitmapType, class MemoryAllocator>
-	typename HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::iterator
-		HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::next(iterator pos) const
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::capacity() const
 	{
-		for (size_type i = pos + 1; i < end(); ++i) {
-			if (isOccupy(i)) {
-				return i;
-			}
+		size_type capacity = 0;
+		for (u32 i = 0; i < Shards; ++i) {
+			std::lock_guard<std::mutex> lock(shards_[i].mutex_);
+			capacity += shards_[i].table_.capacity();
 		}
-		return end();
+		return capacity;
 	}
 
-	template<class Key, class Value, typename BitmapType, class MemoryAllocator>
-	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::expand()
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size() const
 	{
-		this_type tmp;
-		tmp.create(capacity_ + 1);
-
-		for (size_type i = 0; i < capacity_; ++i) {
-			if (isOccupy(i)) {
-				tmp.insert_(keys_[i], values_[i], tmp.calcHash_(keys_[i]));
-			}
+		size_type size = 0;
+		for (u32 i = 0; i < Shards; ++i) {
+			std::lock_guard<std::mutex> lock(shards_[i].mutex_);
+			size += shards_[i].table_.size();
 		}
-		tmp.swap(*this);
+		return size;
 	}
 
-	template<class Key, class Value, typename BitmapType, class MemoryAllocator>
-	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::create(size_type capacity)
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	TableStats ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::stats() const
 	{
-		HASSERT(NULL == hopinfoes_);
-		HASSERT(NULL == keys_);
-		HASSERT(NULL == values_);
+		TableStats stats;
+		for (u32 i = 0; i < Shards; ++i) {
+			std::lock_guard<std::mutex> lock(shards_[i].mutex_);
+			stats.merge(shards_[i].table_.stats());
+		}
+		return stats;
+	}
 
-		capacity_ = hash_detail::next_prime(capacity);
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::clear()
+	{
+		for (u32 i = 0; i < Shards; ++i) {
+			std::lock_guard<std::mutex> lock(shards_[i].mutex_);
+			shards_[i].table_.clear();
+		}
+	}
 
-		size_type size_infoes = align_(sizeof(hopinfo_type) * capacity_);
-		size_type size_keys = align_(sizeof(key_type) * capacity_);
-		size_type size_values = sizeof(value_type) * capacity_;
-		size_type total_size = size_infoes + size_keys + size_values;
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::setResizeObserver(ResizeObserver observer, void* user)
+	{
+		for (u32 i = 0; i < Shards; ++i) {
+			std::lock_guard<std::mutex> lock(shards_[i].mutex_);
+			shards_[i].table_.setResizeObserver(observer, user);
+		}
+	}
 
-		u8* mem = reinterpret_cast<u8*>(HALLOCATOR_MALLOC(memory_allocator, total_size));
-		hopinfoes_ = reinterpret_cast<hopinfo_pointer>(mem);
-		keys_ = reinterpret_cast<key_pointer>(mem + size_infoes);
-		values_ = reinterpret_cast<value_pointer>(mem + size_infoes + size_keys);
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	bool ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::contains(const_key_param_type key) const
+	{
+		u32 hash = hash_detail::calcHash(key);
+		const Shard& shard = shards_[shardOf(hash)];
+		std::lock_guard<std::mutex> lock(shard.mutex_);
+		return 0 < shard.table_.capacity() && shard.table_.find_(key, hash) != shard.table_.end();
+	}
 
-		::memset(hopinfoes_, 0, size_infoes);
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	bool ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::find(const_key_param_type key, value_type& value) const
+	{
+		u32 hash = hash_detail::calcHash(key);
+		const Shard& shard = shards_[shardOf(hash)];
+		std::lock_guard<std::mutex> lock(shard.mutex_);
+		if (shard.table_.capacity() <= 0) {
+			return false;
+		}
+		size_type pos = shard.table_.find_(key, hash);
+		if (pos == shard.table_.end()) {
+			return false;
+		}
+		value = shard.table_.getValue(pos);
+		return true;
 	}
 
-	template<class Key, class Value, typename BitmapType, class MemoryAllocator>
-	void HopscotchHashMap<Key, Value, BitmapType, MemoryAllocator>::destroy()
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::findBatch(const key_type* keys, size_type n, value_type* values, bool* found) const
 	{
-		clear();
-		HALLOCATOR_FREE(memory_allocator, hopinfoes_);
-		capacity_ = size_ = 0;
-		hopinfoes_ = NULL;
-		keys_ = NULL;
-		values_ = NULL;
+		if (n <= 0) {
+			return 0;
+		}
+		size_type chunk = (hash_detail::InsertChunk < n) ? hash_detail::InsertChunk : n;
+		u64* entries = reinterpret_cast<u64*>(HALLOCATOR_MALLOC(allocator_, sizeof(u64) * chunk * 2));
+		size_type count = 0;
+		for (size_type base = 0; base < n; base += chunk) {
+			size_type size = (chunk < (n - base)) ? chunk : (n - base);
+			const u64* sorted = sortByShard_(keys + base, size, entries, entries + chunk);
+			//Process a run of entries in the same shard under one lock
+			for (size_type i = 0; i < size;) {
+				const Shard& shard = shards_[shardOf(static_cast<u32>(sorted[i] >> 32))];
+				std::lock_guard<std::mutex> lock(shard.mutex_);
+				const table_type& table = shard.table_;
+				do {
+					u32 hash = static_cast<u32>(sorted[i] >> 32);
+					size_type index = base + static_cast<u32>(sorted[i]);
+					size_type pos = (0 < table.capacity()) ? table.find_(keys[index], hash) : table.end();
+					found[index] = (pos != table.end());
+					if (found[index]) {
+						values[index] = table.getValue(pos);
+						++count;
+					}
+					++i;
+				} while (i < size && &shards_[shardOf(static_cast<u32>(sorted[i] >> 32))] == &shard);
+			}
+		}
+		HALLOCATOR_FREE(allocator_, entries);
+		return count;
 	}
 
-	//----------------------------------------------------------------
-	//---
-	//--- Robin Hood Hashing
-	//---
-	//----------------------------------------------------------------
-	struct RHDistance
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	bool ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::insert(const_key_param_type key, const_value_param_type value)
 	{
-		typedef s8 distance_type;
+		u32 hash = hash_detail::calcHash(key);
+		Shard& shard = shards_[shardOf(hash)];
+		std::lock_guard<std::mutex> lock(shard.mutex_);
+		return shard.table_.tryInsert_(hash, key, value);
+	}
 
-		distance_type distance_;
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	bool ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::insert(key_type&& key, value_type&& value)
+	{
+		u32 hash = hash_detail::calcHash(key);
+		Shard& shard = shards_[shardOf(hash)];
+		std::lock_guard<std::mutex> lock(shard.mutex_);
+		return shard.table_.tryInsert_(hash, std::move(key), std::move(value));
+	}
 
-		inline distance_type distance() const
-		{
-			return distance_;
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::insertBatch(const key_type* keys, const value_type* values, size_type n)
+	{
+		if (n <= 0) {
+			return 0;
 		}
-
-		inline void set(distance_type d)
-		{
-			distance_ = d;
+		size_type chunk = (hash_detail::InsertChunk < n) ? hash_detail::InsertChunk : n;
+		u64* entries = reinterpret_cast<u64*>(HALLOCATOR_MALLOC(allocator_, sizeof(u64) * chunk * 2));
+		size_type inserted = 0;
+		for (size_type base = 0; base < n; base += chunk) {
+			size_type size = (chunk < (n - base)) ? chunk : (n - base);
+			const u64* sorted = sortByShard_(keys + base, size, entries, entries + chunk);
+			//Process a run of entries in the same shard under one lock
+			for (size_type i = 0; i < size;) {
+				u32 index = shardOf(static_cast<u32>(sorted[i] >> 32));
+				size_type end = i + 1;
+				while (end < size && shardOf(static_cast<u32>(sorted[end] >> 32)) == index) {
+					++end;
+				}
+				Shard& shard = shards_[index];
+				std::lock_guard<std::mutex> lock(shard.mutex_);
+				shard.table_.reserve_(end - i);
+				for (; i < end; ++i) {
+					size_type k = base + static_cast<u32>(sorted[i]);
+					if (shard.table_.tryInsert_(static_cast<u32>(sorted[i] >> 32), keys[k], values[k])) {
+						++inserted;
+					}
+				}
+			}
 		}
+		HALLOCATOR_FREE(allocator_, entries);
+		return inserted;
+	}
 
-		inline bool isEmpty() const
-		{
-			return distance_ < 0;
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	bool ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::erase(const_key_param_type key)
+	{
+		u32 hash = hash_detail::calcHash(key);
+		Shard& shard = shards_[shardOf(hash)];
+		std::lock_guard<std::mutex> lock(shard.mutex_);
+		if (shard.table_.capacity() <= 0) {
+			return false;
 		}
-
-		inline bool isOccupy() const
-		{
-			return 0 <= distance_;
+		size_type pos = shard.table_.find_(key, hash);
+		if (pos == shard.table_.end()) {
+			return false;
 		}
+		shard.table_.eraseAt(pos);
+		return true;
+	}
 
-		inline void setEmpty()
-		{
-			distance_ = -1;
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	inline u32 ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::shardOf(u32 hash)
+	{
+		//High bits of a multiplicative remix, so that hashes of a shard still take every value of h1 for homes
+		if constexpr (0 == ShardBits) {
+			return 0;
+		} else {
+			return (hash * 0x9E37'79B1U) >> (32 - ShardBits);
 		}
-	};
+	}
 
-	/**
-	@brief Robin Hood Hashing
-	*/
-	template<class Key, class Value, class MemoryAllocator = DefaultAllocator>
-	class RHHashMap
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	const u64* ConcurrentSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::sortByShard_(const key_type* keys, size_type n, u64* entries, u64* work)
 	{
-	public:
-		static const u32 Align = 4;
-		static const u32 AlignMask = Align - 1;
-
-		typedef RHHashMap<Key, Value, MemoryAllocator> this_type;
-		typedef Key key_type;
-		typedef Value value_type;
-		typedef MemoryAllocator memory_allocator;
-
-		typedef typename RHDistance::distance_type distance_type;
-		typedef u32 hash_type;
-		typedef u32 size_type;
-		typedef size_type iterator;
+		for (size_type i = 0; i < n; ++i) {
+			entries[i] = (static_cast<u64>(hash_detail::calcHash(keys[i])) << 32) | i;
+		}
+		return hash_detail::sortByHome(n, entries, work, Shards - 1, [](u32 hash) { return shardOf(hash); });
+	}
 
-		typedef hash_detail::type_traits<value_type> value_traits;
-		typedef typename value_traits::pointer value_pointer;
-		typedef typename value_traits::const_pointer const_value_pointer;
-		typedef typename value_traits::reference value_reference;
-		typedef typename value_traits::const_reference const_value_reference;
-		typedef typename value_traits::pointer pointer;
-		typedef typename value_traits::const_pointer const_pointer;
-		typedef typename value_traits::reference reference;
-		typedef typename value_traits::const_reference const_reference;
-		typedef typename value_traits::param_type value_param_type;
-		typedef typename value_traits::const_param_type const_value_param_type;
+	//-----------------------------------------------------------------------------
+	//---
+	//--- OptimisticSwissTable
+	//---
+	//-----------------------------------------------------------------------------
+	namespace hash_detail
+	{
+		/**
+		@brief Epoch based reclamation shared by all tables
 
+		A reader announces the global epoch in a slot of its own while it reads.
+		Memory retired at an epoch is freed once every announced epoch is later than it.
+		*/
+		class Epoch
+		{
+		public:
+			/// Number of threads which can announce epochs at once, others fall back to locking
+			inline static constexpr u32 MaxThreads = 128;
+
+			/**
+			@brief Slot of the calling thread, or MaxThreads if all slots are taken
+			*/
+			static u32 slot()
+			{
+				thread_local ThreadSlot threadSlot;
+				return threadSlot.index_;
+			}
 
-		typedef hash_detail::type_traits<key_type> key_traits;
-		typedef typename key_traits::pointer key_pointer;
-		typedef typename key_traits::const_pointer const_key_pointer;
-		typedef typename key_traits::reference key_reference;
-		typedef typename key_traits::const_reference const_key_reference;
-		typedef typename key_traits::param_type key_param_type;
-		typedef typename key_traits::const_param_type const_key_param_type;
+			static void enter(u32 slot)
+			{
+				slots_[slot].epoch_.store(global_.load());
+			}
 
+			static void leave(u32 slot)
+			{
+				slots_[slot].epoch_.store(0, std::memory_order_release);
+			}
 
-		RHHashMap();
-		explicit RHHashMap(size_type capacity);
-		~RHHashMap();
+			/**
+			@brief Advances the global epoch, after a pointer to retired memory has been replaced
+			@return the epoch at which the memory is retired
+			*/
+			static u64 advance()
+			{
+				return global_.fetch_add(1);
+			}
 
-		inline size_type capacity() const;
+			/**
+			@brief Whether no reader can still hold memory retired at epoch
+			*/
+			static bool safe(u64 epoch)
+			{
+				for (u32 i = 0; i < MaxThreads; ++i) {
+					u64 announced = slots_[i].epoch_.load();
+					if (0 != announced && announced <= epoch) {
+						return false;
+					}
+				}
+				return true;
+			}
+		private:
+			struct alignas(CacheLineSize) Slot
+			{
+				/// 0 while the owner does not read
+				std::atomic<u64> epoch_;
+			};
 
-		void clear();
-		void reserve(size_type capacity);
-		bool insert(const_key_param_type key, const_value_param_type value);
-		void erase(const_key_param_type key);
-		void eraseAt(size_type pos);
-		size_type find(const_key_param_type key) const;
+			struct ThreadSlot
+			{
+				ThreadSlot()
+					:index_(MaxThreads)
+				{
+					for (u32 i = 0; i < MaxThreads; ++i) {
+						bool expected = false;
+						if (owned_[i].compare_exchange_strong(expected, true)) {
+							index_ = i;
+							break;
+						}
+					}
+				}
 
-		inline bool valid(size_type pos) const;
-		inline const_reference getValue(size_type pos) const;
-		inline reference getValue(size_type pos);
+				~ThreadSlot()
+				{
+					if (index_ < MaxThreads) {
+						slots_[index_].epoch_.store(0);
+						owned_[index_].store(false, std::memory_order_release);
+					}
+				}
 
-		void swap(this_type& rhs);
+				u32 index_;
+			};
 
-		iterator begin() const;
+			inline static std::atomic<u64> global_{1};
+			inline static Slot slots_[MaxThreads] = {};
+			inline static std::atomic<bool> owned_[MaxThreads] = {};
+		};
+	}
 
-		iterator end() const
-		{
-			return padded_capacity_;
-		}
+	/**
+	@brief Sharded SwissTable whose readers take no locks
 
-		iterator next(iterator pos) const;
+	Writers serialize on the lock of a shard, and bump a version counter of each group they modify before and after modification.
+	Readers probe with the SIMD matching of SwissTable, and retry a group if its version is odd or changes while they read it.
+	Growth builds a new table which is published atomically, and the old one is freed by epoch based reclamation.
+	Readers may observe torn entries before validation, so that keys and values should be trivially copyable.
+	@tparam ShardBits ... log2 of the number of shards
+	*/
+	template<class Key, class Value, u32 ShardBits = 6, class MemoryAllocator = DefaultAllocator, class GrowthPolicy = DefaultGrowthPolicy, class IndexPolicy = PrimeIndexPolicy, class Group = GroupSse2, bool StoreHash = false, class Layout = SoALayout>
+	class OptimisticSwissTable
+	{
+	public:
+		static_assert(ShardBits <= 8, "ShardBits should be less than or equal to 8");
+		static_assert(hash_detail::is_thread_safe<MemoryAllocator>::value, "MemoryAllocator should be thread safe, shards allocate on many threads");
+		static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value, "Key and Value should be trivially copyable");
+
+		inline static constexpr u32 Shards = 0x01U << ShardBits;
+
+		typedef SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout> table_type;
+		typedef typename table_type::key_type key_type;
+		typedef typename table_type::value_type value_type;
+		typedef typename table_type::memory_allocator memory_allocator;
+		typedef typename table_type::growth_policy growth_policy;
+		typedef typename table_type::size_type size_type;
+		typedef typename table_type::const_key_param_type const_key_param_type;
+		typedef typename table_type::const_value_param_type const_value_param_type;
+		typedef OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout> this_type;
+
+		OptimisticSwissTable();
+		/**
+		@param capacity ... initial capacity in total, divided among shards
+		*/
+		explicit OptimisticSwissTable(size_type capacity);
+		/**
+		@param allocator ... shared by every snapshot, which should be thread safe
+		*/
+		OptimisticSwissTable(size_type capacity, const memory_allocator& allocator);
+		/**
+		@brief No thread should be reading while destruction
+		*/
+		~OptimisticSwissTable();
+
+		/**
+		@brief Sum of shards, which is not a snapshot while other threads modify the table
+		*/
+		size_type capacity() const;
+		size_type size() const;
+		/**
+		@brief Sum of the current snapshots of shards, which does not count retired snapshots
+		*/
+		TableStats stats() const;
+		void clear();
+		/**
+		@brief Shard that holds a hash, as ConcurrentSwissTable::shardOf
+		*/
+		static inline u32 shardOf(u32 hash);
+		/**
+		@brief Sets a function called when a shard copies into a new snapshot, which should be set before sharing the table among threads
+		*/
+		void setResizeObserver(ResizeObserver observer, void* user);
+
+		bool contains(const_key_param_type key) const;
+
+		/**
+		@brief Copies the value of key into value without locking
+		@return false if the key does not exist
+		*/
+		bool find(const_key_param_type key, value_type& value) const;
+
+		bool insert(const_key_param_type key, const_value_param_type value);
+
+		/**
+		@return false if the key does not exist
+		*/
+		bool erase(const_key_param_type key);
 	private:
-		RHHashMap(const this_type&) = delete;
+		OptimisticSwissTable(const this_type&) = delete;
 		this_type& operator=(const this_type&) = delete;
 
-		inline static hash_type calcHash_(const_key_param_type key)
+		/**
+		@brief Table published to readers, with a version per group of slots
+		*/
+		struct Snapshot
 		{
-			return hash_detail::calcHash(key);
-		}
+			table_type table_;
+			std::atomic<u32>* versions_;
+			/// Next in the list of retired snapshots
+			Snapshot* next_;
+			/// Epoch at which this is retired
+			u64 epoch_;
+		};
 
-		inline size_type hashToPos(hash_type hash) const
+		/**
+		@brief A reader touches only the first cache line, a writer the second one too
+		*/
+		struct alignas(hash_detail::CacheLineSize) Shard
 		{
-			return hash % capacity_;
-		}
-		static inline size_type align(size_type x)
-		{
-			return (x + AlignMask) & (~AlignMask);
-		}
-
-		inline void destroy(size_type pos);
-		inline void emplace(distance_type distance, size_type pos, const_key_param_type key, const_value_param_type value);
-		inline void emplace(distance_type distance, size_type pos, key_type&& key, value_type&& value);
-		inline void replace(distance_type distance, size_type dst, size_type src);
-
-		size_type find_(hash_type hash, const_key_param_type key) const;
-		void reserve_(size_type capacity);
-		bool insert_(const_key_param_type key, const_value_param_type value);
-		void erase_(size_type pos);
-		void expand(size_type capacity);
+			std::atomic<Snapshot*> snapshot_;
+			alignas(hash_detail::CacheLineSize) mutable std::mutex mutex_;
+			Snapshot* retired_;
+		};
 
-		size_type size_;
-		size_type capacity_;
-		size_type max_distance_;
-		size_type padded_capacity_;
-		RHDistance* distances_;
-		key_type* keys_;
-		value_type* values_;
+		/**
+		@brief Version of the group of Block slots, in which the last group takes the remainder slots too
+		*/
+		static inline size_type versionIndex_(const table_type& table, size_type pos);
+
+		bool find_(const Shard& shard, const_key_param_type key, u32 hash, value_type* value) const;
+		bool findLocked_(const Shard& shard, const_key_param_type key, u32 hash, value_type* value) const;
+
+		Snapshot* createSnapshot_(size_type capacity) const;
+		void destroySnapshot_(Snapshot* snapshot) const;
+		/**
+		@brief Replaces the snapshot of shard, and retires the old one
+		*/
+		void publish_(Shard& shard, Snapshot* snapshot) const;
+		/**
+		@brief Frees retired snapshots which no reader can hold, or all of them if all is true
+		*/
+		void reclaim_(Shard& shard, bool all) const;
+		/**
+		@brief Copies entries into a new snapshot, which is the same capacity if tombstones are a quarter of the load
+		*/
+		Snapshot* grow_(Shard& shard, Snapshot* snapshot) const;
+
+		static void beginWrite_(std::atomic<u32>& version);
+		static void endWrite_(std::atomic<u32>& version);
+
+		Shard shards_[Shards];
+		memory_allocator allocator_;
+		ResizeObserver observer_;
+		void* observerUser_;
 	};
 
-	template<class Key, class Value, class MemoryAllocator>
-	RHHashMap<Key, Value, MemoryAllocator>::RHHashMap()
-		:size_(0)
-		, capacity_(0)
-		, max_distance_(0)
-		, padded_capacity_(0)
-		, distances_(NULL)
-		, keys_(NULL)
-		, values_(NULL)
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::OptimisticSwissTable()
+		:observer_(nullptr)
+		, observerUser_(nullptr)
 	{
+		for (u32 i = 0; i < Shards; ++i) {
+			shards_[i].snapshot_.store(nullptr, std::memory_order_relaxed);
+			shards_[i].retired_ = nullptr;
+		}
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	RHHashMap<Key, Value, MemoryAllocator>::RHHashMap(size_type capacity)
-		:size_(0)
-		, distances_(NULL)
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::OptimisticSwissTable(size_type capacity)
+		:observer_(nullptr)
+		, observerUser_(nullptr)
 	{
-		reserve_(capacity);
+		for (u32 i = 0; i < Shards; ++i) {
+			shards_[i].snapshot_.store(createSnapshot_((capacity + Shards - 1) >> ShardBits), std::memory_order_relaxed);
+			shards_[i].retired_ = nullptr;
+		}
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	RHHashMap<Key, Value, MemoryAllocator>::~RHHashMap()
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::OptimisticSwissTable(size_type capacity, const memory_allocator& allocator)
+		:allocator_(allocator)
+		, observer_(nullptr)
+		, observerUser_(nullptr)
 	{
-		clear();
-		HALLOCATOR_FREE(memory_allocator, distances_);
-		keys_ = NULL;
-		values_ = NULL;
+		for (u32 i = 0; i < Shards; ++i) {
+			shards_[i].snapshot_.store(createSnapshot_((capacity + Shards - 1) >> ShardBits), std::memory_order_relaxed);
+			shards_[i].retired_ = nullptr;
+		}
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	inline typename RHHashMap<Key, Value, MemoryAllocator>::size_type RHHashMap<Key, Value, MemoryAllocator>::capacity() const
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::~OptimisticSwissTable()
 	{
-		return capacity_;
+		for (u32 i = 0; i < Shards; ++i) {
+			destroySnapshot_(shards_[i].snapshot_.load(std::memory_order_relaxed));
+			reclaim_(shards_[i], true);
+		}
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void RHHashMap<Key, Value, MemoryAllocator>::clear()
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::capacity() const
 	{
-		for (size_type i = 0; i < padded_capacity_; ++i) {
-			if (distances_[i].isOccupy()) {
-				destroy(i);
-			}
+		size_type capacity = 0;
+		for (u32 i = 0; i < Shards; ++i) {
+			std::lock_guard<std::mutex> lock(shards_[i].mutex_);
+			const Snapshot* snapshot = shards_[i].snapshot_.load(std::memory_order_relaxed);
+			capacity += (nullptr != snapshot) ? snapshot->table_.capacity() : 0;
 		}
-		size_ = 0;
+		return capacity;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void RHHashMap<Key, Value, MemoryAllocator>::reserve(size_type capacity)
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size() const
 	{
-		if (capacity <= capacity_) {
-			return;
-		}
-		if (size_ <= 0) {
-			reserve_(capacity);
-		}
-		else {
-			expand(capacity);
+		size_type size = 0;
+		for (u32 i = 0; i < Shards; ++i) {
+			std::lock_guard<std::mutex> lock(shards_[i].mutex_);
+			const Snapshot* snapshot = shards_[i].snapshot_.load(std::memory_order_relaxed);
+			size += (nullptr != snapshot) ? snapshot->table_.size() : 0;
 		}
+		return size;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	bool RHHashMap<Key, Value, MemoryAllocator>::insert(const_key_param_type key, const_value_param_type value)
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	TableStats OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::stats() const
 	{
-		return insert_(key, value);
+		TableStats stats;
+		for (u32 i = 0; i < Shards; ++i) {
+			std::lock_guard<std::mutex> lock(shards_[i].mutex_);
+			const Snapshot* snapshot = shards_[i].snapshot_.load(std::memory_order_relaxed);
+			if (nullptr != snapshot) {
+				stats.merge(snapshot->table_.stats());
+			}
+		}
+		return stats;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void RHHashMap<Key, Value, MemoryAllocator>::erase(const_key_param_type key)
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::clear()
 	{
-		size_type pos = find(key);
-		if (valid(pos)) {
-			erase_(pos);
+		for (u32 i = 0; i < Shards; ++i) {
+			std::lock_guard<std::mutex> lock(shards_[i].mutex_);
+			publish_(shards_[i], nullptr);
 		}
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void RHHashMap<Key, Value, MemoryAllocator>::eraseAt(size_type pos)
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::setResizeObserver(ResizeObserver observer, void* user)
 	{
-		if (valid(pos)) {
-			erase_(pos);
-		}
+		observer_ = observer;
+		observerUser_ = user;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	typename RHHashMap<Key, Value, MemoryAllocator>::size_type RHHashMap<Key, Value, MemoryAllocator>::find(const_key_param_type key) const
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	bool OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::contains(const_key_param_type key) const
 	{
-		if (capacity_ <= 0) {
-			return end();
-		}
-		hash_type hash = calcHash_(key);
-		return find_(hash, key);
+		u32 hash = hash_detail::calcHash(key);
+		return find_(shards_[shardOf(hash)], key, hash, nullptr);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	inline bool RHHashMap<Key, Value, MemoryAllocator>::valid(size_type pos) const
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	bool OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::find(const_key_param_type key, value_type& value) const
 	{
-		return pos < end();
+		u32 hash = hash_detail::calcHash(key);
+		return find_(shards_[shardOf(hash)], key, hash, &value);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	inline typename RHHashMap<Key, Value, MemoryAllocator>::const_reference RHHashMap<Key, Value, MemoryAllocator>::getValue(size_type pos) const
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	bool OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::insert(const_key_param_type key, const_value_param_type value)
 	{
-		HASSERT(valid(pos));
-		return values_[pos];
+		u32 hash = hash_detail::calcHash(key);
+		Shard& shard = shards_[shardOf(hash)];
+		std::lock_guard<std::mutex> lock(shard.mutex_);
+		//Only writers holding the lock modify the snapshot, so that it can be read without validation here
+		Snapshot* snapshot = shard.snapshot_.load(std::memory_order_relaxed);
+		if (nullptr == snapshot) {
+			snapshot = createSnapshot_(0);
+			publish_(shard, snapshot);
+		} else if (snapshot->table_.find_(key, hash) != snapshot->table_.end()) {
+			return false;
+		}
+		table_type* table = &snapshot->table_;
+		if (table->growthLimit() <= (table->size_ + table->deleted_)) {
+			snapshot = grow_(shard, snapshot);
+			table = &snapshot->table_;
+		}
+
+		size_type pos = table->findInsertPos_(hash);
+		HASSERT(pos < table->capacity_);
+		std::atomic<u32>& version = snapshot->versions_[versionIndex_(*table, pos)];
+		beginWrite_(version);
+		table->deleted_ -= table->controls_[pos].isDeleted() ? 1 : 0;
+		table->setHash(pos, hash);
+		HPLACEMENT_NEW(&table->slots_.key(pos)) key_type(key);
+		HPLACEMENT_NEW(&table->slots_.value(pos)) value_type(value);
+		table->setControl(pos, table_type::h2(hash));
+		++table->size_;
+		endWrite_(version);
+		return true;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	inline typename RHHashMap<Key, Value, MemoryAllocator>::reference RHHashMap<Key, Value, MemoryAllocator>::getValue(size_type pos)
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	bool OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::erase(const_key_param_type key)
 	{
-		HASSERT(valid(pos));
-		return values_[pos];
+		u32 hash = hash_detail::calcHash(key);
+		Shard& shard = shards_[shardOf(hash)];
+		std::lock_guard<std::mutex> lock(shard.mutex_);
+		Snapshot* snapshot = shard.snapshot_.load(std::memory_order_relaxed);
+		if (nullptr == snapshot) {
+			return false;
+		}
+		table_type& table = snapshot->table_;
+		size_type pos = table.find_(key, hash);
+		if (pos == table.end()) {
+			return false;
+		}
+		std::atomic<u32>& version = snapshot->versions_[versionIndex_(table, pos)];
+		beginWrite_(version);
+		table.eraseAt(pos);
+		endWrite_(version);
+		return true;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void RHHashMap<Key, Value, MemoryAllocator>::swap(this_type& rhs)
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	inline u32 OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::shardOf(u32 hash)
 	{
-		hashmap::swap(size_, rhs.size_);
-		hashmap::swap(capacity_, rhs.capacity_);
-		hashmap::swap(max_distance_, rhs.max_distance_);
-		hashmap::swap(padded_capacity_, rhs.padded_capacity_);
-		hashmap::swap(distances_, rhs.distances_);
-		hashmap::swap(keys_, rhs.keys_);
-		hashmap::swap(values_, rhs.values_);
+		if constexpr (0 == ShardBits) {
+			return 0;
+		} else {
+			return (hash * 0x9E37'79B1U) >> (32 - ShardBits);
+		}
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	inline void RHHashMap<Key, Value, MemoryAllocator>::destroy(size_type pos)
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	inline typename OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::size_type OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::versionIndex_(const table_type& table, size_type pos)
 	{
-		HASSERT(valid(pos));
-
-		distances_[pos].setEmpty();
-		keys_[pos].~key_type();
-		values_[pos].~value_type();
+		//Groups of versions are at least Block slots, so that a loaded group does not span three of them
+		size_type index = pos / table_type::Block;
+		size_type last = table.capacity() / table_type::Block - 1;
+		return (index < last) ? index : last;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	inline void RHHashMap<Key, Value, MemoryAllocator>::emplace(distance_type distance, size_type pos, const_key_param_type key, const_value_param_type value)
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	bool OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::find_(const Shard& shard, const_key_param_type key, u32 hash, value_type* value) const
 	{
-		HASSERT(valid(pos));
-		HASSERT(distances_[pos].isEmpty());
+		typedef typename table_type::Control Control;
+		typedef typename table_type::group_type group_type;
+		u32 slot = hash_detail::Epoch::slot();
+		if (hash_detail::Epoch::MaxThreads <= slot) {
+			return findLocked_(shard, key, hash, value);
+		}
+		hash_detail::Epoch::enter(slot);
+		//Sequentially consistent, so that a writer which has not seen the announced epoch has published the snapshot before this load
+		const Snapshot* snapshot = shard.snapshot_.load();
+		if (nullptr == snapshot) {
+			hash_detail::Epoch::leave(slot);
+			return false;
+		}
+		const table_type& table = snapshot->table_;
+		u8 h = table_type::h2(hash);
+		size_type pos = table.probeStart(hash);
+		bool found = false;
+		//A read can tear under a writer, so that the caller sees the copy only after the versions validate it
+		value_type copy = value_type();
+		for (size_type n = table.probeCount(); 0 < n; --n) {
+			//A group loaded at pos spans two groups of versions at most
+			std::atomic<u32>& first = snapshot->versions_[versionIndex_(table, pos)];
+			std::atomic<u32>& last = snapshot->versions_[versionIndex_(table, table.wrap(pos + table_type::BlockMask))];
+			bool empty;
+			for (;;) {
+				u32 version0 = first.load(std::memory_order_acquire);
+				u32 version1 = last.load(std::memory_order_acquire);
+				if (0 != ((version0 | version1) & 0x01U)) {
+					_mm_pause();
+					continue;
+				}
+				group_type group(reinterpret_cast<const u8*>(table.controls_ + pos));
+				for (u32 i = group.match(h); i; i = table_type::next_pos(i)) {
+					size_type p = table.wrap(pos + table_type::leastSignificantBit(i));
+					if (table.equal(p, hash, key)) {
+						if (nullptr != value) {
+							copy = table.slots_.value(p);
+						}
+						found = true;
+						break;
+					}
+				}
+				empty = (0 != group.match(Control::Empty));
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (first.load(std::memory_order_relaxed) == version0 && last.load(std::memory_order_relaxed) == version1) {
+					break;
+				}
+				found = false;
+			}
+			if (found || empty) {
+				break;
+			}
+			pos = table.wrap(pos + table_type::Block);
+		}
+		hash_detail::Epoch::leave(slot);
+		if (found && nullptr != value) {
+			*value = std::move(copy);
+		}
+		return found;
+	}
 
-		distances_[pos].set(distance);
-		construct(&keys_[pos], key);
-		construct(&values_[pos], value);
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	bool OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::findLocked_(const Shard& shard, const_key_param_type key, u32 hash, value_type* value) const
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex_);
+		const Snapshot* snapshot = shard.snapshot_.load(std::memory_order_relaxed);
+		if (nullptr == snapshot) {
+			return false;
+		}
+		size_type pos = snapshot->table_.find_(key, hash);
+		if (pos == snapshot->table_.end()) {
+			return false;
+		}
+		if (nullptr != value) {
+			*value = snapshot->table_.getValue(pos);
+		}
+		return true;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	inline void RHHashMap<Key, Value, MemoryAllocator>::emplace(distance_type distance, size_type pos, key_type&& key, value_type&& value)
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::Snapshot* OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::createSnapshot_(size_type capacity) const
 	{
-		HASSERT(valid(pos));
-		HASSERT(distances_[pos].isEmpty());
+		Snapshot* snapshot = HNEW Snapshot;
+		table_type table(capacity, allocator_);
+		snapshot->table_.swap(table);
+		size_type count = snapshot->table_.capacity() / table_type::Block;
+		snapshot->versions_ = reinterpret_cast<std::atomic<u32>*>(HALLOCATOR_MALLOC(allocator_, sizeof(std::atomic<u32>) * count));
+		for (size_type i = 0; i < count; ++i) {
+			HPLACEMENT_NEW(&snapshot->versions_[i]) std::atomic<u32>(0);
+		}
+		snapshot->next_ = nullptr;
+		snapshot->epoch_ = 0;
+		return snapshot;
+	}
 
-		distances_[pos].set(distance);
-		construct(&keys_[pos], key);
-		construct(&values_[pos], value);
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::destroySnapshot_(Snapshot* snapshot) const
+	{
+		if (nullptr == snapshot) {
+			return;
+		}
+		HALLOCATOR_FREE(allocator_, snapshot->versions_);
+		HDELETE_RAW(snapshot);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	inline void RHHashMap<Key, Value, MemoryAllocator>::replace(distance_type distance, size_type dst, size_type src)
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::publish_(Shard& shard, Snapshot* snapshot) const
 	{
-		HASSERT(valid(dst));
-		HASSERT(valid(src));
-		HASSERT(distances_[dst].isEmpty());
+		Snapshot* old = shard.snapshot_.exchange(snapshot);
+		if (nullptr != old) {
+			//Readers announcing a later epoch load the new snapshot
+			old->epoch_ = hash_detail::Epoch::advance();
+			old->next_ = shard.retired_;
+			shard.retired_ = old;
+		}
+		reclaim_(shard, false);
+	}
 
-		distances_[dst].set(distance);
-		construct(&keys_[dst], move(keys_[src]));
-		construct(&values_[dst], move(values_[src]));
-		destroy(src);
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::reclaim_(Shard& shard, bool all) const
+	{
+		Snapshot** link = &shard.retired_;
+		while (nullptr != *link) {
+			Snapshot* snapshot = *link;
+			if (all || hash_detail::Epoch::safe(snapshot->epoch_)) {
+				*link = snapshot->next_;
+				destroySnapshot_(snapshot);
+			} else {
+				link = &snapshot->next_;
+			}
+		}
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	typename RHHashMap<Key, Value, MemoryAllocator>::size_type RHHashMap<Key, Value, MemoryAllocator>::find_(hash_type hash, const_key_param_type key) const
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	typename OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::Snapshot* OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::grow_(Shard& shard, Snapshot* snapshot) const
 	{
-		size_type pos = hashToPos(hash);
-		size_type pend = pos + max_distance_;
-		HASSERT(pend <= padded_capacity_);
-		for (size_type i = pos; i != pend; ++i) {
-			if (distances_[i].isOccupy() && key == keys_[i]) {
-				return i;
+		const table_type& table = snapshot->table_;
+		size_type capacity = (0 < table.deleted_ && (table.growthLimit() >> 2) <= table.deleted_) ? table.capacity_ : growth_policy::nextCapacity(table.capacity_);
+		hash_detail::ResizeNotifier notifier(observer_, observerUser_, table.capacity_, table_type::roundCapacity(capacity), table.size_);
+		Snapshot* next = createSnapshot_(capacity);
+		for (size_type i = 0; i < table.capacity_; ++i) {
+			if (table.controls_[i].isOccupied()) {
+				key_type key = table.slots_.key(i);
+				value_type value = table.slots_.value(i);
+				next->table_.insert_(table.hashAt(i), std::move(key), std::move(value));
 			}
 		}
-		return end();
+		publish_(shard, next);
+		return next;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void RHHashMap<Key, Value, MemoryAllocator>::reserve_(size_type capacity)
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::beginWrite_(std::atomic<u32>& version)
 	{
-		HASSERT(size_ <= 0);
+		version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+	}
 
-		capacity_ = hash_detail::next_prime(capacity);
-		max_distance_ = hash_detail::log2(capacity_);
-		padded_capacity_ = capacity_ + max_distance_;
+	template<class Key, class Value, u32 ShardBits, class MemoryAllocator, class GrowthPolicy, class IndexPolicy, class Group, bool StoreHash, class Layout>
+	void OptimisticSwissTable<Key, Value, ShardBits, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>::endWrite_(std::atomic<u32>& version)
+	{
+		version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	//-----------------------------------------------------------------------------
+	//---
+	//--- MappedTable
+	//---
+	//-----------------------------------------------------------------------------
+	/**
+	@brief Read only table served from a memory mapped image, which Table::saveImage writes
+
+	Lookups run on the mapped file as it is, without parsing or rehash, so that a large table comes back in the time to map it.
+	Pages are read on first touch. An image is refused unless it comes from a Table with the same format and hash seed.
+	@tparam Table ... SwissTable or RHHashMap of trivially copyable keys and values, with the same template arguments as the saving table
+	*/
+	template<class Table>
+	class MappedTable
+	{
+	public:
+		static_assert(std::is_trivially_copyable<typename Table::key_type>::value && std::is_trivially_copyable<typename Table::value_type>::value, "An image needs trivially copyable keys and values");
+
+		typedef Table table_type;
+		typedef typename Table::key_type key_type;
+		typedef typename Table::value_type value_type;
+		typedef typename Table::size_type size_type;
+		typedef typename Table::iterator iterator;
+		typedef typename Table::const_key_param_type const_key_param_type;
+		typedef typename Table::const_key_reference const_key_reference;
+		typedef typename Table::const_reference const_reference;
+		typedef MappedTable<Table> this_type;
+
+		MappedTable();
+		~MappedTable();
+
+		/**
+		@brief Maps an image, in place of the current one
+		@return false if the file cannot be mapped, or the image does not match Table
+		@param verify ... whether to compare the checksum, which reads the whole file
+		*/
+		bool open(const char* path, bool verify = true);
+		void close();
+		bool isOpen() const;
 
-		HALLOCATOR_FREE(memory_allocator, distances_);
+		size_type capacity() const;
+		size_type size() const;
+		TableStats stats() const;
 
-		size_type size_distances = align(sizeof(RHDistance) * padded_capacity_);
-		size_type size_keys = align(sizeof(key_type) * padded_capacity_);
-		size_type size_values = sizeof(value_type) * padded_capacity_;
-		size_type total_size = size_distances + size_keys + size_values;
+		bool valid(size_type pos) const;
+		iterator find(const_key_param_type key) const;
+
+		/**
+		@brief Finds n keys at once, out[i] receives the position of keys[i] or end()
+		*/
+		void findBatch(const key_type* keys, size_type n, iterator* out) const;
+
+		iterator begin() const;
+		iterator next(iterator pos) const;
+		iterator end() const;
+
+		const_key_reference getKey(iterator pos) const;
+		const_reference getValue(iterator pos) const;
+	private:
+		MappedTable(const this_type&) = delete;
+		this_type& operator=(const this_type&) = delete;
+
+		hash_detail::MappedFile file_;
+		Table table_;
+	};
+
+	template<class Key, class Value, class MemoryAllocator = DefaultAllocator, class GrowthPolicy = DefaultGrowthPolicy, class IndexPolicy = PrimeIndexPolicy, class Group = GroupSse2, bool StoreHash = false, class Layout = SoALayout>
+	using MappedSwissTable = MappedTable<SwissTable<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, Group, StoreHash, Layout>>;
 
-		u8* mem = reinterpret_cast<u8*>(HALLOCATOR_MALLOC(memory_allocator, total_size));
-		distances_ = reinterpret_cast<RHDistance*>(mem);
-		keys_ = reinterpret_cast<key_type*>(mem + size_distances);
-		values_ = reinterpret_cast<value_type*>(mem + size_distances + size_keys);
+	template<class Key, class Value, class MemoryAllocator = DefaultAllocator, class GrowthPolicy = DefaultGrowthPolicy, class IndexPolicy = PrimeIndexPolicy, bool StoreHash = false, class Layout = SoALayout>
+	using MappedRHHashMap = MappedTable<RHHashMap<Key, Value, MemoryAllocator, GrowthPolicy, IndexPolicy, StoreHash, Layout>>;
 
-		::memset(distances_, -1, size_distances);
+	template<class Table>
+	MappedTable<Table>::MappedTable()
+	{
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	bool RHHashMap<Key, Value, MemoryAllocator>::insert_(const_key_param_type key, const_value_param_type value)
+	template<class Table>
+	MappedTable<Table>::~MappedTable()
 	{
-		hash_type hash = calcHash_(key);
+		close();
+	}
 
-		if (capacity_ <= 0) {
-			expand(capacity_ + 1);
+	template<class Table>
+	bool MappedTable<Table>::open(const char* path, bool verify)
+	{
+		close();
+		if (!file_.open(path)) {
+			return false;
 		}
-		else if (valid(find_(hash, key))) {
+		const hash_detail::ImageHeader* header = hash_detail::readImage(file_.data(), file_.size(), Table::ImageKind, Table::index_policy::Id, Table::growth_policy::Id, sizeof(key_type), sizeof(value_type), verify);
+		if (nullptr == header || !table_.bindImage_(reinterpret_cast<const u8*>(header + 1), header->bytes_, header->capacity_, header->size_)) {
+			file_.close();
 			return false;
 		}
+		return true;
+	}
 
-		size_type pos = hashToPos(hash);
-		size_type end = pos + max_distance_;
+	template<class Table>
+	void MappedTable<Table>::close()
+	{
+		//The table must not free the mapped block
+		table_.unbindImage_();
+		file_.close();
+	}
 
-		key_type tkey(key);
-		value_type tvalue(value);
-		for (;;) {
-			distance_type d = 0;
-			for (size_type i = pos; i != end; ++i, ++d) {
-				if (distances_[i].isEmpty()) {
-					emplace(d, i, tkey, tvalue);
-					return true;
-				}
-				if (distances_[i].distance_ < d) {
-					hashmap::swap(keys_[i], tkey);
-					hashmap::swap(values_[i], tvalue);
-					hashmap::swap(distances_[i].distance_, d);
-				}
-			}
-			expand(capacity_ + 1);
-			hash = calcHash_(tkey);
-			pos = hashToPos(hash);
-			end = pos + max_distance_;
-		}
+	template<class Table>
+	bool MappedTable<Table>::isOpen() const
+	{
+		return nullptr != file_.data();
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void RHHashMap<Key, Value, MemoryAllocator>::erase_(size_type pos)
+	template<class Table>
+	typename MappedTable<Table>::size_type MappedTable<Table>::capacity() const
 	{
-		destroy(pos);
-		--size_;
-#if 1
-		size_type end = pos + max_distance_;
-		distance_type d = 1;
-		for (size_type i = pos + 1; i != end; ++i, ++d) {
-			if (d <= distances_[i].distance_) {
-				replace(distances_[i].distance_ - d, pos, i);
-#if 1
-				return;
-#else
-				pos = i;
-				d = 0;
-#endif
-			}
-		}
-#endif
+		return table_.capacity();
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	typename RHHashMap<Key, Value, MemoryAllocator>::iterator
-		RHHashMap<Key, Value, MemoryAllocator>::begin() const
+	template<class Table>
+	typename MappedTable<Table>::size_type MappedTable<Table>::size() const
 	{
-		for (size_type i = 0; i < end(); ++i) {
-			if (distances_[i].isOccupy()) {
-				return i;
-			}
-		}
-		return end();
+		return table_.size();
 	}
 
+	template<class Table>
+	TableStats MappedTable<Table>::stats() const
+	{
+		return table_.stats();
+	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	typename RHHashMap<Key, Value, MemoryAllocator>::iterator
-		RHHashMap<Key, Value, MemoryAllocator>::next(iterator pos) const
+	template<class Table>
+	bool MappedTable<Table>::valid(size_type pos) const
 	{
-		for (size_type i = pos + 1; i < end(); ++i) {
-			if (distances_[i].isOccupy()) {
-				return i;
-			}
-		}
-		return end();
+		return table_.valid(pos);
+	}
+
+	template<class Table>
+	typename MappedTable<Table>::iterator MappedTable<Table>::find(const_key_param_type key) const
+	{
+		return table_.find(key);
+	}
+
+	template<class Table>
+	void MappedTable<Table>::findBatch(const key_type* keys, size_type n, iterator* out) const
+	{
+		table_.findBatch(keys, n, out);
+	}
+
+	template<class Table>
+	typename MappedTable<Table>::iterator MappedTable<Table>::begin() const
+	{
+		return table_.begin();
+	}
+
+	template<class Table>
+	typename MappedTable<Table>::iterator MappedTable<Table>::next(iterator pos) const
+	{
+		return table_.next(pos);
+	}
+
+	template<class Table>
+	typename MappedTable<Table>::iterator MappedTable<Table>::end() const
+	{
+		return table_.end();
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void RHHashMap<Key, Value, MemoryAllocator>::expand(size_type capacity)
+	template<class Table>
+	typename MappedTable<Table>::const_key_reference MappedTable<Table>::getKey(iterator pos) const
 	{
-		this_type tmp(capacity);
-		size_type end = padded_capacity_;
-		for (size_type i = 0; i != end; ++i) {
-			if (distances_[i].isOccupy()) {
-				tmp.insert(keys_[i], values_[i]);
-			}
-		}
-		tmp.swap(*this);
+		return table_.getKey(pos);
 	}
 
-	//--- SwissTable
-	//-------------------------------------------------------
-	template<class Key, class Value, class MemoryAllocator=DefaultAllocator>
-	class SwissTable
+	template<class Table>
+	typename MappedTable<Table>::const_reference MappedTable<Table>::getValue(iterator pos) const
+	{
+		return table_.getValue(pos);
+	}
+
+	//-----------------------------------------------------------------------------
+	//---
+	//--- FrozenMap
+	//---
+	//-----------------------------------------------------------------------------
+	/**
+	@brief Immutable map over a minimal perfect hash, which is built from another table
+
+	Keys are split into buckets by their hashes, and each bucket gets a pilot which sends its keys to free positions, as in PTHash.
+	Positions are drawn from a few more than size slots to keep the search short, then taken positions beyond size are remapped to free ones below.
+	Pairs are stored densely without empty slots, and a lookup reads one pilot then probes exactly one slot.
+	If 64 bit hashes collide or pilots run out, the build retries with another seed, up to MaxSeeds.
+	*/
+	template<class Key, class Value, class MemoryAllocator = DefaultAllocator, class Layout = SoALayout>
+	class FrozenMap
 	{
 	public:
-		inline static constexpr u32 Invalid = 0xFFFF'FFFFUL;
-		inline static constexpr u32 Align = 4;
-		inline static constexpr u32 AlignMask = Align - 1;
-		inline static constexpr u32 Block = 16;
-		inline static constexpr u32 BlockMask = Block - 1;
-		inline static constexpr u32 Expand = 128;
+		/// Average number of keys in a bucket
+		inline static constexpr u32 BucketSize = 4;
+		/// Ratio of size to positions, in percent
+		inline static constexpr u32 LoadPercent = 99;
+		inline static constexpr u32 MaxPilot = 0xFFFFU;
+		inline static constexpr u32 MaxSeeds = 64;
 
 		typedef Key key_type;
 		typedef Value value_type;
 		typedef MemoryAllocator memory_allocator;
+		typedef Layout layout_policy;
+		typedef typename Layout::template Slots<Key, Value> slots_type;
 
-		typedef SwissTable<Key, Value, MemoryAllocator> this_type;
+		typedef FrozenMap<Key, Value, MemoryAllocator, Layout> this_type;
 
 		typedef u32 size_type;
 		typedef size_type iterator;
 
 		typedef hash_detail::type_traits<value_type> value_traits;
-		typedef typename value_traits::pointer value_pointer;
-		typedef typename value_traits::const_pointer const_value_pointer;
-		typedef typename value_traits::reference value_reference;
-		typedef typename value_traits::const_reference const_value_reference;
-		typedef typename value_traits::pointer pointer;
-		typedef typename value_traits::const_pointer const_pointer;
-		typedef typename value_traits::reference reference;
 		typedef typename value_traits::const_reference const_reference;
-		typedef typename value_traits::param_type value_param_type;
-		typedef typename value_traits::const_param_type const_value_param_type;
-		typedef typename value_traits::lvalue value_lvalue_type;
-
 
 		typedef hash_detail::type_traits<key_type> key_traits;
-		typedef typename key_traits::pointer key_pointer;
-		typedef typename key_traits::const_pointer const_key_pointer;
-		typedef typename key_traits::reference key_reference;
 		typedef typename key_traits::const_reference const_key_reference;
-		typedef typename key_traits::param_type key_param_type;
 		typedef typename key_traits::const_param_type const_key_param_type;
-		typedef typename key_traits::lvalue key_lvalue_type;
-
-		struct Control
-		{
-			inline bool isOccupied() const
-			{
-				return 0 == (0x80U & control_);
-			}
-			uint8_t control_;
-		};
-
-		SwissTable();
-		explicit SwissTable(size_type capacity);
-		~SwissTable();
-
-		void initialize(size_type capacity);
-
-		size_type capacity() const;
-
-		size_type size() const;
 
+		FrozenMap();
+		template<class Table>
+		explicit FrozenMap(const Table& table);
+		/**
+		@param allocator ... copied into the map, every block of the map is drawn from it
+		*/
+		explicit FrozenMap(const memory_allocator& allocator);
+		~FrozenMap();
+
+		/**
+		@brief Replaces contents with the pairs of table, which is walked with begin, next and end
+		@return false if no seed gives a perfect hash within MaxSeeds, which leaves the map empty
+		*/
+		template<class Table>
+		bool build(const Table& table);
 		void clear();
 
+		size_type size() const;
+		/**
+		@brief Every entry is found at its first probe, and bytes include pilots and remaps
+		*/
+		TableStats stats() const;
 		bool valid(size_type pos) const;
 
 		size_type find(const_key_param_type key) const;
 
-		bool insert(const_key_param_type key, const_value_param_type value);
+		/**
+		@brief Transparent version, which takes a key-like K such as std::string_view for std::string keys
+		*/
+		template<class K, hash_detail::transparent_t<Key, K> = 0>
+		size_type find(const K& key) const;
 
-		void erase(const_key_param_type key);
-		void eraseAt(size_type pos);
-		void swap(this_type& rhs);
+		/**
+		@brief Finds n keys at once, out[i] receives the position of keys[i] or end()
 
-		iterator begin() const;
+		Hashes a window of keys and prefetches their pilots, then prefetches their slots before comparing keys.
+		*/
+		void findBatch(const key_type* keys, size_type n, iterator* out) const;
 
+		iterator begin() const;
 		iterator end() const;
-
 		iterator next(iterator pos) const;
 
-		reference getValue(size_type pos);
-
+		const_key_reference getKey(size_type pos) const;
 		const_reference getValue(size_type pos) const;
 
-		key_reference getKey(size_type pos);
-
-		const_key_reference getKey(size_type pos) const;
+		const memory_allocator& getAllocator() const;
+		void swap(this_type& rhs);
 	private:
-		SwissTable(const SwissTable&) = delete;
-		SwissTable& operator=(const SwissTable&) = delete;
-
-		size_type calcHash_(const_key_param_type key) const;
-		static inline size_type align(size_type x, size_type mask);
-
-		void expand(size_type capacity);
-
-		size_type find_(const_key_param_type key, size_type hash) const;
-		void insert_(value_lvalue_type key, key_lvalue_type value);
+		FrozenMap(const this_type&) = delete;
+		this_type& operator=(const this_type&) = delete;
 
-		void create(size_type capacity);
-		void destroy();
-		static u32 leastSignificantBit(u32 x);
-		static u32 next_pos(u32 x);
+		static inline size_type align(size_type x);
+		inline size_type bucketOf(u64 hash) const;
+		inline size_type slotOf(u64 hash, u32 pilot) const;
+		/**
+		@brief Position of a key in [0, size), which holds the key if the map has it
+		*/
+		inline size_type position_(u64 hash) const;
+		template<class K>
+		size_type find_(const K& key, u64 hash) const;
+
+		/**
+		@brief Searches a pilot for each bucket, from the largest bucket
+		@return false if 64 bit hashes collide, or a bucket runs out of pilots
+		@param positions ... receives the position of each key, which may be beyond size
+		@param taken ... bitmap of positions
+		*/
+		bool search_(const u64* hashes, u32* positions, u64* taken);
+		void destroy_();
 
-		size_type capacity_;
 		size_type size_;
-		Control* controls_;
-		key_type* keys_;
-		value_type* values_;
+		size_type buckets_;
+		/// Number of positions drawn by pilots, which is not less than size_
+		size_type positions_;
+		u64 seed_;
+		u16* pilots_;
+		/// Free position in [0, size_) for each position in [size_, positions_)
+		u32* remap_;
+		slots_type slots_;
+		memory_allocator allocator_;
 	};
 
-	template<class Key, class Value, class MemoryAllocator>
-	SwissTable<Key, Value, MemoryAllocator>::SwissTable()
-		:capacity_(0)
-		, size_(0)
-		, controls_(nullptr)
-		, keys_(nullptr)
-		, values_(nullptr)
-	{}
-
-	template<class Key, class Value, class MemoryAllocator>
-	SwissTable<Key, Value, MemoryAllocator>::SwissTable(size_type capacity)
-		:capacity_(0)
-		, size_(0)
-		, controls_(nullptr)
-		, keys_(nullptr)
-		, values_(nullptr)
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	FrozenMap<Key, Value, MemoryAllocator, Layout>::FrozenMap()
+		:size_(0)
+		, buckets_(0)
+		, positions_(0)
+		, seed_(hash_detail::HashSeed)
+		, pilots_(NULL)
+		, remap_(NULL)
+		, allocator_()
 	{
-		create(capacity);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	SwissTable<Key, Value, MemoryAllocator>::~SwissTable()
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	template<class Table>
+	FrozenMap<Key, Value, MemoryAllocator, Layout>::FrozenMap(const Table& table)
+		:size_(0)
+		, buckets_(0)
+		, positions_(0)
+		, seed_(hash_detail::HashSeed)
+		, pilots_(NULL)
+		, remap_(NULL)
+		, allocator_()
 	{
-		destroy();
+		build(table);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void SwissTable<Key, Value, MemoryAllocator>::initialize(size_type capacity)
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	FrozenMap<Key, Value, MemoryAllocator, Layout>::FrozenMap(const memory_allocator& allocator)
+		:size_(0)
+		, buckets_(0)
+		, positions_(0)
+		, seed_(hash_detail::HashSeed)
+		, pilots_(NULL)
+		, remap_(NULL)
+		, allocator_(allocator)
 	{
-		destroy();
-		create(capacity);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	SwissTable<Key, Value, MemoryAllocator>::size_type SwissTable<Key, Value, MemoryAllocator>::capacity() const
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	FrozenMap<Key, Value, MemoryAllocator, Layout>::~FrozenMap()
 	{
-		return capacity_;
+		destroy_();
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	SwissTable<Key, Value, MemoryAllocator>::size_type SwissTable<Key, Value, MemoryAllocator>::size() const
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	template<class Table>
+	bool FrozenMap<Key, Value, MemoryAllocator, Layout>::build(const Table& table)
 	{
-		return size_;
-	}
+		destroy_();
+		size_type n = static_cast<size_type>(table.size());
+		if (n <= 0) {
+			return true;
+		}
+		size_type drawn = static_cast<size_type>((static_cast<u64>(n) * 100 + LoadPercent - 1) / LoadPercent);
+		positions_ = (n < drawn) ? drawn : n + 1;
+		buckets_ = (n + BucketSize - 1) / BucketSize;
+
+		typedef typename Table::iterator table_iterator;
+		table_iterator* sources = HNEW table_iterator[n];
+		size_type count = 0;
+		for (table_iterator i = table.begin(); i != table.end(); i = table.next(i)) {
+			HASSERT(count < n);
+			sources[count++] = i;
+		}
+		HASSERT(count == n);
+
+		size_type size_pilots = align(sizeof(u16) * buckets_);
+		size_type size_remap = align(sizeof(u32) * (positions_ - n));
+		u8* memory = reinterpret_cast<u8*>(HALLOCATOR_MALLOC(allocator_, size_pilots + size_remap + slots_type::bytes(n)));
+		pilots_ = reinterpret_cast<u16*>(memory);
+		remap_ = reinterpret_cast<u32*>(memory + size_pilots);
+		slots_.bind(memory + size_pilots + size_remap, n);
+		size_ = n;
+
+		u64* hashes = reinterpret_cast<u64*>(HALLOCATOR_MALLOC(allocator_, sizeof(u64) * n));
+		u32* positions = reinterpret_cast<u32*>(HALLOCATOR_MALLOC(allocator_, sizeof(u32) * n));
+		u64* taken = reinterpret_cast<u64*>(HALLOCATOR_MALLOC(allocator_, sizeof(u64) * ((positions_ + 63) >> 6)));
+		u64 seed = hash_detail::HashSeed;
+		bool found = false;
+		//Equal keys fail every seed, and distinct keys fail one only by a 64 bit collision or by running out of pilots
+		for (u32 trial = 0; trial < MaxSeeds && !found; ++trial, ++seed) {
+			seed_ = seed;
+			for (size_type i = 0; i < n; ++i) {
+				hashes[i] = hash_detail::calcHash64(table.getKey(sources[i]), seed_);
+			}
+			found = search_(hashes, positions, taken);
+		}
+		if (!found) {
+			HALLOCATOR_FREE(allocator_, taken);
+			HALLOCATOR_FREE(allocator_, positions);
+			HALLOCATOR_FREE(allocator_, hashes);
+			HDELETE_ARRAY(sources);
+			//No slot is constructed yet, so that only the block is freed
+			size_ = 0;
+			destroy_();
+			return false;
+		}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void SwissTable<Key, Value, MemoryAllocator>::clear()
-	{
-		for (size_type i = 0; i < capacity_; ++i) {
-			if (controls_[i].isOccupied()) {
-				keys_[i].~key_type();
-				values_[i].~value_type();
+		//Taken positions beyond size go to free positions below size, one to one
+		size_type cursor = 0;
+		for (size_type i = n; i < positions_; ++i) {
+			remap_[i - n] = 0;
+			if (0 == (taken[i >> 6] & (0x01ULL << (i & 63)))) {
+				continue;
+			}
+			while (0 != (taken[cursor >> 6] & (0x01ULL << (cursor & 63)))) {
+				++cursor;
 			}
+			HASSERT(cursor < n);
+			remap_[i - n] = cursor++;
 		}
-		size_ = 0;
-		::memset(controls_, 0, sizeof(Control) * capacity_);
+		for (size_type i = 0; i < n; ++i) {
+			size_type pos = (positions[i] < n) ? positions[i] : remap_[positions[i] - n];
+			construct(&slots_.key(pos), table.getKey(sources[i]));
+			construct(&slots_.value(pos), table.getValue(sources[i]));
+		}
+
+		HALLOCATOR_FREE(allocator_, taken);
+		HALLOCATOR_FREE(allocator_, positions);
+		HALLOCATOR_FREE(allocator_, hashes);
+		HDELETE_ARRAY(sources);
+		return true;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	bool SwissTable<Key, Value, MemoryAllocator>::valid(size_type pos) const
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	void FrozenMap<Key, Value, MemoryAllocator, Layout>::clear()
 	{
-		return (pos < capacity_);
+		destroy_();
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	SwissTable<Key, Value, MemoryAllocator>::size_type SwissTable<Key, Value, MemoryAllocator>::find(const_key_param_type key) const
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	typename FrozenMap<Key, Value, MemoryAllocator, Layout>::size_type FrozenMap<Key, Value, MemoryAllocator, Layout>::size() const
 	{
-		return (0 < capacity_) ? find_(key, calcHash_(key)) : end();
+		return size_;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	bool SwissTable<Key, Value, MemoryAllocator>::insert(const_key_param_type key, const_value_param_type value)
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	TableStats FrozenMap<Key, Value, MemoryAllocator, Layout>::stats() const
 	{
-		u32 hash = calcHash_(key);
-		if (0 < capacity_ && find_(key, hash) != end()) {
-			return false;
-		}
-		{
-			if (capacity_ <= size_) {
-				expand(capacity_);
-			}
-			HASSERT(size_<capacity_);
-		}
-
-		{
-#if 0
-			u32 h = hash & 0x7FUL;
-			u32 start = (hash & (~BlockMask)) % capacity_;
-			__m128i vh = _mm_set1_epi8((char)0x80);
-			u32 pos = start;
-			do {
-				HASSERT(0 == (pos & BlockMask));
-				__m128i x = _mm_loadu_si128((const __m128i*)(controls_ + pos));
-				__m128i c = _mm_and_epi32(x, vh);
-				for (u32 i = static_cast<u32>(_mm_movemask_epi8(c)); i; i = next_pos(i)) {
-					u32 p = pos + leastSignificantBit(i);
-					if (!controls_[p].isOccupied()) {
-						controls_[p].control_ = static_cast<u8>(h);
-						construct(&keys_[p], std::move(key));
-						construct(&values_[p], std::move(value));
-						++size_;
-						return true;
-					}
-				}
-				pos += Block;
-				pos = (pos < capacity_) ? pos : pos - capacity_;
-			} while (start != pos);
-#else
-			u32 h = hash & 0x7FUL;
-			u32 start = hash % capacity_;
-			u32 pos = start;
-			do {
-				if (!controls_[pos].isOccupied()) {
-					controls_[pos].control_ = static_cast<u8>(h);
-					construct(&keys_[pos], std::move(key));
-					construct(&values_[pos], std::move(value));
-					++size_;
-					return true;
-				}
-				++pos;
-				pos = (pos < capacity_) ? pos : pos - capacity_;
-			} while (start != pos);
-#endif
+		TableStats stats;
+		if (size_ <= 0) {
+			return stats;
 		}
-		return false;
+		stats.bytes_ = align(sizeof(u16) * buckets_) + align(sizeof(u32) * (positions_ - size_)) + slots_type::bytes(size_);
+		stats.capacity_ = size_;
+		stats.size_ = size_;
+		stats.probes_[0] = size_;
+		return stats;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void SwissTable<Key, Value, MemoryAllocator>::erase(const_key_param_type key)
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	bool FrozenMap<Key, Value, MemoryAllocator, Layout>::valid(size_type pos) const
 	{
-		u32 pos = find(key);
-		if(pos == end()){
-			return;
-		}
-		eraseAt(pos);
+		return pos < size_;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void SwissTable<Key, Value, MemoryAllocator>::eraseAt(size_type pos)
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	typename FrozenMap<Key, Value, MemoryAllocator, Layout>::size_type FrozenMap<Key, Value, MemoryAllocator, Layout>::find(const_key_param_type key) const
 	{
-		HASSERT(0<size_);
-		HASSERT(pos<capacity_);
-		HASSERT(controls_[pos].isOccupied());
-		keys_[pos].~key_type();
-		values_[pos].~value_type();
-		controls_[pos].control_ = 0xFEU;
-		--size_;
+		return (0 < size_) ? find_(key, hash_detail::calcHash64(key, seed_)) : end();
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void SwissTable<Key, Value, MemoryAllocator>::swap(this_type& rhs)
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	template<class K, hash_detail::transparent_t<Key, K>>
+	typename FrozenMap<Key, Value, MemoryAllocator, Layout>::size_type FrozenMap<Key, Value, MemoryAllocator, Layout>::find(const K& key) const
 	{
-		(std::swap)(capacity_, rhs.capacity_);
-		(std::swap)(size_, rhs.size_);
-		(std::swap)(controls_, rhs.controls_);
-		(std::swap)(keys_, rhs.keys_);
-		(std::swap)(values_, rhs.values_);
+		return (0 < size_) ? find_(key, hash_detail::calcHash64(key, seed_)) : end();
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	SwissTable<Key, Value, MemoryAllocator>::iterator SwissTable<Key, Value, MemoryAllocator>::begin() const
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	void FrozenMap<Key, Value, MemoryAllocator, Layout>::findBatch(const key_type* keys, size_type n, iterator* out) const
 	{
-		for(u32 i=0; i<capacity_; ++i){
-			if(controls_[i].isOccupied()){
-				return i;
+		if (size_ <= 0) {
+			for (size_type i = 0; i < n; ++i) {
+				out[i] = end();
+			}
+			return;
+		}
+		u64 hashes[hash_detail::PrefetchWindow];
+		size_type positions[hash_detail::PrefetchWindow];
+		for (size_type base = 0; base < n; base += hash_detail::PrefetchWindow) {
+			size_type count = (hash_detail::PrefetchWindow < (n - base)) ? hash_detail::PrefetchWindow : (n - base);
+			for (size_type i = 0; i < count; ++i) {
+				hashes[i] = hash_detail::calcHash64(keys[base + i], seed_);
+				hash_detail::prefetch(&pilots_[bucketOf(hashes[i])]);
+			}
+			for (size_type i = 0; i < count; ++i) {
+				positions[i] = position_(hashes[i]);
+				hash_detail::prefetch(&slots_.key(positions[i]));
+			}
+			for (size_type i = 0; i < count; ++i) {
+				out[base + i] = (keys[base + i] == slots_.key(positions[i])) ? positions[i] : end();
 			}
 		}
-		return end();
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	SwissTable<Key, Value, MemoryAllocator>::iterator SwissTable<Key, Value, MemoryAllocator>::end() const
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	typename FrozenMap<Key, Value, MemoryAllocator, Layout>::iterator FrozenMap<Key, Value, MemoryAllocator, Layout>::begin() const
 	{
-		return Invalid;
+		return 0;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	SwissTable<Key, Value, MemoryAllocator>::iterator SwissTable<Key, Value, MemoryAllocator>::next(iterator pos) const
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	typename FrozenMap<Key, Value, MemoryAllocator, Layout>::iterator FrozenMap<Key, Value, MemoryAllocator, Layout>::end() const
 	{
-		for(u32 i=pos+1; i<capacity_; ++i){
-			if(controls_[i].isOccupied()){
-				return i;
-			}
-		}
-		return end();
+		return size_;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	SwissTable<Key, Value, MemoryAllocator>::reference SwissTable<Key, Value, MemoryAllocator>::getValue(size_type pos)
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	typename FrozenMap<Key, Value, MemoryAllocator, Layout>::iterator FrozenMap<Key, Value, MemoryAllocator, Layout>::next(iterator pos) const
 	{
-		HASSERT(0 <= pos && pos < capacity_);
-		return values_[pos];
+		return pos + 1;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	SwissTable<Key, Value, MemoryAllocator>::const_reference SwissTable<Key, Value, MemoryAllocator>::getValue(size_type pos) const
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	typename FrozenMap<Key, Value, MemoryAllocator, Layout>::const_key_reference FrozenMap<Key, Value, MemoryAllocator, Layout>::getKey(size_type pos) const
 	{
-		HASSERT(0 <= pos && pos < capacity_);
-		return values_[pos];
+		HASSERT(valid(pos));
+		return slots_.key(pos);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	SwissTable<Key, Value, MemoryAllocator>::key_reference SwissTable<Key, Value, MemoryAllocator>::getKey(size_type pos)
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	typename FrozenMap<Key, Value, MemoryAllocator, Layout>::const_reference FrozenMap<Key, Value, MemoryAllocator, Layout>::getValue(size_type pos) const
 	{
-		HASSERT(0 <= pos && pos < capacity_);
-		return keys_[pos];
+		HASSERT(valid(pos));
+		return slots_.value(pos);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	SwissTable<Key, Value, MemoryAllocator>::const_key_reference SwissTable<Key, Value, MemoryAllocator>::getKey(size_type pos) const
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	const typename FrozenMap<Key, Value, MemoryAllocator, Layout>::memory_allocator& FrozenMap<Key, Value, MemoryAllocator, Layout>::getAllocator() const
 	{
-		HASSERT(0 <= pos && pos < capacity_);
-		return keys_[pos];
+		return allocator_;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	SwissTable<Key, Value, MemoryAllocator>::size_type SwissTable<Key, Value, MemoryAllocator>::calcHash_(const_key_param_type key) const
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	void FrozenMap<Key, Value, MemoryAllocator, Layout>::swap(this_type& rhs)
 	{
-		return hash_detail::calcHash(key);
+		hashmap::swap(size_, rhs.size_);
+		hashmap::swap(buckets_, rhs.buckets_);
+		hashmap::swap(positions_, rhs.positions_);
+		hashmap::swap(seed_, rhs.seed_);
+		hashmap::swap(pilots_, rhs.pilots_);
+		hashmap::swap(remap_, rhs.remap_);
+		slots_.swap(rhs.slots_);
+		hashmap::swap(allocator_, rhs.allocator_);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	inline SwissTable<Key, Value, MemoryAllocator>::size_type SwissTable<Key, Value, MemoryAllocator>::align(size_type x, size_type mask)
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	inline typename FrozenMap<Key, Value, MemoryAllocator, Layout>::size_type FrozenMap<Key, Value, MemoryAllocator, Layout>::align(size_type x)
 	{
-		return (x + mask) & (~mask);
+		return (x + hash_detail::CacheLineSize - 1) & ~(hash_detail::CacheLineSize - 1);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void SwissTable<Key, Value, MemoryAllocator>::expand(size_type capacity)
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	inline typename FrozenMap<Key, Value, MemoryAllocator, Layout>::size_type FrozenMap<Key, Value, MemoryAllocator, Layout>::bucketOf(u64 hash) const
 	{
-		u32 newCapacity = hash_detail::next_prime(capacity);
-		this_type tmp;
-		tmp.create(newCapacity);
-
-		for (size_type i = 0; i < capacity_; ++i) {
-			if (controls_[i].isOccupied()) {
-				tmp.insert_(std::move(keys_[i]), std::move(values_[i]));
-			}
-		}
-		tmp.swap(*this);
-	}
-
-	template<class Key, class Value, class MemoryAllocator>
-	SwissTable<Key, Value, MemoryAllocator>::size_type SwissTable<Key, Value, MemoryAllocator>::find_(const_key_param_type key, size_type hash) const
-	{
-		HASSERT(0 == (capacity_ & BlockMask));
-		u32 h = hash & 0x7FUL;
-		u32 start = (hash & (~BlockMask))%capacity_;
-		__m128i vh = _mm_set1_epi8(static_cast<int8_t>(h));
-		u32 pos = start;
-		do {
-			HASSERT(0 == (pos & BlockMask));
-			__m128i x = _mm_loadu_si128((const __m128i*)(controls_ + pos));
-			__m128i c = _mm_cmpeq_epi8(x, vh);
-			for (u32 i = static_cast<u32>(_mm_movemask_epi8(c)); i; i = next_pos(i)) {
-				u32 p = pos + leastSignificantBit(i);
-				if (key == keys_[p]) {
-					return p;
-				}
-			}
-			pos += Block;
-			pos = (pos < capacity_) ? pos : pos - capacity_;
-		} while (start != pos);
-		return end();
+		return static_cast<size_type>((static_cast<u64>(static_cast<u32>(hash)) * buckets_) >> 32);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void SwissTable<Key, Value, MemoryAllocator>::insert_(value_lvalue_type key, key_lvalue_type value)
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	inline typename FrozenMap<Key, Value, MemoryAllocator, Layout>::size_type FrozenMap<Key, Value, MemoryAllocator, Layout>::slotOf(u64 hash, u32 pilot) const
 	{
-#if 0
-		u32 hash = calcHash_(key);
-		HASSERT(find_(key, hash) == end());
-		HASSERT(size_ < capacity_);
-		u32 h = hash & 0x7FUL;
-		u32 start = (hash & (~BlockMask)) % capacity_;
-		__m128i vh = _mm_set1_epi8((char)0x80);
-		u32 pos = start;
-		do {
-			HASSERT(0 == (pos & BlockMask));
-			__m128i x = _mm_loadu_si128((const __m128i*)(controls_ + pos));
-			__m128i c = _mm_and_epi32(x, vh);
-			for (u32 i = static_cast<u32>(_mm_movemask_epi8(c)); i; i = next_pos(i)) {
-				u32 p = pos + leastSignificantBit(i);
-				if (!controls_[p].isOccupied()) {
-					controls_[p].control_ = static_cast<u8>(h);
-					construct(&keys_[p], std::move(key));
-					construct(&values_[p], std::move(value));
-					++size_;
-					return;
-				}
-			}
-			pos += Block;
-			pos = (pos < capacity_) ? pos : pos - capacity_;
-		} while (start != pos);
-		return;
-#else
-		u32 hash = calcHash_(key);
-		HASSERT(find_(key, hash) == end());
-		HASSERT(size_ < capacity_);
-		u32 h = hash & 0x7FUL;
-		u32 start = hash % capacity_;
-		u32 pos = start;
-		do {
-			if (!controls_[pos].isOccupied()) {
-				controls_[pos].control_ = static_cast<u8>(h);
-				construct(&keys_[pos], std::move(key));
-				construct(&values_[pos], std::move(value));
-				++size_;
-				return;
-			}
-			++pos;
-			pos = (pos < capacity_) ? pos : pos - capacity_;
-		} while (start != pos);
-		return;
-#endif
+		u64 x = hash_detail::mix64(hash ^ (pilot * 0x9E37'79B9'7F4A'7C15ULL));
+		return static_cast<size_type>(((x >> 32) * positions_) >> 32);
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void SwissTable<Key, Value, MemoryAllocator>::create(size_type capacity)
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	inline typename FrozenMap<Key, Value, MemoryAllocator, Layout>::size_type FrozenMap<Key, Value, MemoryAllocator, Layout>::position_(u64 hash) const
 	{
-		HASSERT(capacity_ <= 0);
-		HASSERT(size_ <= 0);
-		HASSERT(nullptr == controls_);
-		HASSERT(nullptr == keys_);
-		HASSERT(nullptr == values_);
-		capacity = align(capacity, BlockMask);
-		u64 size_controls = capacity * sizeof(Control);
-		u64 size_keys = capacity * sizeof(key_type);
-		u64 size_values = capacity * sizeof(value_type);
-		u64 total_size = size_controls + size_keys + size_values;
-		u8* memory = reinterpret_cast<u8*>(HALLOCATOR_MALLOC(memory_allocator, total_size));
-		::memset(memory, 0, total_size);
-		controls_ = reinterpret_cast<Control*>(memory);
-		keys_ = reinterpret_cast<key_type*>(memory + size_controls);
-		values_ = reinterpret_cast<value_type*>(memory + size_controls + size_keys);
-		::memset(controls_, 0x80, size_controls);
-		capacity_ = capacity;
+		size_type pos = slotOf(hash, pilots_[bucketOf(hash)]);
+		return (pos < size_) ? pos : remap_[pos - size_];
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	void SwissTable<Key, Value, MemoryAllocator>::destroy()
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	template<class K>
+	typename FrozenMap<Key, Value, MemoryAllocator, Layout>::size_type FrozenMap<Key, Value, MemoryAllocator, Layout>::find_(const K& key, u64 hash) const
 	{
-		for (u32 i = 0; i < capacity_; ++i) {
-			if (controls_[i].isOccupied()) {
-				values_[i].~value_type();
-				keys_[i].~key_type();
-			}
-		}
-		HALLOCATOR_FREE(memory_allocator, controls_);
-		capacity_ = 0;
-		size_ = 0;
-		controls_ = nullptr;
-		keys_ = nullptr;
-		values_ = nullptr;
+		size_type pos = position_(hash);
+		return (key == slots_.key(pos)) ? pos : end();
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	u32 SwissTable<Key, Value, MemoryAllocator>::leastSignificantBit(u32 x)
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	bool FrozenMap<Key, Value, MemoryAllocator, Layout>::search_(const u64* hashes, u32* positions, u64* taken)
 	{
-#if defined(_MSC_VER)
-		unsigned long index;
-		return _BitScanForward(&index, x) ? (u32)index : 0;
-
-#elif defined(__GNUC__)
-		return (0 != x) ? (__builtin_ctzl(x)) : 0;
-#else
-		if (0 == v) {
-			return 0U;
+		size_type n = size_;
+		//Group keys by buckets
+		u32* starts = reinterpret_cast<u32*>(HALLOCATOR_MALLOC(allocator_, sizeof(u32) * (buckets_ + 1)));
+		u32* keys = reinterpret_cast<u32*>(HALLOCATOR_MALLOC(allocator_, sizeof(u32) * n));
+		u32* order = reinterpret_cast<u32*>(HALLOCATOR_MALLOC(allocator_, sizeof(u32) * buckets_));
+		::memset(starts, 0, sizeof(u32) * (buckets_ + 1));
+		for (size_type i = 0; i < n; ++i) {
+			++starts[bucketOf(hashes[i])];
 		}
-		u32 count = (x & 0xAAAAAAAAUL) ? 0x01UL : 0;
-
-		if (x & 0xCCCCCCCCU) {
-			count |= 0x02UL;
+		size_type maxCount = 0;
+		for (size_type b = 0; b < buckets_; ++b) {
+			maxCount = (maxCount < starts[b]) ? starts[b] : maxCount;
+			starts[b] += (0 < b) ? starts[b - 1] : 0;
 		}
-
-		if (x & 0xF0F0F0F0U) {
-			count |= 0x04UL;
+		//Each end of a bucket goes down to its beginning
+		starts[buckets_] = n;
+		for (size_type i = 0; i < n; ++i) {
+			keys[--starts[bucketOf(hashes[i])]] = i;
 		}
 
-		if (x & 0xFF00FF00U) {
-			count |= 0x08UL;
+		//Order buckets from the largest, which is the hardest to place into a fuller table
+		u32* sizes = reinterpret_cast<u32*>(HALLOCATOR_MALLOC(allocator_, sizeof(u32) * (maxCount + 2)));
+		::memset(sizes, 0, sizeof(u32) * (maxCount + 2));
+		for (size_type b = 0; b < buckets_; ++b) {
+			++sizes[maxCount - (starts[b + 1] - starts[b]) + 1];
 		}
-
-		return 31UL - ((x & 0xFFFF0000UL) ? count | 0x10UL : count);
-#endif
+		for (size_type c = 0; c <= maxCount; ++c) {
+			sizes[c + 1] += sizes[c];
+		}
+		for (size_type b = 0; b < buckets_; ++b) {
+			order[sizes[maxCount - (starts[b + 1] - starts[b])]++] = b;
+		}
+		HALLOCATOR_FREE(allocator_, sizes);
+
+		::memset(taken, 0, sizeof(u64) * ((positions_ + 63) >> 6));
+		bool result = true;
+		for (size_type o = 0; o < buckets_ && result; ++o) {
+			size_type b = order[o];
+			const u32* members = keys + starts[b];
+			size_type count = starts[b + 1] - starts[b];
+			pilots_[b] = 0;
+			//Keys of equal hashes go to the same position with any pilot
+			for (size_type i = 1; i < count && result; ++i) {
+				for (size_type j = 0; j < i; ++j) {
+					if (hashes[members[i]] == hashes[members[j]]) {
+						result = false;
+						break;
+					}
+				}
+			}
+			if (count <= 0 || !result) {
+				continue;
+			}
+			u32 pilot = 0;
+			for (; pilot <= MaxPilot; ++pilot) {
+				size_type i = 0;
+				for (; i < count; ++i) {
+					size_type pos = slotOf(hashes[members[i]], pilot);
+					u64 bit = 0x01ULL << (pos & 63);
+					if (0 != (taken[pos >> 6] & bit)) {
+						break;
+					}
+					taken[pos >> 6] |= bit;
+					positions[members[i]] = pos;
+				}
+				if (count <= i) {
+					break;
+				}
+				for (size_type j = 0; j < i; ++j) {
+					taken[positions[members[j]] >> 6] &= ~(0x01ULL << (positions[members[j]] & 63));
+				}
+			}
+			pilots_[b] = static_cast<u16>(pilot);
+			result = (pilot <= MaxPilot);
+		}
+		HALLOCATOR_FREE(allocator_, order);
+		HALLOCATOR_FREE(allocator_, keys);
+		HALLOCATOR_FREE(allocator_, starts);
+		return result;
 	}
 
-	template<class Key, class Value, class MemoryAllocator>
-	u32 SwissTable<Key, Value, MemoryAllocator>::next_pos(u32 x)
+	template<class Key, class Value, class MemoryAllocator, class Layout>
+	void FrozenMap<Key, Value, MemoryAllocator, Layout>::destroy_()
 	{
-		return x & (x - 1);
+		for (size_type i = 0; i < size_; ++i) {
+			slots_.key(i).~key_type();
+			slots_.value(i).~value_type();
+		}
+		HALLOCATOR_FREE(allocator_, pilots_);
+		size_ = 0;
+		buckets_ = 0;
+		positions_ = 0;
+		seed_ = hash_detail::HashSeed;
+		remap_ = NULL;
+		slots_.reset();
 	}
 }
 #endif //INC_HASHMAP_HASHMAP_H__
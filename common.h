@@ -10,6 +10,9 @@
 #include <utility>
 #include <cstdint>
 #include <malloc.h>
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
 
 #ifndef NULL
     #ifdef __cplusplus
@@ -107,22 +110,334 @@ namespace hashmap
     using std::declval;
 
     //---------------------------------------------------------
+    /**
+    @brief Allocates blocks on cache lines, and maps large blocks to 2MB pages
+
+    Each block is preceded by a header, which records how to free it.
+    */
     struct DefaultAllocator
     {
+        static constexpr u64 Alignment = 64;
+        static constexpr bool ThreadSafe = true;
+        static constexpr u64 HugePageSize = 2*1024*1024;
+        /// Blocks of at least this size are backed by transparent huge pages
+        static constexpr u64 HugePageMinimum = 4*HugePageSize;
+
         static inline void* malloc(hashmap::u64 size)
         {
-            return ::malloc(size);
+#if !defined(_WIN32)
+            if(HugePageMinimum <= size){
+                //Reserve one more huge page, for the header and the alignment of the block
+                u64 pages = (size + HugePageSize - 1) & ~(HugePageSize - 1);
+                u64 length = pages + HugePageSize;
+                void* base = ::mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if(MAP_FAILED != base){
+                    u8* mem = align(reinterpret_cast<u8*>(base) + sizeof(Header), HugePageSize);
+#ifdef MADV_HUGEPAGE
+                    ::madvise(mem, pages, MADV_HUGEPAGE);
+#endif
+                    return attach(mem, base, length);
+                }
+            }
+#endif
+            void* base = ::malloc(size + sizeof(Header) + Alignment);
+            if(NULL == base){
+                return NULL;
+            }
+            return attach(align(reinterpret_cast<u8*>(base) + sizeof(Header), Alignment), base, 0);
         }
 
         static inline void free(void* mem)
         {
-            ::free(mem);
+            if(NULL == mem){
+                return;
+            }
+            Header* header = reinterpret_cast<Header*>(mem) - 1;
+#if !defined(_WIN32)
+            if(0 < header->mapped_){
+                ::munmap(header->base_, header->mapped_);
+                return;
+            }
+#endif
+            ::free(header->base_);
+        }
+
+    private:
+        struct Header
+        {
+            void* base_;
+            /// Length of the mapping, or 0 for a block from malloc
+            u64 mapped_;
+        };
+
+        static inline u8* align(u8* ptr, u64 alignment)
+        {
+            return reinterpret_cast<u8*>((reinterpret_cast<uintptr_t>(ptr) + (alignment - 1)) & ~static_cast<uintptr_t>(alignment - 1));
+        }
+
+        static inline void* attach(u8* mem, void* base, u64 mapped)
+        {
+            Header* header = reinterpret_cast<Header*>(mem) - 1;
+            header->base_ = base;
+            header->mapped_ = mapped;
+            return mem;
+        }
+    };
+
+#define HALLOCATOR_MALLOC(allocator, size) (allocator).malloc(size)
+
+#define HALLOCATOR_FREE(allocator, ptr) (allocator).free((ptr));(ptr)=NULL
+
+    //---------------------------------------------------------
+    /**
+    @brief Bump pointer arena, which frees every block at once on release
+
+    Blocks come from DefaultAllocator, and every allocation starts at a cache line.
+    Not thread safe.
+    */
+    class Arena
+    {
+    public:
+        static constexpr u64 DefaultBlockSize = 64*1024;
+        static constexpr u64 Alignment = DefaultAllocator::Alignment;
+
+        explicit Arena(u64 blockSize = DefaultBlockSize)
+            :blocks_(NULL)
+            ,current_(NULL)
+            ,end_(NULL)
+            ,blockSize_(blockSize<Alignment*4? Alignment*4 : blockSize)
+            ,used_(0)
+        {}
+
+        ~Arena()
+        {
+            release();
+        }
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        /**
+        @return NULL if a new block cannot be allocated
+        */
+        void* allocate(u64 size)
+        {
+            size = (size + (Alignment-1)) & ~(Alignment-1);
+            if((blockSize_>>2) < size){
+                //Large requests get own blocks, and keep the current block
+                Block* block = push_(size);
+                if(NULL == block){
+                    return NULL;
+                }
+                used_ += size;
+                return block + 1;
+            }
+            if(static_cast<u64>(end_-current_) < size){
+                Block* block = push_(blockSize_);
+                if(NULL == block){
+                    return NULL;
+                }
+                current_ = reinterpret_cast<u8*>(block + 1);
+                end_ = current_ + blockSize_;
+            }
+            used_ += size;
+            void* mem = current_;
+            current_ += size;
+            return mem;
+        }
+
+        /**
+        @brief Frees every block, all pointers from this arena become invalid
+        */
+        void release()
+        {
+            while(NULL != blocks_){
+                Block* next = blocks_->next_;
+                DefaultAllocator::free(blocks_);
+                blocks_ = next;
+            }
+            current_ = NULL;
+            end_ = NULL;
+            used_ = 0;
+        }
+
+        /**
+        @return bytes handed out since the last release
+        */
+        u64 used() const
+        {
+            return used_;
+        }
+
+    private:
+        struct alignas(Alignment) Block
+        {
+            Block* next_;
+        };
+
+        Block* push_(u64 size)
+        {
+            Block* block = reinterpret_cast<Block*>(DefaultAllocator::malloc(sizeof(Block) + size));
+            if(NULL == block){
+                return NULL;
+            }
+            block->next_ = blocks_;
+            blocks_ = block;
+            return block;
+        }
+
+        Block* blocks_;
+        u8* current_;
+        u8* end_;
+        u64 blockSize_;
+        u64 used_;
+    };
+
+    //---------------------------------------------------------
+    /**
+    @brief Pool of power of two size classes over an arena, which recycles freed blocks in each class
+
+    Not thread safe.
+    */
+    class Pool
+    {
+    public:
+        static constexpr u32 MinShift = 4;
+        static constexpr u32 Classes = 40;
+
+        explicit Pool(u64 blockSize = Arena::DefaultBlockSize)
+            :arena_(blockSize)
+        {
+            for(u32 i=0; i<Classes; ++i){
+                free_[i] = NULL;
+            }
+        }
+
+        Pool(const Pool&) = delete;
+        Pool& operator=(const Pool&) = delete;
+
+        /**
+        @return NULL if the arena cannot allocate a new block
+        */
+        void* allocate(u64 size)
+        {
+            u32 c = classOf(size);
+            Header* header = free_[c];
+            if(NULL != header){
+                free_[c] = header->next_;
+            }else{
+                header = reinterpret_cast<Header*>(arena_.allocate(sizeof(Header) + (1ULL<<(c+MinShift))));
+                if(NULL == header){
+                    return NULL;
+                }
+            }
+            header->class_ = c;
+            return header + 1;
+        }
+
+        void deallocate(void* ptr)
+        {
+            if(NULL == ptr){
+                return;
+            }
+            Header* header = reinterpret_cast<Header*>(ptr) - 1;
+            u32 c = header->class_;
+            header->next_ = free_[c];
+            free_[c] = header;
+        }
+
+        /**
+        @brief Frees every block, all pointers from this pool become invalid
+        */
+        void release()
+        {
+            for(u32 i=0; i<Classes; ++i){
+                free_[i] = NULL;
+            }
+            arena_.release();
         }
+
+        static u32 classOf(u64 size)
+        {
+            u32 c = 0;
+            while((1ULL<<(c+MinShift)) < size){
+                ++c;
+            }
+            HASSERT(c<Classes);
+            return c;
+        }
+
+    private:
+        union alignas(Arena::Alignment) Header
+        {
+            u32 class_;
+            Header* next_;
+        };
+
+        Arena arena_;
+        Header* free_[Classes];
     };
 
-#define HALLOCATOR_MALLOC(allocator, size) allocator::malloc(size)
+    //---------------------------------------------------------
+    /**
+    @brief Allocator handle over an arena, free is no-op and the arena releases every table at once
+    */
+    struct ArenaAllocator
+    {
+        /// Arena is not thread safe, which concurrent tables refuse
+        static constexpr bool ThreadSafe = false;
+
+        ArenaAllocator()
+            :arena_(NULL)
+        {}
+
+        explicit ArenaAllocator(Arena& arena)
+            :arena_(&arena)
+        {}
+
+        inline void* malloc(hashmap::u64 size) const
+        {
+            HASSERT(NULL != arena_);
+            return arena_->allocate(size);
+        }
+
+        inline void free(void*) const
+        {
+        }
+
+        Arena* arena_;
+    };
 
-#define HALLOCATOR_FREE(allocator, ptr) allocator::free((ptr));(ptr)=NULL
+    /**
+    @brief Allocator handle over a pool
+    */
+    struct PoolAllocator
+    {
+        static constexpr bool ThreadSafe = false;
+
+        PoolAllocator()
+            :pool_(NULL)
+        {}
+
+        explicit PoolAllocator(Pool& pool)
+            :pool_(&pool)
+        {}
+
+        inline void* malloc(hashmap::u64 size) const
+        {
+            HASSERT(NULL != pool_);
+            return pool_->allocate(size);
+        }
+
+        inline void free(void* mem) const
+        {
+            if(NULL != mem){
+                pool_->deallocate(mem);
+            }
+        }
+
+        Pool* pool_;
+    };
 
 
     template<class T>
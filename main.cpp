@@ -3,6 +3,10 @@
 #include <random>
 #include <chrono>
 #include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdio>
 
 //#define USE_DENSE_HASHMAP
 
@@ -25,19 +29,6 @@ void createRandomString(std::string& str, size_t length, T& random, U& distribut
     }
 }
 
-namespace hashmap
-{
-    namespace hash_detail
-    {
-        template<>
-        inline u32 calcHash<std::string>(const std::string& x)
-        {
-            return sph::sphash32(static_cast<uint32_t>(x.size()), reinterpret_cast<const void*>(x.c_str()));
-        }
-
-    }
-}
-
 struct Result
 {
     void clear()
@@ -97,6 +88,7 @@ typedef hashmap::HashMap<std::string, std::string> HashMap;
 typedef hashmap::HopscotchHashMap<std::string, std::string> HopscotchHashMap;
 typedef hashmap::RHHashMap<std::string, std::string> RHHashMap;
 typedef hashmap::SwissTable<std::string, std::string> SwissTable;
+typedef hashmap::SwissTable<std::string, std::string, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, hashmap::GroupAvx2> SwissTableAvx2;
 typedef std::unordered_map<std::string, std::string> UnorderedMap;
 #ifdef USE_DENSE_HASHMAP
 typedef google::dense_hash_map<std::string, std::string> DenseHashMap;
@@ -107,8 +99,8 @@ inline void initialize(T&)
 {
 }
 
-template<class T>
-inline bool insert(T& t, const std::string& key, const std::string& value)
+template<class T, class K, class V>
+inline bool insert(T& t, const K& key, const V& value)
 {
     return t.insert(key, value);
 }
@@ -151,8 +143,19 @@ inline size_t capacity(DenseHashMap& t)
 static const int MinKeyLength = 4;
 static const int MaxKeyLength = 16;
 static const int MaxValueLength = 64;
-template<class T>
-Result measure(size_t numSamples, const std::string* keys, const std::string* values)
+
+template<class K>
+inline void checkKey(const K&)
+{
+}
+
+inline void checkKey([[maybe_unused]] const std::string& key)
+{
+    HASSERT(MinKeyLength<=key.length() && key.length()<=MaxKeyLength);
+}
+
+template<class T, class K, class V>
+Result measure(size_t numSamples, const K* keys, const V* values)
 {
     static constexpr double inv = 1.0/1000000000.0;
     typedef T HashMapType;
@@ -187,17 +190,17 @@ Result measure(size_t numSamples, const std::string* keys, const std::string* va
     size_t halfSamples = numSamples>>1;
     start = std::chrono::high_resolution_clock::now();
     for(size_t i=0; i<halfSamples; ++i){
-        HASSERT(MinKeyLength<=keys[i].length() && keys[i].length()<=MaxKeyLength);
+        checkKey(keys[i]);
         hashmap.erase(keys[i]);
         ++result.eraseCount_;
-        HASSERT(MinKeyLength<=keys[i].length() && keys[i].length()<=MaxKeyLength);
+        checkKey(keys[i]);
     }
     end = std::chrono::high_resolution_clock::now();
     result.erase_ = inv * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
 
     start = std::chrono::high_resolution_clock::now();
     for(size_t i=0; i<numSamples; ++i){
-        HASSERT(MinKeyLength<=keys[i].length() && keys[i].length()<=MaxKeyLength);
+        checkKey(keys[i]);
         typename HashMapType::iterator pos = hashmap.find(keys[i]);
         if(hashmap.end() != pos){
             ++result.find1Count_;
@@ -208,6 +211,23 @@ Result measure(size_t numSamples, const std::string* keys, const std::string* va
     return result;
 }
 
+void generate(size_t numSamples, std::string* keys, std::string* values)
+{
+    std::random_device device;
+    std::mt19937 random(device());
+    std::uniform_int_distribution<> distKeyLength(MinKeyLength, MaxKeyLength);
+    std::uniform_int_distribution<> distValueLength(0, MaxValueLength);
+    std::uniform_int_distribution<> distChars(0, (int32_t)(strlen(ASCII)-1));
+    for(size_t i=0; i<numSamples; ++i){
+        size_t keyLength = distKeyLength(random);
+        HASSERT(MinKeyLength<=keyLength && keyLength<=MaxKeyLength);
+        createRandomString(keys[i], keyLength, random, distChars);
+
+        size_t valueLength = distValueLength(random);
+        createRandomString(values[i], valueLength, random, distChars);
+    }
+}
+
 void print(const Result& result, const char* name)
 {
     std::cout << name << std::endl;
@@ -218,6 +238,776 @@ void print(const Result& result, const char* name)
     std::cout << " find1 : " << result.find1_ << " (" << result.find1Count_ << ")" << std::endl;
 }
 
+template<class GrowthPolicy, class IndexPolicy>
+void measurePolicy(const char* name, size_t numSamples, int count)
+{
+    typedef hashmap::HashMap<std::string, std::string, hashmap::DefaultAllocator, GrowthPolicy, IndexPolicy> PolicyHashMap;
+    typedef hashmap::HopscotchHashMap<std::string, std::string, hashmap::u32, hashmap::DefaultAllocator, GrowthPolicy, IndexPolicy> PolicyHopscotchHashMap;
+    typedef hashmap::RHHashMap<std::string, std::string, hashmap::DefaultAllocator, GrowthPolicy, IndexPolicy> PolicyRHHashMap;
+    typedef hashmap::SwissTable<std::string, std::string, hashmap::DefaultAllocator, GrowthPolicy, IndexPolicy> PolicySwissTable;
+
+    Result totalHashMap;
+    Result totalHopscotch;
+    Result totalRobinHood;
+    Result totalSwissTable;
+    totalHashMap.clear();
+    totalHopscotch.clear();
+    totalRobinHood.clear();
+    totalSwissTable.clear();
+    for(int n=0; n<count; ++n){
+        std::string* keys = HNEW std::string[numSamples];
+        std::string* values = HNEW std::string[numSamples];
+        generate(numSamples, keys, values);
+        totalHashMap += measure<PolicyHashMap>(numSamples, keys, values);
+        totalHopscotch += measure<PolicyHopscotchHashMap>(numSamples, keys, values);
+        totalRobinHood += measure<PolicyRHHashMap>(numSamples, keys, values);
+        totalSwissTable += measure<PolicySwissTable>(numSamples, keys, values);
+        HDELETE_ARRAY(values);
+        HDELETE_ARRAY(keys);
+    }
+    double inv = 1.0/count;
+    totalHashMap *= inv;
+    totalHopscotch *= inv;
+    totalRobinHood *= inv;
+    totalSwissTable *= inv;
+
+    std::cout << "--- " << name << std::endl;
+    print(totalHashMap, "HashMap");
+    print(totalHopscotch, "Hopscotch");
+    print(totalRobinHood, "RobinHood");
+    print(totalSwissTable, "SwissTable");
+}
+
+template<size_t Size>
+struct Payload
+{
+    hashmap::u64 data_[Size/sizeof(hashmap::u64)];
+};
+
+template<class Value>
+void measureLayout(const char* name, size_t numSamples, int count)
+{
+    typedef hashmap::HashMap<hashmap::u64, Value, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, hashmap::SoALayout> SoAHashMap;
+    typedef hashmap::HashMap<hashmap::u64, Value, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, hashmap::AoSLayout> AoSHashMap;
+    typedef hashmap::HopscotchHashMap<hashmap::u64, Value, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, false, hashmap::SoALayout> SoAHopscotchHashMap;
+    typedef hashmap::HopscotchHashMap<hashmap::u64, Value, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, false, hashmap::AoSLayout> AoSHopscotchHashMap;
+    typedef hashmap::RHHashMap<hashmap::u64, Value, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, false, hashmap::SoALayout> SoARHHashMap;
+    typedef hashmap::RHHashMap<hashmap::u64, Value, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, false, hashmap::AoSLayout> AoSRHHashMap;
+    typedef hashmap::SwissTable<hashmap::u64, Value, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, hashmap::GroupSse2, false, hashmap::SoALayout> SoASwissTable;
+    typedef hashmap::SwissTable<hashmap::u64, Value, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, hashmap::GroupSse2, false, hashmap::AoSLayout> AoSSwissTable;
+
+    Result total[8];
+    for(int i=0; i<8; ++i){
+        total[i].clear();
+    }
+    std::mt19937_64 random(numSamples);
+    for(int n=0; n<count; ++n){
+        hashmap::u64* keys = HNEW hashmap::u64[numSamples];
+        Value* values = HNEW Value[numSamples];
+        for(size_t i=0; i<numSamples; ++i){
+            keys[i] = random();
+            for(size_t j=0; j<(sizeof(Value)/sizeof(hashmap::u64)); ++j){
+                values[i].data_[j] = keys[i] + j;
+            }
+        }
+        total[0] += measure<SoAHashMap>(numSamples, keys, values);
+        total[1] += measure<AoSHashMap>(numSamples, keys, values);
+        total[2] += measure<SoAHopscotchHashMap>(numSamples, keys, values);
+        total[3] += measure<AoSHopscotchHashMap>(numSamples, keys, values);
+        total[4] += measure<SoARHHashMap>(numSamples, keys, values);
+        total[5] += measure<AoSRHHashMap>(numSamples, keys, values);
+        total[6] += measure<SoASwissTable>(numSamples, keys, values);
+        total[7] += measure<AoSSwissTable>(numSamples, keys, values);
+        HDELETE_ARRAY(values);
+        HDELETE_ARRAY(keys);
+    }
+    static const char* names[8] =
+    {
+        "HashMap (SoA)", "HashMap (AoS)",
+        "Hopscotch (SoA)", "Hopscotch (AoS)",
+        "RobinHood (SoA)", "RobinHood (AoS)",
+        "SwissTable (SoA)", "SwissTable (AoS)",
+    };
+    double inv = 1.0/count;
+    std::cout << "--- " << name << std::endl;
+    for(int i=0; i<8; ++i){
+        total[i] *= inv;
+        print(total[i], names[i]);
+    }
+}
+
+template<class T>
+void measureBatch(const char* name, size_t numSamples, const hashmap::u64* keys)
+{
+    static constexpr double inv = 1.0/1000000000.0;
+    static constexpr size_t BatchSize = 256;
+    std::chrono::high_resolution_clock::time_point start, end;
+
+    T hashmap;
+    start = std::chrono::high_resolution_clock::now();
+    for(size_t i=0; i<numSamples; ++i){
+        hashmap.insert(keys[i], keys[i]);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    double scalarInsert = inv * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+
+    T batchHashmap;
+    start = std::chrono::high_resolution_clock::now();
+    size_t inserted = batchHashmap.insertBatch(keys, keys, static_cast<typename T::size_type>(numSamples));
+    end = std::chrono::high_resolution_clock::now();
+    double batchInsert = inv * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    HASSERT(hashmap.size() == inserted);
+
+    size_t found = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for(size_t i=0; i<numSamples; ++i){
+        if(hashmap.end() != hashmap.find(keys[i])){
+            ++found;
+        }
+    }
+    end = std::chrono::high_resolution_clock::now();
+    double scalar = inv * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+
+    typename T::iterator out[BatchSize];
+    size_t foundBatch = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for(size_t i=0; i<numSamples; i+=BatchSize){
+        size_t n = (BatchSize < (numSamples-i))? BatchSize : (numSamples-i);
+        hashmap.findBatch(keys+i, static_cast<typename T::size_type>(n), out);
+        for(size_t j=0; j<n; ++j){
+            if(hashmap.end() != out[j]){
+                ++foundBatch;
+            }
+        }
+    }
+    end = std::chrono::high_resolution_clock::now();
+    double batch = inv * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    HASSERT(found == foundBatch);
+
+    std::cout << name << std::endl;
+    std::cout << " insert     : " << scalarInsert << " (" << hashmap.size() << ")" << std::endl;
+    std::cout << " insertBatch: " << batchInsert << " (" << inserted << ")" << std::endl;
+    std::cout << " find       : " << scalar << " (" << found << ")" << std::endl;
+    std::cout << " findBatch  : " << batch << " (" << foundBatch << ")" << std::endl;
+}
+
+void measureBatch(size_t numSamples)
+{
+    hashmap::u64* keys = HNEW hashmap::u64[numSamples];
+    std::mt19937_64 random(numSamples);
+    for(size_t i=0; i<numSamples; ++i){
+        keys[i] = random();
+    }
+    std::cout << "--- batched operations" << std::endl;
+    measureBatch<hashmap::HashMap<hashmap::u64, hashmap::u64>>("HashMap", numSamples, keys);
+    measureBatch<hashmap::HopscotchHashMap<hashmap::u64, hashmap::u64>>("Hopscotch", numSamples, keys);
+    measureBatch<hashmap::RHHashMap<hashmap::u64, hashmap::u64>>("RobinHood", numSamples, keys);
+    measureBatch<hashmap::SwissTable<hashmap::u64, hashmap::u64>>("SwissTable", numSamples, keys);
+    HDELETE_ARRAY(keys);
+}
+
+template<class T>
+void measureLatency(const char* name, size_t numSamples, const hashmap::u64* keys)
+{
+    static constexpr double inv = 1.0/1000000000.0;
+    T hashmap;
+    std::chrono::high_resolution_clock::time_point start, end;
+    double total = 0.0;
+    double worst = 0.0;
+    for(size_t i=0; i<numSamples; ++i){
+        start = std::chrono::high_resolution_clock::now();
+        hashmap.insert(keys[i], keys[i]);
+        end = std::chrono::high_resolution_clock::now();
+        double elapsed = inv * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+        total += elapsed;
+        worst = (worst<elapsed)? elapsed : worst;
+    }
+    std::cout << name << std::endl;
+    std::cout << " insert: " << total << " (" << hashmap.size() << ")" << std::endl;
+    std::cout << " worst : " << worst << std::endl;
+}
+
+void measureLatency(size_t numSamples)
+{
+    typedef hashmap::SwissTable<hashmap::u64, hashmap::u64> U64SwissTable;
+    typedef hashmap::HashMap<hashmap::u64, hashmap::u64> U64HashMap;
+    hashmap::u64* keys = HNEW hashmap::u64[numSamples];
+    std::mt19937_64 random(numSamples);
+    for(size_t i=0; i<numSamples; ++i){
+        keys[i] = random();
+    }
+    std::cout << "--- incremental resizing" << std::endl;
+    measureLatency<U64HashMap>("HashMap", numSamples, keys);
+    measureLatency<hashmap::IncrementalResize<U64HashMap>>("HashMap (incremental)", numSamples, keys);
+    measureLatency<U64SwissTable>("SwissTable", numSamples, keys);
+    measureLatency<hashmap::IncrementalResize<U64SwissTable>>("SwissTable (incremental)", numSamples, keys);
+    HDELETE_ARRAY(keys);
+}
+
+/**
+@brief SwissTable behind one global lock, as a baseline of ConcurrentSwissTable
+*/
+class LockedSwissTable
+{
+public:
+    bool insert(hashmap::u64 key, hashmap::u64 value)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return table_.insert(key, value);
+    }
+
+    bool find(hashmap::u64 key, hashmap::u64& value) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        hashmap::u32 pos = table_.find(key);
+        if(pos == table_.end()){
+            return false;
+        }
+        value = table_.getValue(pos);
+        return true;
+    }
+private:
+    mutable std::mutex mutex_;
+    hashmap::SwissTable<hashmap::u64, hashmap::u64> table_;
+};
+
+/**
+@brief Runs func(begin, end) on numThreads threads over disjoint ranges of numSamples, returns elapsed seconds
+*/
+template<class Func>
+double runThreads(size_t numThreads, size_t numSamples, Func func)
+{
+    std::vector<std::thread> threads;
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    for(size_t t=0; t<numThreads; ++t){
+        threads.emplace_back(func, numSamples*t/numThreads, numSamples*(t+1)/numThreads);
+    }
+    for(std::thread& thread : threads){
+        thread.join();
+    }
+    std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+    return 1.0e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+}
+
+template<class T>
+void measureConcurrent(const char* name, size_t numThreads, size_t numSamples, const hashmap::u64* keys)
+{
+    T hashmap;
+    double insertTime = runThreads(numThreads, numSamples, [&hashmap, keys](size_t begin, size_t end){
+        for(size_t i=begin; i<end; ++i){
+            hashmap.insert(keys[i], keys[i]);
+        }
+    });
+    double findTime = runThreads(numThreads, numSamples, [&hashmap, keys](size_t begin, size_t end){
+        hashmap::u64 value;
+        for(size_t i=begin; i<end; ++i){
+            hashmap.find(keys[i], value);
+            checkKey(value);
+        }
+    });
+    std::cout << name << " threads: " << numThreads
+        << " insert: " << (1.0e-6*numSamples/insertTime) << " Mops/s"
+        << " find: " << (1.0e-6*numSamples/findTime) << " Mops/s" << std::endl;
+}
+
+void measureConcurrentBatch(size_t numThreads, size_t numSamples, const hashmap::u64* keys)
+{
+    hashmap::ConcurrentSwissTable<hashmap::u64, hashmap::u64> hashmap;
+    double insertTime = runThreads(numThreads, numSamples, [&hashmap, keys](size_t begin, size_t end){
+        hashmap.insertBatch(keys+begin, keys+begin, static_cast<hashmap::u32>(end-begin));
+    });
+    double findTime = runThreads(numThreads, numSamples, [&hashmap, keys](size_t begin, size_t end){
+        std::vector<hashmap::u64> values(end-begin);
+        bool* found = HNEW bool[end-begin];
+        hashmap.findBatch(keys+begin, static_cast<hashmap::u32>(end-begin), values.data(), found);
+        HDELETE_ARRAY(found);
+    });
+    std::cout << "ConcurrentSwissTable (batch) threads: " << numThreads
+        << " insert: " << (1.0e-6*numSamples/insertTime) << " Mops/s"
+        << " find: " << (1.0e-6*numSamples/findTime) << " Mops/s" << std::endl;
+}
+
+/**
+@brief 99% lookups of existing keys and 1% insertions of new keys
+*/
+template<class T>
+void measureReadMostly(const char* name, size_t numThreads, size_t numSamples, const hashmap::u64* keys)
+{
+    T hashmap;
+    size_t half = numSamples/2;
+    for(size_t i=0; i<half; ++i){
+        hashmap.insert(keys[i], keys[i]);
+    }
+    double time = runThreads(numThreads, half, [&hashmap, keys, half](size_t begin, size_t end){
+        hashmap::u64 value;
+        for(size_t n=0; n<4; ++n){
+            for(size_t i=begin; i<end; ++i){
+                if(0 == (i%100)){
+                    hashmap.insert(keys[half+i], keys[half+i]);
+                }else{
+                    hashmap.find(keys[i], value);
+                    checkKey(value);
+                }
+            }
+        }
+    });
+    std::cout << name << " threads: " << numThreads
+        << " read mostly: " << (1.0e-6*half*4/time) << " Mops/s" << std::endl;
+}
+
+void measureConcurrent(size_t numSamples)
+{
+    hashmap::u64* keys = HNEW hashmap::u64[numSamples];
+    std::mt19937_64 random(numSamples);
+    for(size_t i=0; i<numSamples; ++i){
+        keys[i] = random();
+    }
+    size_t maxThreads = std::thread::hardware_concurrency();
+    maxThreads = (maxThreads<1)? 1 : maxThreads;
+    std::cout << "--- concurrent" << std::endl;
+    for(size_t numThreads=1; numThreads<=maxThreads; numThreads*=2){
+        measureConcurrent<LockedSwissTable>("SwissTable (global lock)", numThreads, numSamples, keys);
+        measureConcurrent<hashmap::ConcurrentSwissTable<hashmap::u64, hashmap::u64>>("ConcurrentSwissTable", numThreads, numSamples, keys);
+        measureConcurrentBatch(numThreads, numSamples, keys);
+    }
+    for(size_t numThreads=1; numThreads<=maxThreads; numThreads*=2){
+        measureReadMostly<LockedSwissTable>("SwissTable (global lock)", numThreads, numSamples, keys);
+        measureReadMostly<hashmap::ConcurrentSwissTable<hashmap::u64, hashmap::u64>>("ConcurrentSwissTable", numThreads, numSamples, keys);
+        measureReadMostly<hashmap::OptimisticSwissTable<hashmap::u64, hashmap::u64>>("OptimisticSwissTable", numThreads, numSamples, keys);
+    }
+    HDELETE_ARRAY(keys);
+}
+
+template<class T>
+void measureRehash(const char* name, size_t numThreads, size_t numSamples, const hashmap::u64* keys)
+{
+    T hashmap;
+    hashmap.setRehashThreads(static_cast<hashmap::u32>(numThreads));
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    for(size_t i=0; i<numSamples; ++i){
+        hashmap.insert(keys[i], keys[i]);
+    }
+    std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+    double time = 1.0e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    std::cout << name << " rehash threads: " << numThreads << " insert: " << time << " (" << hashmap.size() << ")" << std::endl;
+}
+
+void measureRehash(size_t numSamples)
+{
+    hashmap::u64* keys = HNEW hashmap::u64[numSamples];
+    std::mt19937_64 random(numSamples);
+    for(size_t i=0; i<numSamples; ++i){
+        keys[i] = random();
+    }
+    size_t maxThreads = std::thread::hardware_concurrency();
+    maxThreads = (maxThreads<1)? 1 : maxThreads;
+    std::cout << "--- parallel rehash" << std::endl;
+    for(size_t numThreads=1; numThreads<=maxThreads; numThreads*=2){
+        measureRehash<hashmap::HashMap<hashmap::u64, hashmap::u64>>("HashMap", numThreads, numSamples, keys);
+        measureRehash<hashmap::RHHashMap<hashmap::u64, hashmap::u64>>("RobinHood", numThreads, numSamples, keys);
+        measureRehash<hashmap::SwissTable<hashmap::u64, hashmap::u64>>("SwissTable", numThreads, numSamples, keys);
+    }
+    HDELETE_ARRAY(keys);
+}
+
+template<class T>
+void measureBuild(const char* name, size_t numThreads, size_t numSamples, const hashmap::u64* keys)
+{
+    typename T::size_type n = static_cast<typename T::size_type>(numSamples);
+    std::chrono::high_resolution_clock::time_point start, end;
+
+    T scalar;
+    start = std::chrono::high_resolution_clock::now();
+    for(size_t i=0; i<numSamples; ++i){
+        scalar.insert(keys[i], keys[i]);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    double insert = 1.0e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+
+    T batch;
+    start = std::chrono::high_resolution_clock::now();
+    batch.insertBatch(keys, keys, n);
+    end = std::chrono::high_resolution_clock::now();
+    double insertBatch = 1.0e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+
+    T built;
+    start = std::chrono::high_resolution_clock::now();
+    built.build(keys, keys, n, static_cast<hashmap::u32>(numThreads));
+    end = std::chrono::high_resolution_clock::now();
+    double build = 1.0e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    HASSERT(scalar.size() == built.size());
+
+    std::cout << name << " threads: " << numThreads << " insert: " << insert << " insertBatch: " << insertBatch << " build: " << build << " (" << built.size() << ")" << std::endl;
+}
+
+void measureBuild(size_t numSamples)
+{
+    hashmap::u64* keys = HNEW hashmap::u64[numSamples];
+    std::mt19937_64 random(numSamples);
+    for(size_t i=0; i<numSamples; ++i){
+        keys[i] = random();
+    }
+    size_t maxThreads = std::thread::hardware_concurrency();
+    maxThreads = (maxThreads<1)? 1 : maxThreads;
+    std::cout << "--- bulk build" << std::endl;
+    for(size_t numThreads=1; numThreads<=maxThreads; numThreads*=2){
+        measureBuild<hashmap::RHHashMap<hashmap::u64, hashmap::u64>>("RobinHood", numThreads, numSamples, keys);
+        measureBuild<hashmap::SwissTable<hashmap::u64, hashmap::u64>>("SwissTable", numThreads, numSamples, keys);
+    }
+    HDELETE_ARRAY(keys);
+}
+
+template<class T, class M>
+void measureImage(const char* name, const char* path, size_t numSamples, const hashmap::u64* keys)
+{
+    std::chrono::high_resolution_clock::time_point start, end;
+    T table;
+    start = std::chrono::high_resolution_clock::now();
+    for(size_t i=0; i<numSamples; ++i){
+        table.insert(keys[i], keys[i]);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    double insert = 1.0e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    table.saveImage(path);
+    end = std::chrono::high_resolution_clock::now();
+    double save = 1.0e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+
+    M mapped;
+    start = std::chrono::high_resolution_clock::now();
+    mapped.open(path, false);
+    end = std::chrono::high_resolution_clock::now();
+    double open = 1.0e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    mapped.open(path, true);
+    end = std::chrono::high_resolution_clock::now();
+    double verify = 1.0e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+
+    size_t found = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for(size_t i=0; i<numSamples; ++i){
+        if(mapped.end() != mapped.find(keys[i])){
+            ++found;
+        }
+    }
+    end = std::chrono::high_resolution_clock::now();
+    double find = 1.0e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    mapped.close();
+    std::remove(path);
+
+    std::cout << name << " insert: " << insert << " save: " << save << " open: " << open << " open verified: " << verify << " find: " << find << " (" << found << ")" << std::endl;
+}
+
+void measureImage(size_t numSamples)
+{
+    hashmap::u64* keys = HNEW hashmap::u64[numSamples];
+    std::mt19937_64 random(numSamples);
+    for(size_t i=0; i<numSamples; ++i){
+        keys[i] = random();
+    }
+    std::cout << "--- mapped image" << std::endl;
+    measureImage<hashmap::RHHashMap<hashmap::u64, hashmap::u64>, hashmap::MappedRHHashMap<hashmap::u64, hashmap::u64>>("RobinHood", "robinhood.image", numSamples, keys);
+    measureImage<hashmap::SwissTable<hashmap::u64, hashmap::u64>, hashmap::MappedSwissTable<hashmap::u64, hashmap::u64>>("SwissTable", "swisstable.image", numSamples, keys);
+    HDELETE_ARRAY(keys);
+}
+
+/**
+@brief Counts bytes held by a table, to compare memory of tables
+*/
+struct CountingAllocator
+{
+    static void* malloc(hashmap::u64 size)
+    {
+        void* mem = ::malloc(size);
+        bytes_ += usable(mem);
+        return mem;
+    }
+
+    static void free(void* mem)
+    {
+        bytes_ -= usable(mem);
+        ::free(mem);
+    }
+
+    static size_t usable(void* mem)
+    {
+        if(nullptr == mem){
+            return 0;
+        }
+#if defined(_MSC_VER)
+        return _msize(mem);
+#else
+        return malloc_usable_size(mem);
+#endif
+    }
+
+    inline static size_t bytes_ = 0;
+};
+
+template<class T>
+void measureStatic(const char* name, const T& table, size_t bytes, size_t numSamples, const hashmap::u64* keys)
+{
+    size_t found = 0;
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    for(size_t i=0; i<numSamples; ++i){
+        if(table.end() != table.find(keys[i])){
+            ++found;
+        }
+    }
+    std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+    double find = 1.0e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    std::cout << name << " bytes per pair: " << static_cast<double>(bytes)/table.size() << " find: " << find << " (" << found << ")" << std::endl;
+}
+
+template<class T>
+void measureStatic(const char* name, size_t numSamples, const hashmap::u64* keys)
+{
+    size_t before = CountingAllocator::bytes_;
+    T table;
+    for(size_t i=0; i<numSamples; ++i){
+        table.insert(keys[i], keys[i]);
+    }
+    measureStatic(name, table, CountingAllocator::bytes_ - before, numSamples, keys);
+}
+
+void measureFrozen(size_t numSamples)
+{
+    hashmap::u64* keys = HNEW hashmap::u64[numSamples];
+    std::mt19937_64 random(numSamples);
+    for(size_t i=0; i<numSamples; ++i){
+        keys[i] = random();
+    }
+    std::cout << "--- static data" << std::endl;
+    measureStatic<hashmap::HashMap<hashmap::u64, hashmap::u64, CountingAllocator>>("HashMap", numSamples, keys);
+    measureStatic<hashmap::HopscotchHashMap<hashmap::u64, hashmap::u64, hashmap::u32, CountingAllocator>>("Hopscotch", numSamples, keys);
+    measureStatic<hashmap::RHHashMap<hashmap::u64, hashmap::u64, CountingAllocator>>("RobinHood", numSamples, keys);
+    measureStatic<hashmap::SwissTable<hashmap::u64, hashmap::u64, CountingAllocator>>("SwissTable", numSamples, keys);
+
+    hashmap::SwissTable<hashmap::u64, hashmap::u64> source;
+    for(size_t i=0; i<numSamples; ++i){
+        source.insert(keys[i], keys[i]);
+    }
+    size_t before = CountingAllocator::bytes_;
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    hashmap::FrozenMap<hashmap::u64, hashmap::u64, CountingAllocator> frozen(source);
+    std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+    std::cout << "FrozenMap build: " << 1.0e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count() << std::endl;
+    measureStatic("FrozenMap", frozen, CountingAllocator::bytes_ - before, numSamples, keys);
+    HDELETE_ARRAY(keys);
+}
+
+template<class T>
+double measureRequests(size_t numSamples, const typename T::memory_allocator& allocator, const hashmap::u64* keys)
+{
+    static const size_t PerRequest = 64;
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    size_t found = 0;
+    for(size_t i=0; i+PerRequest<=numSamples; i+=PerRequest){
+        T table(allocator);
+        for(size_t j=0; j<PerRequest; ++j){
+            table.insert(keys[i+j], j);
+        }
+        found += (table.end() != table.find(keys[i]))? 1 : 0;
+    }
+    std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+    return 1.0e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+}
+
+template<template<class> class T>
+void measureAllocator(const char* name, size_t numSamples, const hashmap::u64* keys)
+{
+    double time = measureRequests<T<hashmap::DefaultAllocator>>(numSamples, hashmap::DefaultAllocator(), keys);
+    std::cout << name << " default: " << time;
+    hashmap::Arena arena;
+    time = measureRequests<T<hashmap::ArenaAllocator>>(numSamples, hashmap::ArenaAllocator(arena), keys);
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    arena.release();
+    std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+    time += 1.0e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    std::cout << " arena: " << time;
+    hashmap::Pool pool;
+    time = measureRequests<T<hashmap::PoolAllocator>>(numSamples, hashmap::PoolAllocator(pool), keys);
+    std::cout << " pool: " << time << std::endl;
+}
+
+template<class Allocator>
+using RequestHashMap = hashmap::HashMap<hashmap::u64, hashmap::u64, Allocator>;
+template<class Allocator>
+using RequestRHHashMap = hashmap::RHHashMap<hashmap::u64, hashmap::u64, Allocator>;
+template<class Allocator>
+using RequestSwissTable = hashmap::SwissTable<hashmap::u64, hashmap::u64, Allocator>;
+
+void measureAllocators(size_t numSamples)
+{
+    hashmap::u64* keys = HNEW hashmap::u64[numSamples];
+    std::mt19937_64 random(numSamples);
+    for(size_t i=0; i<numSamples; ++i){
+        keys[i] = random();
+    }
+    std::cout << "--- short-lived tables of 64 pairs" << std::endl;
+    measureAllocator<RequestHashMap>("HashMap", numSamples, keys);
+    measureAllocator<RequestRHHashMap>("RobinHood", numSamples, keys);
+    measureAllocator<RequestSwissTable>("SwissTable", numSamples, keys);
+    HDELETE_ARRAY(keys);
+}
+
+/**
+@brief Plain malloc, without the cache line alignment and huge pages of DefaultAllocator
+*/
+struct MallocAllocator
+{
+    static void* malloc(hashmap::u64 size)
+    {
+        return ::malloc(size);
+    }
+
+    static void free(void* mem)
+    {
+        ::free(mem);
+    }
+};
+
+template<class T>
+double measureLookup(size_t count, size_t numSamples, const hashmap::u64* keys)
+{
+    T table(static_cast<typename T::size_type>(count));
+    for(size_t i=0; i<count; ++i){
+        table.insert(keys[i], i);
+    }
+    std::mt19937_64 random(count);
+    size_t found = 0;
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    for(size_t i=0; i<numSamples; ++i){
+        if(table.end() != table.find(keys[random()%count])){
+            ++found;
+        }
+    }
+    std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+    return 1.0e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+}
+
+void measureAligned(size_t numSamples)
+{
+    static const size_t Count = 16*1024*1024;
+    hashmap::u64* keys = HNEW hashmap::u64[Count];
+    std::mt19937_64 random(Count);
+    for(size_t i=0; i<Count; ++i){
+        keys[i] = random();
+    }
+    std::cout << "--- random lookups over " << Count << " pairs" << std::endl;
+    std::cout << "SwissTable malloc: " << measureLookup<hashmap::SwissTable<hashmap::u64, hashmap::u64, MallocAllocator>>(Count, numSamples, keys)
+        << " aligned: " << measureLookup<hashmap::SwissTable<hashmap::u64, hashmap::u64>>(Count, numSamples, keys) << std::endl;
+    std::cout << "RobinHood malloc: " << measureLookup<hashmap::RHHashMap<hashmap::u64, hashmap::u64, MallocAllocator>>(Count, numSamples, keys)
+        << " aligned: " << measureLookup<hashmap::RHHashMap<hashmap::u64, hashmap::u64>>(Count, numSamples, keys) << std::endl;
+    HDELETE_ARRAY(keys);
+}
+
+struct ResizeTrace
+{
+    size_t count_ = 0;
+    hashmap::u64 totalNanoseconds_ = 0;
+    hashmap::u64 longestNanoseconds_ = 0;
+    hashmap::u32 longestCapacity_ = 0;
+};
+
+void traceResize(const hashmap::ResizeEvent& event, void* user)
+{
+    if(hashmap::ResizeEvent::Phase::After != event.phase_){
+        return;
+    }
+    ResizeTrace* trace = reinterpret_cast<ResizeTrace*>(user);
+    ++trace->count_;
+    trace->totalNanoseconds_ += event.nanoseconds_;
+    if(trace->longestNanoseconds_ < event.nanoseconds_){
+        trace->longestNanoseconds_ = event.nanoseconds_;
+        trace->longestCapacity_ = event.newCapacity_;
+    }
+}
+
+template<class T>
+void measureResizes(const char* name, size_t numSamples, const hashmap::u64* keys)
+{
+    ResizeTrace trace;
+    double grown;
+    {
+        T table;
+        table.setResizeObserver(traceResize, &trace);
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        for(size_t i=0; i<numSamples; ++i){
+            table.insert(keys[i], i);
+        }
+        std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+        grown = 1.0e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    }
+    double presized;
+    {
+        T table(T::growth_policy::capacityFor(static_cast<hashmap::u32>(numSamples)));
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        for(size_t i=0; i<numSamples; ++i){
+            table.insert(keys[i], i);
+        }
+        std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+        presized = 1.0e-9 * std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+    }
+    std::cout << name << " resizes: " << trace.count_ << " (" << 1.0e-9*trace.totalNanoseconds_ << ") longest: " << 1.0e-9*trace.longestNanoseconds_
+        << " into " << trace.longestCapacity_ << " build grown: " << grown << " presized: " << presized << std::endl;
+}
+
+void measureResizes(size_t numSamples)
+{
+    hashmap::u64* keys = HNEW hashmap::u64[numSamples];
+    std::mt19937_64 random(numSamples);
+    for(size_t i=0; i<numSamples; ++i){
+        keys[i] = random();
+    }
+    std::cout << "--- resizes while inserting" << std::endl;
+    measureResizes<hashmap::HashMap<hashmap::u64, hashmap::u64>>("HashMap", numSamples, keys);
+    measureResizes<hashmap::HopscotchHashMap<hashmap::u64, hashmap::u64>>("Hopscotch", numSamples, keys);
+    measureResizes<hashmap::RHHashMap<hashmap::u64, hashmap::u64>>("RobinHood", numSamples, keys);
+    measureResizes<hashmap::SwissTable<hashmap::u64, hashmap::u64>>("SwissTable", numSamples, keys);
+    HDELETE_ARRAY(keys);
+}
+
+#ifdef HASHMAP_ENABLE_COUNTERS
+template<class T>
+void measureCounters(const char* name, size_t numSamples, const hashmap::u64* keys)
+{
+    T table;
+    hashmap::resetCounters();
+    for(size_t i=0; i<numSamples; ++i){
+        table.insert(keys[i], i);
+    }
+    hashmap::Counters insert = hashmap::threadCounters();
+    hashmap::resetCounters();
+    for(size_t i=0; i<numSamples; ++i){
+        table.find(keys[i]);
+        table.find(~keys[i]);
+    }
+    hashmap::Counters find = hashmap::threadCounters();
+    double inv = 1.0/numSamples;
+    std::cout << name << " insert probes: " << insert.probes_*inv << " compares: " << insert.compares_*inv
+        << " displacements: " << insert.displacements_*inv << " resizes: " << insert.resizes_ << " (" << 1.0e-9*insert.resizeNanoseconds_ << ")" << std::endl;
+    std::cout << name << " find probes: " << find.probes_*inv*0.5 << " compares: " << find.compares_*inv*0.5 << " false matches: " << find.falseMatches_*inv*0.5 << std::endl;
+}
+
+void measureCounters(size_t numSamples)
+{
+    hashmap::u64* keys = HNEW hashmap::u64[numSamples];
+    std::mt19937_64 random(numSamples);
+    for(size_t i=0; i<numSamples; ++i){
+        keys[i] = random();
+    }
+    std::cout << "--- counters per operation, half of finds miss" << std::endl;
+    measureCounters<hashmap::HashMap<hashmap::u64, hashmap::u64>>("HashMap", numSamples, keys);
+    measureCounters<hashmap::HopscotchHashMap<hashmap::u64, hashmap::u64>>("Hopscotch", numSamples, keys);
+    measureCounters<hashmap::RHHashMap<hashmap::u64, hashmap::u64>>("RobinHood", numSamples, keys);
+    measureCounters<hashmap::SwissTable<hashmap::u64, hashmap::u64>>("SwissTable", numSamples, keys);
+    HDELETE_ARRAY(keys);
+}
+#endif
+
 int main(int argc, char** argv)
 {
     size_t numSamples = 100000;//10000000;//1000;
@@ -235,11 +1025,13 @@ int main(int argc, char** argv)
     Result totalHopscotch;
     Result totalRobinHood;
     Result totalSwissTable;
+    Result totalSwissTableAvx2;
     Result totalUnordered;
     totalHashMap.clear();
     totalHopscotch.clear();
     totalRobinHood.clear();
     totalSwissTable.clear();
+    totalSwissTableAvx2.clear();
     totalUnordered.clear();
 
 #ifdef USE_DENSE_HASHMAP
@@ -250,21 +1042,7 @@ int main(int argc, char** argv)
     for(size_t n=0; n<count; ++n){
         std::string* keys = HNEW std::string[numSamples];
         std::string* values = HNEW std::string[numSamples];
-        {
-            std::random_device device;
-            std::mt19937 random(device());
-            std::uniform_int_distribution<> distKeyLength(MinKeyLength, MaxKeyLength);
-            std::uniform_int_distribution<> distValueLength(0, MaxValueLength);
-            std::uniform_int_distribution<> distChars(0, (int32_t)(strlen(ASCII)-1));
-            for(size_t i=0; i<numSamples; ++i){
-                size_t keyLength = distKeyLength(random);
-                HASSERT(MinKeyLength<=keyLength && keyLength<=MaxKeyLength);
-                createRandomString(keys[i], keyLength, random, distChars);
-
-                size_t valueLength = distValueLength(random);
-                createRandomString(values[i], valueLength, random, distChars);
-            }
-        }
+        generate(numSamples, keys, values);
 
         
 
@@ -277,6 +1055,8 @@ int main(int argc, char** argv)
         totalRobinHood += result;
         result = measure<SwissTable>(numSamples, keys, values);
         totalSwissTable += result;
+        result = measure<SwissTableAvx2>(numSamples, keys, values);
+        totalSwissTableAvx2 += result;
         result = measure<UnorderedMap>(numSamples, keys, values);
         totalUnordered += result;
 #ifdef USE_DENSE_HASHMAP
@@ -292,17 +1072,40 @@ int main(int argc, char** argv)
     totalHopscotch *= inv;
     totalRobinHood *= inv;
     totalSwissTable *= inv;
+    totalSwissTableAvx2 *= inv;
     totalUnordered *= inv;
 
     print(totalHashMap, "HashMap");
     print(totalHopscotch, "Hopscotch");
     print(totalRobinHood, "RobinHood");
     print(totalSwissTable, "SwissTable");
+    print(totalSwissTableAvx2, "SwissTable (AVX2)");
     print(totalUnordered, "std::unordered_map");
 
 #ifdef USE_DENSE_HASHMAP
     totalDenseHashMap *= inv;
     print(totalDenseHashMap, "dense_hash_map");
 #endif
+
+    measurePolicy<hashmap::GrowthPolicy<50, 200>, hashmap::PrimeIndexPolicy>("max load: 50%, growth: 200%", numSamples, count);
+    measurePolicy<hashmap::GrowthPolicy<75, 200>, hashmap::PrimeIndexPolicy>("max load: 75%, growth: 200%", numSamples, count);
+    measurePolicy<hashmap::GrowthPolicy<95, 150>, hashmap::PrimeIndexPolicy>("max load: 95%, growth: 150%", numSamples, count);
+    measurePolicy<hashmap::DefaultGrowthPolicy, hashmap::MaskIndexPolicy>("index: power of two mask", numSamples, count);
+    measurePolicy<hashmap::DefaultGrowthPolicy, hashmap::FibonacciIndexPolicy>("index: power of two Fibonacci", numSamples, count);
+    measureLayout<Payload<16>>("layout: 8 byte key, 16 byte value", numSamples, count);
+    measureLayout<Payload<256>>("layout: 8 byte key, 256 byte value", numSamples, count);
+    measureBatch(numSamples);
+    measureLatency(numSamples);
+    measureConcurrent(numSamples);
+    measureRehash(numSamples);
+    measureBuild(numSamples);
+    measureImage(numSamples);
+    measureFrozen(numSamples);
+    measureAllocators(numSamples);
+    measureAligned(numSamples);
+    measureResizes(numSamples);
+#ifdef HASHMAP_ENABLE_COUNTERS
+    measureCounters(numSamples);
+#endif
     return 0;
 }
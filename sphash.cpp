@@ -51,7 +51,9 @@ For more information, please refer to <http://unlicense.org>
 */
 #include "sphash.h"
 #include <cstring>
+#if defined(_MSC_VER)
 #include <intrin.h>
+#endif
 
 namespace sph
 {
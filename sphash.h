@@ -51,6 +51,7 @@ OTHER DEALINGS IN THE SOFTWARE.
 
 For more information, please refer to <http://unlicense.org>
 */
+#include <cstddef>
 #include <cstdint>
 
 namespace sph
@@ -1,19 +1,763 @@
 #include <string>
+#include <string_view>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <cstdio>
 #include "HashMap.h"
 
-namespace hashmap
+template<class T>
+void testGrowthPolicy()
 {
-    namespace hash_detail
-    {
-        template<>
-        inline u32 calcHash<std::string>(const std::string& x)
-        {
-            return sph::sphash32(static_cast<uint32_t>(x.size()), reinterpret_cast<const void*>(x.c_str()));
-        }
+	typedef typename T::growth_policy growth_policy;
+	T table;
+	static constexpr hashmap::u32 Count = 2000;
+	for(hashmap::u32 i=0; i<Count; ++i){
+		bool result = table.insert(i, i);
+		assert(result);
+		assert(table.size() <= growth_policy::maxSize(table.capacity()));
+	}
+	assert(growth_policy::Minimum <= table.capacity());
+	for(hashmap::u32 i=0; i<Count; ++i){
+		hashmap::u32 pos = table.find(i);
+		assert(pos != table.end());
+		assert(table.getValue(pos) == i);
+	}
+}
+
+template<class T>
+void testFindBatch()
+{
+	T table;
+	static constexpr hashmap::u32 Count = 1000;
+	hashmap::u32 keys[Count*2];
+	hashmap::u32 out[Count*2];
+	for(hashmap::u32 i=0; i<Count*2; ++i){
+		keys[i] = i;
+	}
+	table.findBatch(keys, Count, out);
+	for(hashmap::u32 i=0; i<Count; ++i){
+		assert(out[i] == table.end());
+	}
+	for(hashmap::u32 i=0; i<Count; ++i){
+		table.insert(i, i*3);
+	}
+	table.findBatch(keys, Count*2, out);
+	for(hashmap::u32 i=0; i<Count*2; ++i){
+		assert(out[i] == table.find(i));
+		assert((out[i] == table.end()) == (Count <= i));
+		assert(out[i] == table.end() || table.getValue(out[i]) == i*3);
+	}
+	table.findBatch(keys + 3, 5, out);
+	for(hashmap::u32 i=0; i<5; ++i){
+		assert(table.getValue(out[i]) == (i+3)*3);
+	}
+}
+
+template<class T>
+void testInsertBatch()
+{
+	typedef typename T::growth_policy growth_policy;
+	static constexpr hashmap::u32 Count = 100000;
+	hashmap::u32* keys = new hashmap::u32[Count];
+	hashmap::u32* values = new hashmap::u32[Count];
+	for(hashmap::u32 i=0; i<Count; ++i){
+		keys[i] = i/2;
+		values[i] = i;
+	}
+	T table;
+	table.insert(7, 1234);
+	hashmap::u32 inserted = table.insertBatch(keys, values, Count);
+	assert(inserted == Count/2 - 1);
+	assert(table.size() == Count/2);
+	assert(table.size() <= growth_policy::maxSize(table.capacity()));
+	assert(table.getValue(table.find(7)) == 1234);
+	for(hashmap::u32 i=0; i<Count/2; ++i){
+		hashmap::u32 pos = table.find(i);
+		assert(pos != table.end());
+		assert(i == 7 || table.getValue(pos) == i*2);
+	}
+	assert(table.find(Count) == table.end());
+	inserted = table.insertBatch(keys, values, 0);
+	assert(0 == inserted);
+	delete[] values;
+	delete[] keys;
+}
+
+template<class T>
+void testTransparent()
+{
+	static_assert(!hashmap::hash_detail::is_transparent<hashmap::u32, std::string_view>::value, "only string keys are transparent");
+	T table;
+	const char* buffer = "alpha,beta,gamma";
+	assert(table.find(std::string_view(buffer, 5)) == table.end());
+	bool result = table.insert(std::string("alpha"), 1);
+	assert(result);
+	result = table.insert(std::string_view(buffer + 6, 4), 2);
+	assert(result);
+	result = table.insert(std::string_view(buffer, 5), 3);
+	assert(!result);
+	assert(table.size() == 2);
+
+	hashmap::u32 pos = table.find(std::string_view(buffer, 5));
+	assert(pos != table.end());
+	assert(table.getValue(pos) == 1);
+	pos = table.find(std::string("beta"));
+	assert(pos != table.end());
+	assert(table.getValue(pos) == 2);
+	assert(table.find(std::string_view(buffer + 11, 5)) == table.end());
+
+	table.erase(std::string_view(buffer + 6, 4));
+	assert(table.find(std::string("beta")) == table.end());
+	assert(table.size() == 1);
+}
+
+struct Counted
+{
+	static int copies_;
+
+	Counted()
+		:a_(0)
+		,b_(0)
+	{}
+
+	Counted(int a, int b)
+		:a_(a)
+		,b_(b)
+	{}
+
+	explicit Counted(std::string&& x)
+		:a_(static_cast<int>(x.size()))
+		,b_(0)
+	{
+		x.clear();
+	}
+
+	Counted(const Counted& x)
+		:a_(x.a_)
+		,b_(x.b_)
+	{
+		++copies_;
+	}
+
+	Counted(Counted&&) = default;
+
+	Counted& operator=(const Counted& x)
+	{
+		a_ = x.a_;
+		b_ = x.b_;
+		++copies_;
+		return *this;
+	}
+
+	Counted& operator=(Counted&&) = default;
+
+	int a_;
+	int b_;
+};
+
+int Counted::copies_ = 0;
+
+template<class T>
+void testEmplace()
+{
+	T table;
+	Counted::copies_ = 0;
+	static constexpr int Count = 1000;
+	for(int i=0; i<Count; i+=2){
+		bool result = table.insert(std::to_string(i), Counted(i, 0));
+		assert(result);
+	}
+	for(int i=1; i<Count; i+=2){
+		bool result = table.emplace(std::to_string(i), i, 1);
+		assert(result);
+	}
+	assert(table.size() == Count);
+	assert(0 == Counted::copies_);
+	for(int i=0; i<Count; ++i){
+		hashmap::u32 pos = table.find(std::to_string(i));
+		assert(pos != table.end());
+		assert(table.getValue(pos).a_ == i && table.getValue(pos).b_ == (i&1));
+	}
+
+	std::string arg("untouched");
+	bool result = table.try_emplace(std::string("7"), std::move(arg));
+	assert(!result);
+	assert(arg == "untouched");
+	result = table.emplace("8", -1, -1);
+	assert(!result);
+	assert(table.getValue(table.find(std::string("8"))).a_ == 8);
+	result = table.try_emplace(std::string("new"), std::move(arg));
+	assert(result);
+	assert(arg.empty());
+	assert(table.getValue(table.find(std::string("new"))).a_ == 9);
+	const std::string key("const");
+	result = table.try_emplace(key, 3, 4);
+	assert(result);
+	result = table.emplace(std::string_view("view"), 5, 6);
+	assert(result);
+	assert(table.getValue(table.find(std::string("view"))).b_ == 6);
+	assert(0 == Counted::copies_);
+}
+
+template<class T, bool ExpectMigration = true>
+void testIncrementalResize()
+{
+	typedef typename T::growth_policy growth_policy;
+	T table;
+	static constexpr hashmap::u32 Count = 20000;
+	bool migrated = false;
+	for(hashmap::u32 i=0; i<Count; ++i){
+		bool wasMigrating = table.migrating();
+		hashmap::u32 capacity = table.capacity();
+		bool result = table.insert(i, i+1);
+		assert(result);
+		result = table.insert(i, i);
+		assert(!result);
+		assert(table.size() == i+1);
+		//The new table does not grow by its load while the old one drains
+		assert(!wasMigrating || !table.migrating() || capacity == table.capacity());
+		migrated = migrated || table.migrating();
+		if(0 == (i%97)){
+			typename T::iterator pos = table.find(i/2);
+			assert(pos != table.end());
+			assert(table.getValue(pos) == i/2+1);
+		}
+	}
+	assert(migrated || !ExpectMigration);
+	assert(table.size() <= growth_policy::maxSize(table.capacity()));
+	for(hashmap::u32 i=0; i<Count; i+=3){
+		table.erase(i);
+	}
+	hashmap::u32 count = 0;
+	for(typename T::iterator pos = table.begin(); pos != table.end(); pos = table.next(pos)){
+		assert(0 != (table.getKey(pos)%3));
+		assert(table.getValue(pos) == table.getKey(pos)+1);
+		++count;
+	}
+	assert(count == table.size());
+	for(hashmap::u32 i=0; i<Count+100; ++i){
+		typename T::iterator pos = table.find(i);
+		assert((pos != table.end()) == (i<Count && 0 != (i%3)));
+	}
+	while(table.migrating()){
+		table.erase(Count);
+	}
+	table.clear();
+	assert(0 == table.size());
+	assert(table.find(1) == table.end());
+}
+
+template<class T>
+void testConcurrent()
+{
+	static constexpr hashmap::u32 Threads = 4;
+	static constexpr hashmap::u32 Count = 20000;
+	T table;
+	std::vector<std::thread> threads;
+	//Every thread inserts all keys, so that each key is inserted exactly once among them
+	for(hashmap::u32 t=0; t<Threads; ++t){
+		threads.emplace_back([&table](){
+			for(hashmap::u32 i=0; i<Count; ++i){
+				table.insert(i, i+1);
+			}
+		});
+	}
+	for(std::thread& thread : threads){
+		thread.join();
+	}
+	threads.clear();
+	assert(table.size() == Count);
+
+	//Threads erase disjoint thirds while others read
+	for(hashmap::u32 t=0; t<Threads; ++t){
+		threads.emplace_back([&table, t](){
+			for(hashmap::u32 i=t; i<Count; i+=Threads){
+				if(0 == (i%3)){
+					bool result = table.erase(i);
+					assert(result);
+				}
+				hashmap::u32 value = 0;
+				if(table.find(i+1, value)){
+					assert(value == i+2);
+				}
+			}
+		});
+	}
+	for(std::thread& thread : threads){
+		thread.join();
+	}
+	for(hashmap::u32 i=0; i<Count; ++i){
+		assert(table.contains(i) == (0 != (i%3)));
+	}
+
+	std::vector<hashmap::u32> keys(Count*2);
+	std::vector<hashmap::u32> values(Count*2);
+	for(hashmap::u32 i=0; i<Count*2; ++i){
+		keys[i] = i;
+		values[i] = i+1;
+	}
+	hashmap::u32 remaining = Count*2 - table.size();
+	hashmap::u32 inserted = table.insertBatch(keys.data(), values.data(), Count*2);
+	assert(inserted == remaining);
+	assert(table.size() == Count*2);
+
+	//Shards should not crowd homes compared to a single table
+	typename T::table_type single;
+	for(hashmap::u32 i=0; i<Count*2; ++i){
+		single.insert(i, i+1);
+	}
+	assert(table.stats().meanProbe() <= single.stats().meanProbe()*2 + 0.25);
+
+	std::vector<hashmap::u32> found(Count*2, 0);
+	bool* hits = new bool[Count*2+1];
+	keys.push_back(Count*2);
+	hashmap::u32 hitCount = table.findBatch(keys.data(), Count*2+1, found.data(), hits);
+	assert(hitCount == Count*2);
+	for(hashmap::u32 i=0; i<Count*2; ++i){
+		assert(hits[i]);
+		assert(found[i] == i+1);
+	}
+	assert(!hits[Count*2]);
+	delete[] hits;
+	table.clear();
+	assert(0 == table.size());
+	assert(!table.contains(1));
+}
+
+template<class T>
+void testShardHomes()
+{
+	//Keys of one shard grow it past 2^(25-ShardBits) slots, beyond which h1 would not reach every home if its high bits chose the shard
+	static constexpr hashmap::u32 Count = 200000;
+	T table;
+	hashmap::u32 inserted = 0;
+	for(hashmap::u32 i=0; inserted<Count; ++i){
+		if(0 == T::shardOf(hashmap::hash_detail::calcHash(i))){
+			bool result = table.insert(i, i+1);
+			assert(result);
+			++inserted;
+		}
+	}
+	assert(((1U<<25)/T::Shards) < table.capacity());
+
+	typename T::table_type single;
+	for(hashmap::u32 i=0; i<Count; ++i){
+		bool result = single.insert(i, i+1);
+		assert(result);
+	}
+	assert(table.stats().meanProbe() <= single.stats().meanProbe()*2 + 0.25);
+}
+
+template<class T>
+void testOptimistic()
+{
+	static constexpr hashmap::u32 Count = 20000;
+	T table;
+	hashmap::u32 value = 0;
+	bool result = table.find(0, value);
+	assert(!result);
+	for(hashmap::u32 i=0; i<Count; ++i){
+		result = table.insert(i, i+1);
+		assert(result);
+		result = table.insert(i, i);
+		assert(!result);
+	}
+	assert(table.size() == Count);
+	for(hashmap::u32 i=0; i<Count; i+=3){
+		result = table.erase(i);
+		assert(result);
+		result = table.erase(i);
+		assert(!result);
+	}
+	//Reinserting fills tombstones, which are reclaimed by a new table of the same capacity
+	for(hashmap::u32 n=0; n<4; ++n){
+		for(hashmap::u32 i=0; i<Count; i+=3){
+			result = table.insert(i, i+1);
+			assert(result);
+		}
+		for(hashmap::u32 i=0; i<Count; i+=3){
+			result = table.erase(i);
+			assert(result);
+		}
+	}
+	for(hashmap::u32 i=0; i<Count+100; ++i){
+		value = Count*4;
+		result = table.find(i, value);
+		assert(result == (i<Count && 0 != (i%3)));
+		assert(table.contains(i) == result);
+		//A miss leaves the value as it was
+		assert(value == (result ? i+1 : Count*4));
+	}
+
+	//Readers see every stable key, while a writer grows, erases and reinserts others
+	std::vector<std::thread> threads;
+	std::atomic<bool> done(false);
+	for(hashmap::u32 t=0; t<3; ++t){
+		threads.emplace_back([&table, &done](){
+			while(!done.load()){
+				for(hashmap::u32 i=1; i<Count*3; i+=7){
+					hashmap::u32 value = 0;
+					bool found = table.find(i, value);
+					assert(!found || value == i+1);
+					assert(found || Count<=i || 0 == (i%3));
+				}
+			}
+		});
+	}
+	for(hashmap::u32 i=Count; i<Count*3; ++i){
+		result = table.insert(i, i+1);
+		assert(result);
+		if(0 == (i%2)){
+			result = table.erase(i);
+			assert(result);
+		}
+	}
+	done.store(true);
+	for(std::thread& thread : threads){
+		thread.join();
+	}
+	assert(table.size() == (Count - (Count+2)/3) + Count);
+	table.clear();
+	assert(0 == table.size());
+	assert(!table.contains(1));
+}
+
+template<class T>
+void testParallelRehash()
+{
+	static constexpr hashmap::u32 Count = 300000;
+	T table;
+	table.setRehashThreads(4);
+	assert(4 == table.getRehashThreads());
+	for(hashmap::u32 i=0; i<Count; ++i){
+		bool result = table.insert(i*7, i);
+		assert(result);
+	}
+	assert(table.size() == Count);
+	assert(4 == table.getRehashThreads());
+	for(hashmap::u32 i=0; i<Count; ++i){
+		hashmap::u32 pos = table.find(i*7);
+		assert(pos != table.end());
+		assert(table.getValue(pos) == i);
+		assert(table.find(i*7+1) == table.end());
+	}
+	for(hashmap::u32 i=0; i<Count; i+=2){
+		table.erase(i*7);
+	}
+	hashmap::u32 count = 0;
+	for(hashmap::u32 pos = table.begin(); pos != table.end(); pos = table.next(pos)){
+		assert(1 == (table.getValue(pos)%2));
+		++count;
+	}
+	assert(count == Count/2);
+	table.setRehashThreads(0);
+	assert(1 == table.getRehashThreads());
+}
+
+template<class T>
+void testBuild(hashmap::u32 threads)
+{
+	static constexpr hashmap::u32 Count = 200000;
+	//Every key appears twice, and the first one wins
+	std::vector<hashmap::u32> keys(Count*2);
+	std::vector<hashmap::u32> values(Count*2);
+	for(hashmap::u32 i=0; i<Count; ++i){
+		keys[i] = i*7;
+		values[i] = i;
+		keys[Count*2-1-i] = i*7;
+		values[Count*2-1-i] = i+1;
+	}
+	T table;
+	table.insert(1, 1);
+	hashmap::u32 built = table.build(keys.data(), values.data(), Count*2, threads);
+	assert(Count == built);
+	assert(table.size() == Count);
+	assert(table.find(1) == table.end());
+	for(hashmap::u32 i=0; i<Count; ++i){
+		hashmap::u32 pos = table.find(i*7);
+		assert(pos != table.end());
+		assert(table.getValue(pos) == i);
+	}
+	//Sorted input and a smaller one into the same table
+	for(hashmap::u32 i=0; i<Count; ++i){
+		keys[i] = i;
+	}
+	built = table.build(keys.data(), values.data(), Count, threads);
+	assert(Count == built);
+	for(hashmap::u32 i=0; i<Count; ++i){
+		assert(table.getValue(table.find(i)) == values[i]);
+	}
+	built = table.build(keys.data(), values.data(), 10, threads);
+	assert(10 == built);
+	built = table.build(keys.data(), values.data(), 0, threads);
+	assert(0 == built);
+	assert(table.find(0) == table.end());
+	bool result = table.insert(0, 0);
+	assert(result);
+}
+
+template<class T, class M>
+void testImage(const char* path)
+{
+	static constexpr hashmap::u32 Count = 50000;
+	T table;
+	for(hashmap::u32 i=0; i<Count; ++i){
+		bool result = table.insert(i*7, i);
+		assert(result);
+	}
+	for(hashmap::u32 i=0; i<Count; i+=3){
+		table.erase(i*7);
+	}
+	bool result = table.saveImage(path);
+	assert(result);
+
+	M mapped;
+	assert(!mapped.isOpen());
+	result = mapped.open(path);
+	assert(result);
+	assert(mapped.isOpen());
+	assert(mapped.size() == table.size());
+	assert(mapped.capacity() == table.capacity());
+	for(hashmap::u32 i=0; i<Count; ++i){
+		hashmap::u32 pos = mapped.find(i*7);
+		if(0 == (i%3)){
+			assert(pos == mapped.end());
+		}else{
+			assert(pos != mapped.end());
+			assert(mapped.getKey(pos) == i*7);
+			assert(mapped.getValue(pos) == i);
+		}
+		assert(mapped.find(i*7+1) == mapped.end());
+	}
+	hashmap::u32 keys[3] = {7, 14, 15};
+	hashmap::u32 out[3];
+	mapped.findBatch(keys, 3, out);
+	assert(mapped.getValue(out[0]) == 1 && mapped.getValue(out[1]) == 2 && out[2] == mapped.end());
+	hashmap::u32 count = 0;
+	for(hashmap::u32 pos = mapped.begin(); pos != mapped.end(); pos = mapped.next(pos)){
+		++count;
+	}
+	assert(count == table.size());
+	mapped.close();
+	assert(!mapped.isOpen());
+	assert(mapped.find(7) == mapped.end());
+
+	//A corrupted block fails the checksum, unless it is not verified
+	FILE* file = fopen(path, "r+b");
+	assert(nullptr != file);
+	fseek(file, -1, SEEK_END);
+	int last = fgetc(file);
+	fseek(file, -1, SEEK_END);
+	fputc(last ^ 0xFF, file);
+	fclose(file);
+	result = mapped.open(path);
+	assert(!result);
+	result = mapped.open(path, false);
+	assert(result);
+	assert(mapped.size() == table.size());
+
+	T empty;
+	result = empty.saveImage(path);
+	assert(result);
+	result = mapped.open(path);
+	assert(result);
+	assert(0 == mapped.size());
+	assert(mapped.find(7) == mapped.end());
+	result = mapped.open("not_exist.image");
+	assert(!result);
+	remove(path);
+}
+
+/**
+@brief Source of a FrozenMap which yields one key twice, so that no seed gives a perfect hash
+*/
+struct EqualKeys
+{
+	typedef hashmap::u32 iterator;
+
+	hashmap::u32 size() const { return 3; }
+	iterator begin() const { return 0; }
+	iterator end() const { return 3; }
+	iterator next(iterator pos) const { return pos+1; }
+	hashmap::u32 getKey(iterator pos) const { return (pos<2)? 7 : 8; }
+	hashmap::u32 getValue(iterator pos) const { return pos; }
+};
+
+template<class T>
+void testFrozen(hashmap::u32 count)
+{
+	T table;
+	for(hashmap::u32 i=0; i<count; ++i){
+		table.insert(i*7, i);
+	}
+	hashmap::FrozenMap<hashmap::u32, hashmap::u32> frozen(table);
+	assert(frozen.size() == count);
+	for(hashmap::u32 i=0; i<count; ++i){
+		hashmap::u32 pos = frozen.find(i*7);
+		assert(frozen.valid(pos));
+		assert(frozen.getKey(pos) == i*7);
+		assert(frozen.getValue(pos) == i);
+		assert(frozen.find(i*7+1) == frozen.end());
+	}
+	//Every slot holds a pair
+	hashmap::u32 sum = 0;
+	for(hashmap::u32 pos = frozen.begin(); pos != frozen.end(); pos = frozen.next(pos)){
+		assert(0 == (frozen.getKey(pos)%7));
+		sum += frozen.getValue(pos);
+	}
+	assert(sum == (0<count? count*(count-1)/2 : 0));
+	std::vector<hashmap::u32> keys;
+	for(hashmap::u32 i=0; i<count+40; ++i){
+		keys.push_back(i*7 + ((i<count)? 0 : 1));
+	}
+	std::vector<hashmap::u32> out(keys.size());
+	frozen.findBatch(keys.data(), static_cast<hashmap::u32>(keys.size()), out.data());
+	for(hashmap::u32 i=0; i<keys.size(); ++i){
+		assert((i<count)? frozen.getValue(out[i]) == i : out[i] == frozen.end());
+	}
+}
+
+template<class T>
+void testAllocator(const typename T::memory_allocator& allocator, hashmap::u32 count)
+{
+	T table(allocator);
+	for(hashmap::u32 i=0; i<count; ++i){
+		table.insert(i, i*3);
+	}
+	assert(table.size() == count);
+	for(hashmap::u32 i=0; i<count; i+=2){
+		table.erase(i);
+	}
+	for(hashmap::u32 i=0; i<count; ++i){
+		assert((0 == (i&1)) == (table.end() == table.find(i)));
+	}
+	//Tables created by growth and swap carry the allocator along
+	T other(16, allocator);
+	other.insert(count, 0);
+	other.swap(table);
+	assert(other.size() == count/2);
+	assert(table.end() != table.find(count));
+	for(hashmap::u32 i=0; i<count; ++i){
+		table.insert(i, i);
+	}
+}
+
+template<class T>
+void testStats(hashmap::u32 count)
+{
+	T table;
+	hashmap::TableStats stats = table.stats();
+	assert(0 == stats.size_ && 0 == stats.load() && 0 == stats.bytesPerEntry());
+	for(hashmap::u32 i=0; i<count; ++i){
+		table.insert(i, i);
+	}
+	for(hashmap::u32 i=0; i<count; i+=4){
+		table.erase(i);
+	}
+	stats = table.stats();
+	assert(stats.size_ == table.size());
+	assert(stats.capacity_ == table.capacity());
+	assert(0 < stats.bytes_ && 0.0 < stats.load() && stats.load() <= 1.0);
+	assert(stats.bytes_ / stats.size_ <= stats.bytesPerEntry());
+	hashmap::u64 entries = 0;
+	for(hashmap::u32 i=0; i<hashmap::TableStats::Histogram; ++i){
+		entries += stats.probes_[i];
+	}
+	assert(entries == stats.size_);
+	assert(stats.meanProbe() <= stats.maxProbe_);
+	assert(stats.maxProbe_ < hashmap::TableStats::Histogram || 0 < stats.probes_[hashmap::TableStats::Histogram-1]);
+}
+
+struct ResizeLog
+{
+	hashmap::u32 before_ = 0;
+	hashmap::u32 after_ = 0;
+	hashmap::u32 rehashes_ = 0;
+	hashmap::ResizeEvent last_ = {};
+};
+
+void recordResize(const hashmap::ResizeEvent& event, void* user)
+{
+	ResizeLog* log = reinterpret_cast<ResizeLog*>(user);
+	if(hashmap::ResizeEvent::Phase::Before == event.phase_){
+		assert(log->before_ == log->after_);
+		assert(0 == event.nanoseconds_);
+		++log->before_;
+	}else{
+		assert(log->before_ == log->after_+1);
+		assert(event.kind_ == log->last_.kind_);
+		assert(event.oldCapacity_ == log->last_.oldCapacity_ && event.newCapacity_ == log->last_.newCapacity_);
+		assert(event.moved_ == log->last_.moved_);
+		++log->after_;
+		log->rehashes_ += (hashmap::ResizeEvent::Kind::Rehash == event.kind_) ? 1 : 0;
+	}
+	log->last_ = event;
+}
+
+template<class T>
+void testResizeObserver(hashmap::u32 count)
+{
+	ResizeLog log;
+	T table;
+	table.setResizeObserver(recordResize, &log);
+	for(hashmap::u32 i=0; i<count; ++i){
+		hashmap::u32 capacity = table.capacity();
+		table.insert(i, i);
+		if(capacity != table.capacity()){
+			assert(hashmap::ResizeEvent::Phase::After == log.last_.phase_);
+			assert(hashmap::ResizeEvent::Kind::Grow == log.last_.kind_);
+			assert(log.last_.newCapacity_ == table.capacity());
+			assert(log.last_.moved_ <= i);
+		}
+	}
+	assert(0 < log.after_ && log.before_ == log.after_);
+	assert(T::roundCapacity(table.capacity()) == table.capacity());
+
+	//The observer stays with the table, not with the entries
+	T other;
+	other.swap(table);
+	hashmap::u32 after = log.after_;
+	for(hashmap::u32 i=count; i<count*2; ++i){
+		other.insert(i, i);
+	}
+	assert(after == log.after_);
+	table.insert(0, 0);
+	assert(after < log.after_);
 
-    }
+	table.setResizeObserver(nullptr, nullptr);
+	after = log.after_;
+	for(hashmap::u32 i=1; i<count; ++i){
+		table.insert(i, i);
+	}
+	assert(after == log.after_);
 }
 
+#ifdef HASHMAP_ENABLE_COUNTERS
+template<class T>
+void testCounters(bool fingerprint)
+{
+	hashmap::resetCounters();
+	T table;
+	for(hashmap::u32 i=0; i<10000; ++i){
+		table.insert(i, i);
+	}
+	hashmap::Counters counters = hashmap::threadCounters();
+	assert(0 < counters.probes_);
+	assert(0 < counters.resizes_ && 0 < counters.resizeNanoseconds_);
+
+	hashmap::resetCounters();
+	for(hashmap::u32 i=0; i<10000; ++i){
+		assert(table.end() != table.find(i));
+	}
+	counters = hashmap::threadCounters();
+	assert(10000 <= counters.probes_ && 10000 <= counters.compares_);
+	assert(fingerprint || 0 == counters.falseMatches_);
+	assert(counters.falseMatches_ <= counters.compares_);
+	assert(0 == counters.resizes_ && 0 == counters.displacements_);
+}
+#endif
+
 int main(void)
 {
 	{
@@ -28,5 +772,611 @@ int main(void)
 		pos = swisstable.find(key);
 		assert(pos == swisstable.end());
 	}
+	{
+		hashmap::SwissTable<hashmap::u32, hashmap::u32> swisstable;
+		static constexpr hashmap::u32 Count = 4096;
+		for(hashmap::u32 i=0; i<Count; ++i){
+			bool result = swisstable.insert(i, i*2);
+			assert(result);
+		}
+		assert(swisstable.size() == Count);
+		for(hashmap::u32 i=0; i<Count; i+=2){
+			swisstable.erase(i);
+		}
+		for(hashmap::u32 i=0; i<Count; ++i){
+			hashmap::u32 pos = swisstable.find(i);
+			assert((pos == swisstable.end()) == (0 == (i&1)));
+			assert(pos == swisstable.end() || swisstable.getValue(pos) == i*2);
+		}
+		for(hashmap::u32 i=Count; i<Count*2; ++i){
+			assert(swisstable.find(i) == swisstable.end());
+		}
+	}
+	{
+		hashmap::SwissTable<hashmap::u32, hashmap::u32> swisstable;
+		static constexpr hashmap::u32 Live = 1000;
+		static constexpr hashmap::u32 Churn = 200000;
+		for(hashmap::u32 i=0; i<Live; ++i){
+			swisstable.insert(i, i);
+		}
+		hashmap::u32 capacity = swisstable.capacity();
+		for(hashmap::u32 i=0; i<Churn; ++i){
+			swisstable.erase(i);
+			bool result = swisstable.insert(i+Live, i+Live);
+			assert(result);
+		}
+		assert(swisstable.size() == Live);
+		assert(swisstable.capacity() == capacity);
+		for(hashmap::u32 i=Churn; i<Churn+Live; ++i){
+			hashmap::u32 pos = swisstable.find(i);
+			assert(pos != swisstable.end());
+			assert(swisstable.getValue(pos) == i);
+		}
+		for(hashmap::u32 i=0; i<Churn; ++i){
+			assert(swisstable.find(i) == swisstable.end());
+		}
+	}
+	{
+		typedef hashmap::GrowthPolicy<50, 150, 64> GrowthPolicy;
+		testGrowthPolicy<hashmap::HashMap<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, GrowthPolicy>>();
+		testGrowthPolicy<hashmap::HopscotchHashMap<hashmap::u32, hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, GrowthPolicy>>();
+		testGrowthPolicy<hashmap::RHHashMap<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, GrowthPolicy>>();
+		testGrowthPolicy<hashmap::SwissTable<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, GrowthPolicy>>();
+
+		//SwissTable keeps an eighth of slots empty even under a full load policy
+		typedef hashmap::SwissTable<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::GrowthPolicy<100, 200>> full_type;
+		testGrowthPolicy<full_type>();
+		full_type full;
+		for(hashmap::u32 i=0; i<2000; ++i){
+			bool result = full.insert(i, i);
+			assert(result);
+			assert(full.size() <= full.capacity() - full.capacity()/8);
+		}
+		std::vector<hashmap::u32> keys(5000);
+		for(hashmap::u32 i=0; i<5000; ++i){
+			keys[i] = i;
+		}
+		hashmap::u32 built = full.build(keys.data(), keys.data(), 5000, 1);
+		assert(5000 == built);
+		assert(full.size() <= full.capacity() - full.capacity()/8);
+	}
+	{
+		typedef hashmap::DefaultGrowthPolicy GrowthPolicy;
+		typedef hashmap::MaskIndexPolicy MaskIndexPolicy;
+		typedef hashmap::FibonacciIndexPolicy FibonacciIndexPolicy;
+		testGrowthPolicy<hashmap::HashMap<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, GrowthPolicy, MaskIndexPolicy>>();
+		testGrowthPolicy<hashmap::HopscotchHashMap<hashmap::u32, hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, GrowthPolicy, MaskIndexPolicy>>();
+		testGrowthPolicy<hashmap::RHHashMap<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, GrowthPolicy, MaskIndexPolicy>>();
+		testGrowthPolicy<hashmap::SwissTable<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, GrowthPolicy, MaskIndexPolicy>>();
+		testGrowthPolicy<hashmap::HashMap<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, GrowthPolicy, FibonacciIndexPolicy>>();
+		testGrowthPolicy<hashmap::HopscotchHashMap<hashmap::u32, hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, GrowthPolicy, FibonacciIndexPolicy>>();
+		testGrowthPolicy<hashmap::RHHashMap<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, GrowthPolicy, FibonacciIndexPolicy>>();
+		testGrowthPolicy<hashmap::SwissTable<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, GrowthPolicy, FibonacciIndexPolicy>>();
+	}
+	{
+		typedef hashmap::SwissTable<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, hashmap::GroupAvx2> SwissTableAvx2;
+		static_assert(0 == (SwissTableAvx2::BlockMask & SwissTableAvx2::Block), "group width should be a power of two");
+		testGrowthPolicy<SwissTableAvx2>();
+		testGrowthPolicy<hashmap::SwissTable<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::MaskIndexPolicy, hashmap::GroupAvx2>>();
+
+		SwissTableAvx2 swisstable;
+		for(hashmap::u32 i=0; i<1000; ++i){
+			swisstable.insert(i, i);
+		}
+		assert(SwissTableAvx2::Block <= swisstable.capacity());
+		for(hashmap::u32 i=0; i<1000; i+=2){
+			swisstable.erase(i);
+		}
+		for(hashmap::u32 i=0; i<2000; ++i){
+			hashmap::u32 pos = swisstable.find(i);
+			assert((pos != swisstable.end()) == (i<1000 && (i&1)));
+		}
+	}
+	{
+		typedef hashmap::HopscotchHashMap<std::string, hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, true> Hopscotch;
+		typedef hashmap::RHHashMap<std::string, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, true> RobinHood;
+		typedef hashmap::SwissTable<std::string, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, hashmap::GroupSse2, true> Swiss;
+		testGrowthPolicy<hashmap::HopscotchHashMap<hashmap::u32, hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::MaskIndexPolicy, true>>();
+		testGrowthPolicy<hashmap::RHHashMap<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::MaskIndexPolicy, true>>();
+		testGrowthPolicy<hashmap::SwissTable<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::MaskIndexPolicy, hashmap::GroupSse2, true>>();
+
+		Hopscotch hopscotch;
+		RobinHood robinhood;
+		Swiss swisstable;
+		static constexpr hashmap::u32 Count = 3000;
+		for(hashmap::u32 i=0; i<Count; ++i){
+			std::string key = std::to_string(i);
+			bool result = hopscotch.insert(key, i);
+			assert(result);
+			result = robinhood.insert(key, i);
+			assert(result);
+			result = swisstable.insert(key, i);
+			assert(result);
+		}
+		for(hashmap::u32 i=0; i<Count; i+=3){
+			std::string key = std::to_string(i);
+			hopscotch.erase(key);
+			robinhood.erase(key);
+			swisstable.erase(key);
+		}
+		for(hashmap::u32 i=0; i<Count*2; ++i){
+			std::string key = std::to_string(i);
+			bool exists = i<Count && 0 != (i%3);
+			hashmap::u32 pos = hopscotch.find(key);
+			assert((pos != hopscotch.end()) == exists);
+			assert(!exists || hopscotch.getValue(pos) == i);
+			pos = robinhood.find(key);
+			assert((pos != robinhood.end()) == exists);
+			assert(!exists || robinhood.getValue(pos) == i);
+			pos = swisstable.find(key);
+			assert((pos != swisstable.end()) == exists);
+			assert(!exists || swisstable.getValue(pos) == i);
+		}
+	}
+	{
+		typedef hashmap::AoSLayout AoS;
+		testGrowthPolicy<hashmap::HashMap<hashmap::u32, hashmap::u64, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, AoS>>();
+		testGrowthPolicy<hashmap::HopscotchHashMap<hashmap::u32, hashmap::u64, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, false, AoS>>();
+		testGrowthPolicy<hashmap::RHHashMap<hashmap::u32, hashmap::u64, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, true, AoS>>();
+		testGrowthPolicy<hashmap::SwissTable<hashmap::u32, hashmap::u64, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, hashmap::GroupSse2, true, AoS>>();
+
+		hashmap::SwissTable<std::string, std::string, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, hashmap::GroupSse2, false, AoS> swisstable;
+		hashmap::RHHashMap<std::string, std::string, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, false, AoS> robinhood;
+		static constexpr hashmap::u32 Count = 2000;
+		for(hashmap::u32 i=0; i<Count; ++i){
+			std::string key = std::to_string(i);
+			bool result = swisstable.insert(key, key + "-value");
+			assert(result);
+			result = robinhood.insert(key, key + "-value");
+			assert(result);
+		}
+		for(hashmap::u32 i=0; i<Count; i+=2){
+			swisstable.erase(std::to_string(i));
+			robinhood.erase(std::to_string(i));
+		}
+		for(hashmap::u32 i=0; i<Count; ++i){
+			std::string key = std::to_string(i);
+			hashmap::u32 pos = swisstable.find(key);
+			assert((pos != swisstable.end()) == (0 != (i&1)));
+			assert(pos == swisstable.end() || swisstable.getValue(pos) == key + "-value");
+			pos = robinhood.find(key);
+			assert((pos != robinhood.end()) == (0 != (i&1)));
+			assert(pos == robinhood.end() || robinhood.getValue(pos) == key + "-value");
+		}
+	}
+	{
+		testFindBatch<hashmap::HashMap<hashmap::u32, hashmap::u32>>();
+		testFindBatch<hashmap::HopscotchHashMap<hashmap::u32, hashmap::u32>>();
+		testFindBatch<hashmap::RHHashMap<hashmap::u32, hashmap::u32>>();
+		testFindBatch<hashmap::SwissTable<hashmap::u32, hashmap::u32>>();
+		testFindBatch<hashmap::SwissTable<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::MaskIndexPolicy, hashmap::GroupAvx2>>();
+	}
+	{
+		testInsertBatch<hashmap::HashMap<hashmap::u32, hashmap::u32>>();
+		testInsertBatch<hashmap::HopscotchHashMap<hashmap::u32, hashmap::u32>>();
+		testInsertBatch<hashmap::RHHashMap<hashmap::u32, hashmap::u32>>();
+		testInsertBatch<hashmap::SwissTable<hashmap::u32, hashmap::u32>>();
+		testInsertBatch<hashmap::SwissTable<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::FibonacciIndexPolicy>>();
+		for(hashmap::u32 i=1; i<1000; i+=37){
+			assert(i <= hashmap::DefaultGrowthPolicy::maxSize(hashmap::DefaultGrowthPolicy::capacityFor(i)));
+			assert(hashmap::DefaultGrowthPolicy::maxSize(hashmap::DefaultGrowthPolicy::capacityFor(i)-1) < i || hashmap::DefaultGrowthPolicy::capacityFor(i) == hashmap::DefaultGrowthPolicy::Minimum);
+		}
+	}
+	{
+		testTransparent<hashmap::HashMap<std::string, hashmap::u32>>();
+		testTransparent<hashmap::HopscotchHashMap<std::string, hashmap::u32>>();
+		testTransparent<hashmap::RHHashMap<std::string, hashmap::u32>>();
+		testTransparent<hashmap::SwissTable<std::string, hashmap::u32>>();
+		testTransparent<hashmap::SwissTable<std::string, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, hashmap::GroupSse2, true>>();
+	}
+	{
+		testEmplace<hashmap::HashMap<std::string, Counted>>();
+		testEmplace<hashmap::HopscotchHashMap<std::string, Counted>>();
+		testEmplace<hashmap::RHHashMap<std::string, Counted>>();
+		testEmplace<hashmap::SwissTable<std::string, Counted>>();
+		testEmplace<hashmap::SwissTable<std::string, Counted, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, hashmap::GroupSse2, true, hashmap::AoSLayout>>();
+	}
+	{
+		testIncrementalResize<hashmap::IncrementalResize<hashmap::HashMap<hashmap::u32, hashmap::u32>>>();
+		testIncrementalResize<hashmap::IncrementalResize<hashmap::HopscotchHashMap<hashmap::u32, hashmap::u32>>>();
+		//Robin Hood grows by itself when a probe exceeds the maximum distance, before reaching the maximum load
+		testIncrementalResize<hashmap::IncrementalResize<hashmap::RHHashMap<hashmap::u32, hashmap::u32>>, false>();
+		testIncrementalResize<hashmap::IncrementalResize<hashmap::SwissTable<hashmap::u32, hashmap::u32>>>();
+		testIncrementalResize<hashmap::IncrementalResize<hashmap::SwissTable<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::GrowthPolicy<87, 150>>, 1>>();
+
+		hashmap::IncrementalResize<hashmap::SwissTable<std::string, std::string>> strings;
+		for(hashmap::u32 i=0; i<1000; ++i){
+			bool result = strings.insert(std::to_string(i), std::to_string(i*2));
+			assert(result);
+		}
+		for(hashmap::u32 i=0; i<1000; ++i){
+			assert(strings.getValue(strings.find(std::to_string(i))) == std::to_string(i*2));
+		}
+	}
+	{
+		testConcurrent<hashmap::ConcurrentSwissTable<hashmap::u32, hashmap::u32>>();
+		testConcurrent<hashmap::ConcurrentSwissTable<hashmap::u32, hashmap::u32, 0>>();
+		testConcurrent<hashmap::ConcurrentSwissTable<hashmap::u32, hashmap::u32, 8, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::FibonacciIndexPolicy>>();
+		testConcurrent<hashmap::ConcurrentSwissTable<hashmap::u32, hashmap::u32, 6, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::MaskIndexPolicy>>();
+		testShardHomes<hashmap::ConcurrentSwissTable<hashmap::u32, hashmap::u32, 8>>();
+		testShardHomes<hashmap::ConcurrentSwissTable<hashmap::u32, hashmap::u32, 8, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::MaskIndexPolicy>>();
+		static_assert(0 == (sizeof(hashmap::ConcurrentSwissTable<hashmap::u32, hashmap::u32>) % hashmap::hash_detail::CacheLineSize), "");
+
+		hashmap::ConcurrentSwissTable<std::string, std::string> strings(1000);
+		for(hashmap::u32 i=0; i<1000; ++i){
+			bool result = strings.insert(std::to_string(i), std::to_string(i*2));
+			assert(result);
+		}
+		std::string value;
+		bool result = strings.find("10", value);
+		assert(result && value == "20");
+		result = strings.find("1000", value);
+		assert(!result);
+	}
+	{
+		testOptimistic<hashmap::OptimisticSwissTable<hashmap::u32, hashmap::u32>>();
+		testOptimistic<hashmap::OptimisticSwissTable<hashmap::u32, hashmap::u32, 0>>();
+		testOptimistic<hashmap::OptimisticSwissTable<hashmap::u32, hashmap::u32, 2, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::MaskIndexPolicy, hashmap::GroupAvx2, true>>();
+		testShardHomes<hashmap::OptimisticSwissTable<hashmap::u32, hashmap::u32, 8, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::MaskIndexPolicy>>();
+	}
+	{
+		testParallelRehash<hashmap::HashMap<hashmap::u32, hashmap::u32>>();
+		testParallelRehash<hashmap::RHHashMap<hashmap::u32, hashmap::u32>>();
+		testParallelRehash<hashmap::RHHashMap<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::MaskIndexPolicy, true>>();
+		testParallelRehash<hashmap::SwissTable<hashmap::u32, hashmap::u32>>();
+		testParallelRehash<hashmap::SwissTable<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::FibonacciIndexPolicy, hashmap::GroupAvx2, true>>();
+
+		hashmap::SwissTable<std::string, std::string> strings;
+		strings.setRehashThreads(3);
+		for(hashmap::u32 i=0; i<100000; ++i){
+			bool result = strings.insert(std::to_string(i), std::to_string(i*2));
+			assert(result);
+		}
+		for(hashmap::u32 i=0; i<100000; ++i){
+			assert(strings.getValue(strings.find(std::to_string(i))) == std::to_string(i*2));
+		}
+	}
+	{
+		for(hashmap::u32 threads=1; threads<=4; threads+=3){
+			testBuild<hashmap::RHHashMap<hashmap::u32, hashmap::u32>>(threads);
+			testBuild<hashmap::RHHashMap<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::MaskIndexPolicy, true>>(threads);
+			testBuild<hashmap::SwissTable<hashmap::u32, hashmap::u32>>(threads);
+			testBuild<hashmap::SwissTable<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::FibonacciIndexPolicy, hashmap::GroupAvx2, true>>(threads);
+		}
+
+		std::vector<std::string> keys;
+		std::vector<std::string> values;
+		for(hashmap::u32 i=0; i<100000; ++i){
+			keys.push_back(std::to_string(i%70000));
+			values.push_back(std::to_string(i));
+		}
+		hashmap::SwissTable<std::string, std::string> strings;
+		hashmap::u32 built = strings.build(keys.data(), values.data(), 100000, 3);
+		assert(70000 == built);
+		hashmap::RHHashMap<std::string, std::string> rhstrings;
+		built = rhstrings.build(keys.data(), values.data(), 100000, 3);
+		assert(70000 == built);
+		for(hashmap::u32 i=0; i<70000; ++i){
+			assert(strings.getValue(strings.find(keys[i])) == values[i]);
+			assert(rhstrings.getValue(rhstrings.find(keys[i])) == values[i]);
+		}
+	}
+	{
+		typedef hashmap::SwissTable<hashmap::u32, hashmap::u32> swiss_type;
+		typedef hashmap::SwissTable<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::FibonacciIndexPolicy, hashmap::GroupAvx2, true, hashmap::AoSLayout> swiss_hash_type;
+		typedef hashmap::RHHashMap<hashmap::u32, hashmap::u32> rh_type;
+		typedef hashmap::RHHashMap<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::MaskIndexPolicy, true> rh_hash_type;
+		testImage<swiss_type, hashmap::MappedTable<swiss_type>>("swiss.image");
+		testImage<swiss_hash_type, hashmap::MappedSwissTable<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::FibonacciIndexPolicy, hashmap::GroupAvx2, true, hashmap::AoSLayout>>("swiss_hash.image");
+		testImage<rh_type, hashmap::MappedRHHashMap<hashmap::u32, hashmap::u32>>("rh.image");
+		testImage<rh_hash_type, hashmap::MappedTable<rh_hash_type>>("rh_hash.image");
+
+		//An image of another table or format is refused
+		swiss_type swisstable;
+		swisstable.insert(1, 2);
+		bool result = swisstable.saveImage("other.image");
+		assert(result);
+		hashmap::MappedTable<swiss_hash_type> swisshash;
+		result = swisshash.open("other.image");
+		assert(!result);
+		hashmap::MappedTable<rh_type> rh;
+		result = rh.open("other.image");
+		assert(!result);
+		hashmap::MappedSwissTable<hashmap::u32, hashmap::u64> wider;
+		result = wider.open("other.image");
+		assert(!result);
+		hashmap::MappedSwissTable<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::GrowthPolicy<75>> looser;
+		result = looser.open("other.image");
+		assert(!result);
+		hashmap::MappedTable<swiss_type> mapped;
+		result = mapped.open("other.image");
+		assert(result);
+		assert(2 == mapped.getValue(mapped.find(1)));
+		mapped.close();
+		remove("other.image");
+
+		//The same format under another index policy would look for keys in other homes
+		rh_hash_type masked;
+		masked.insert(1, 2);
+		result = masked.saveImage("other.image");
+		assert(result);
+		hashmap::MappedRHHashMap<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::FibonacciIndexPolicy, true> fibonacci;
+		result = fibonacci.open("other.image");
+		assert(!result);
+		hashmap::MappedTable<rh_hash_type> rhmapped;
+		result = rhmapped.open("other.image");
+		assert(result);
+		rhmapped.close();
+		remove("other.image");
+	}
+	{
+		testFrozen<hashmap::HashMap<hashmap::u32, hashmap::u32>>(100000);
+		testFrozen<hashmap::HopscotchHashMap<hashmap::u32, hashmap::u32>>(1000);
+		testFrozen<hashmap::RHHashMap<hashmap::u32, hashmap::u32>>(1);
+		testFrozen<hashmap::SwissTable<hashmap::u32, hashmap::u32>>(0);
+		testFrozen<hashmap::SwissTable<hashmap::u32, hashmap::u32>>(300000);
+		testFrozen<hashmap::IncrementalResize<hashmap::SwissTable<hashmap::u32, hashmap::u32>>>(5000);
+
+		hashmap::SwissTable<std::string, std::string> strings;
+		for(hashmap::u32 i=0; i<20000; ++i){
+			strings.insert(std::to_string(i), std::to_string(i*2));
+		}
+		hashmap::FrozenMap<std::string, std::string, hashmap::DefaultAllocator, hashmap::AoSLayout> frozen;
+		bool result = frozen.build(strings);
+		assert(result);
+		assert(frozen.size() == strings.size());
+		for(hashmap::u32 i=0; i<20000; ++i){
+			assert(frozen.getValue(frozen.find(std::string_view(std::to_string(i)))) == std::to_string(i*2));
+		}
+		assert(frozen.find(std::string("none")) == frozen.end());
+		strings.erase(std::string("0"));
+		result = frozen.build(strings);
+		assert(result);
+		assert(frozen.size() == 19999);
+		assert(frozen.find(std::string("0")) == frozen.end());
+		hashmap::FrozenMap<std::string, std::string, hashmap::DefaultAllocator, hashmap::AoSLayout> other;
+		other.swap(frozen);
+		assert(0 == frozen.size() && 19999 == other.size());
+		other.clear();
+		assert(other.find(std::string("1")) == other.end());
+
+		//Equal keys fail every seed, which leaves the map empty
+		hashmap::FrozenMap<hashmap::u32, hashmap::u32> equal;
+		result = equal.build(EqualKeys());
+		assert(!result);
+		assert(0 == equal.size());
+		assert(equal.find(7) == equal.end());
+	}
+	{
+		typedef hashmap::ArenaAllocator arena_allocator;
+		typedef hashmap::PoolAllocator pool_allocator;
+		hashmap::Arena arena(4096);
+		arena_allocator arenaAllocator(arena);
+		//Many short-lived tables draw from one arena, which releases all of them at once
+		for(hashmap::u32 request=0; request<50; ++request){
+			testAllocator<hashmap::HashMap<hashmap::u32, hashmap::u32, arena_allocator>>(arenaAllocator, 300);
+			testAllocator<hashmap::HopscotchHashMap<hashmap::u32, hashmap::u32, hashmap::u32, arena_allocator>>(arenaAllocator, 300);
+			testAllocator<hashmap::RHHashMap<hashmap::u32, hashmap::u32, arena_allocator>>(arenaAllocator, 300);
+			testAllocator<hashmap::SwissTable<hashmap::u32, hashmap::u32, arena_allocator>>(arenaAllocator, 300);
+		}
+		assert(0 < arena.used());
+		arena.release();
+		assert(0 == arena.used());
+
+		//Concurrent tables refuse an arena or a pool, which are not thread safe
+		static_assert(!hashmap::hash_detail::is_thread_safe<arena_allocator>::value, "");
+		static_assert(!hashmap::hash_detail::is_thread_safe<pool_allocator>::value, "");
+		static_assert(hashmap::hash_detail::is_thread_safe<hashmap::DefaultAllocator>::value, "");
+		hashmap::IncrementalResize<hashmap::SwissTable<hashmap::u32, hashmap::u32, arena_allocator>> incremental(arenaAllocator);
+		hashmap::SwissTable<hashmap::u32, hashmap::u32, arena_allocator> source(arenaAllocator);
+		for(hashmap::u32 i=0; i<5000; ++i){
+			incremental.insert(i, i);
+			source.insert(i, i);
+		}
+		hashmap::FrozenMap<hashmap::u32, hashmap::u32, arena_allocator> frozen(arenaAllocator);
+		bool result = frozen.build(source);
+		assert(result);
+		for(hashmap::u32 i=0; i<5000; ++i){
+			assert(incremental.getValue(incremental.find(i)) == i);
+			assert(frozen.getValue(frozen.find(i)) == i);
+		}
+
+		hashmap::Pool pool;
+		pool_allocator poolAllocator(pool);
+		for(hashmap::u32 request=0; request<50; ++request){
+			testAllocator<hashmap::HashMap<hashmap::u32, hashmap::u32, pool_allocator>>(poolAllocator, 300);
+			testAllocator<hashmap::HopscotchHashMap<hashmap::u32, hashmap::u32, hashmap::u32, pool_allocator>>(poolAllocator, 300);
+			testAllocator<hashmap::RHHashMap<hashmap::u32, hashmap::u32, pool_allocator>>(poolAllocator, 300);
+			testAllocator<hashmap::SwissTable<hashmap::u32, hashmap::u32, pool_allocator>>(poolAllocator, 300);
+		}
+		//A freed block is reused by the next request of the same size class
+		void* block = pool.allocate(100);
+		pool.deallocate(block);
+		void* reused = pool.allocate(80);
+		assert(block == reused);
+		void* fresh = pool.allocate(80);
+		assert(block != fresh);
+		pool.release();
+
+		testAllocator<hashmap::SwissTable<hashmap::u32, hashmap::u32>>(hashmap::DefaultAllocator(), 300);
+	}
+	{
+		//Blocks start at cache lines, and large blocks at huge pages
+		const hashmap::u64 sizes[] = {1, 63, 64, 1000, 4096, hashmap::DefaultAllocator::HugePageMinimum, hashmap::DefaultAllocator::HugePageMinimum + 12345};
+		for(hashmap::u64 size: sizes){
+			hashmap::u8* mem = reinterpret_cast<hashmap::u8*>(hashmap::DefaultAllocator::malloc(size));
+			assert(NULL != mem);
+			assert(0 == (reinterpret_cast<uintptr_t>(mem) & (hashmap::DefaultAllocator::Alignment - 1)));
+#if !defined(_WIN32)
+			assert(size < hashmap::DefaultAllocator::HugePageMinimum || 0 == (reinterpret_cast<uintptr_t>(mem) & (hashmap::DefaultAllocator::HugePageSize - 1)));
+#endif
+			memset(mem, 0xCD, size);
+			hashmap::DefaultAllocator::free(mem);
+		}
+		hashmap::DefaultAllocator::free(NULL);
+		hashmap::Arena arena(4096);
+		hashmap::Pool pool;
+		for(hashmap::u64 size: {1, 17, 100, 3000, 5000}){
+			void* fromArena = arena.allocate(size);
+			assert(0 == (reinterpret_cast<uintptr_t>(fromArena) & (hashmap::Arena::Alignment - 1)));
+			void* fromPool = pool.allocate(size);
+			assert(0 == (reinterpret_cast<uintptr_t>(fromPool) & (hashmap::Arena::Alignment - 1)));
+		}
+
+		hashmap::SwissTable<hashmap::u64, hashmap::u64> table;
+		for(hashmap::u64 i=0; i<(1ULL<<20); ++i){
+			table.insert(i, i);
+		}
+		for(hashmap::u64 i=0; i<(1ULL<<20); ++i){
+			assert(table.getValue(table.find(i)) == i);
+		}
+	}
+	{
+		testStats<hashmap::HashMap<hashmap::u32, hashmap::u32>>(10000);
+		testStats<hashmap::HopscotchHashMap<hashmap::u32, hashmap::u32>>(10000);
+		testStats<hashmap::RHHashMap<hashmap::u32, hashmap::u32>>(10000);
+		testStats<hashmap::SwissTable<hashmap::u32, hashmap::u32>>(10000);
+		testStats<hashmap::SwissTable<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::MaskIndexPolicy, hashmap::GroupAvx2, true, hashmap::AoSLayout>>(10000);
+		testStats<hashmap::IncrementalResize<hashmap::RHHashMap<hashmap::u32, hashmap::u32>>>(10000);
+		testStats<hashmap::ConcurrentSwissTable<hashmap::u32, hashmap::u32, 2>>(10000);
+		testStats<hashmap::OptimisticSwissTable<hashmap::u32, hashmap::u32, 2>>(10000);
+
+		//Erasures in full groups leave tombstones
+		typedef hashmap::SwissTable<hashmap::u32, hashmap::u32> swiss_type;
+		swiss_type swiss(1024);
+		hashmap::u32 filled = swiss_type::growth_policy::maxSize(swiss.capacity()) - 1;
+		for(hashmap::u32 i=0; i<filled; ++i){
+			swiss.insert(i, i);
+		}
+		for(hashmap::u32 i=0; i<filled; i+=2){
+			swiss.erase(i);
+		}
+		assert(0 < swiss.stats().tombstones_);
+
+		//Reinserting into a tombstone at the growth limit neither grows nor rehashes
+		swiss_type full(1024);
+		hashmap::u32 count = 0;
+		while(0 < full.available()){
+			full.insert(count, count);
+			++count;
+		}
+		hashmap::u32 capacity = full.capacity();
+		for(hashmap::u32 i=0; i<count; ++i){
+			hashmap::u64 tombstones = full.stats().tombstones_;
+			full.erase(i);
+			if(tombstones < full.stats().tombstones_){
+				ResizeLog log;
+				full.setResizeObserver(recordResize, &log);
+				bool result = full.insert(i, i);
+				assert(result);
+				assert(0 == log.before_ && capacity == full.capacity());
+				break;
+			}
+			full.insert(i, i);
+		}
+		hashmap::RHHashMap<hashmap::u32, hashmap::u32> rh;
+		assert(0 == rh.stats().tombstones_ && 0 == rh.stats().bytes_);
+
+		hashmap::SwissTable<hashmap::u32, hashmap::u32> source;
+		for(hashmap::u32 i=0; i<1000; ++i){
+			source.insert(i, i);
+		}
+		hashmap::FrozenMap<hashmap::u32, hashmap::u32> frozen(source);
+		hashmap::TableStats stats = frozen.stats();
+		assert(1000 == stats.size_ && 1000 == stats.probes_[0] && 0 == stats.maxProbe_);
+		assert(stats.bytesPerEntry() < source.stats().bytesPerEntry());
+	}
+	{
+		testResizeObserver<hashmap::HashMap<hashmap::u32, hashmap::u32>>(10000);
+		testResizeObserver<hashmap::HopscotchHashMap<hashmap::u32, hashmap::u32>>(10000);
+		testResizeObserver<hashmap::RHHashMap<hashmap::u32, hashmap::u32>>(10000);
+		testResizeObserver<hashmap::SwissTable<hashmap::u32, hashmap::u32>>(10000);
+
+		//Replacing entries at a constant size piles up tombstones, which are reclaimed in place
+		typedef hashmap::SwissTable<hashmap::u32, hashmap::u32> swiss_type;
+		ResizeLog log;
+		swiss_type swiss(1024);
+		swiss.setResizeObserver(recordResize, &log);
+		hashmap::u32 filled = swiss_type::growth_policy::maxSize(swiss.capacity()) / 2;
+		for(hashmap::u32 i=0; i<filled; ++i){
+			swiss.insert(i, i);
+		}
+		hashmap::u32 capacity = swiss.capacity();
+		for(hashmap::u32 i=0; i<100000 && 0 == log.after_; ++i){
+			swiss.erase(i);
+			swiss.insert(filled+i, i);
+		}
+		assert(1 == log.after_ && filled-1 == log.last_.moved_);
+		assert(0 < log.rehashes_ && capacity == swiss.capacity());
+		assert(capacity == log.last_.oldCapacity_ && capacity == log.last_.newCapacity_);
+
+		log = {};
+		hashmap::IncrementalResize<hashmap::RHHashMap<hashmap::u32, hashmap::u32>> incremental;
+		incremental.setResizeObserver(recordResize, &log);
+		for(hashmap::u32 i=0; i<10000; ++i){
+			incremental.insert(i, i);
+		}
+		assert(0 < log.after_ && log.before_ == log.after_);
+		assert(incremental.capacity() == log.last_.newCapacity_);
+
+		//Every swap is reported alone, even when a step moves one entry at a time
+		log = {};
+		hashmap::IncrementalResize<hashmap::SwissTable<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::GrowthPolicy<87, 150>>, 1> stepped;
+		stepped.setResizeObserver(recordResize, &log);
+		for(hashmap::u32 i=0; i<10000; ++i){
+			stepped.insert(i, i);
+		}
+		assert(0 < log.after_ && log.before_ == log.after_);
+		assert(0 == log.last_.moved_ && stepped.capacity() == log.last_.newCapacity_);
+
+		log = {};
+		hashmap::ConcurrentSwissTable<hashmap::u32, hashmap::u32, 2> concurrent;
+		concurrent.setResizeObserver(recordResize, &log);
+		for(hashmap::u32 i=0; i<10000; ++i){
+			concurrent.insert(i, i);
+		}
+		assert(4 <= log.after_ && log.before_ == log.after_);
+
+		log = {};
+		hashmap::OptimisticSwissTable<hashmap::u32, hashmap::u32, 2> optimistic;
+		optimistic.setResizeObserver(recordResize, &log);
+		for(hashmap::u32 i=0; i<10000; ++i){
+			optimistic.insert(i, i);
+		}
+		assert(4 <= log.after_ && log.before_ == log.after_);
+	}
+#ifdef HASHMAP_ENABLE_COUNTERS
+	{
+		testCounters<hashmap::HashMap<hashmap::u32, hashmap::u32>>(true);
+		testCounters<hashmap::HopscotchHashMap<hashmap::u32, hashmap::u32>>(false);
+		testCounters<hashmap::RHHashMap<hashmap::u32, hashmap::u32>>(false);
+		testCounters<hashmap::RHHashMap<hashmap::u32, hashmap::u32, hashmap::DefaultAllocator, hashmap::DefaultGrowthPolicy, hashmap::PrimeIndexPolicy, true>>(true);
+		testCounters<hashmap::SwissTable<hashmap::u32, hashmap::u32>>(true);
+
+		//Robin Hood moves entries on insertion and erasure
+		hashmap::resetCounters();
+		hashmap::RHHashMap<hashmap::u32, hashmap::u32> rh;
+		for(hashmap::u32 i=0; i<10000; ++i){
+			rh.insert(i, i);
+		}
+		for(hashmap::u32 i=0; i<10000; i+=2){
+			rh.erase(i);
+		}
+		assert(0 < hashmap::threadCounters().displacements_);
+
+		//Counts of exited threads stay in the totals
+		hashmap::resetCounters();
+		std::thread thread([]() {
+			hashmap::SwissTable<hashmap::u32, hashmap::u32> table;
+			for(hashmap::u32 i=0; i<1000; ++i){
+				table.insert(i, i);
+			}
+			assert(0 < hashmap::threadCounters().probes_);
+		});
+		thread.join();
+		assert(0 == hashmap::threadCounters().probes_);
+		assert(0 < hashmap::totalCounters().probes_);
+	}
+#endif
 	return 0;
 }